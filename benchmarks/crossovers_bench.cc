@@ -0,0 +1,67 @@
+// Compares word-level cross-over kernels against the former bit by
+// bit loops. Build with CFLAGS=-march=native to enable AVX2/AVX-512.
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "chromosome.h"
+#include "crossovers.h"
+#include "initializers.h"
+
+using namespace std;
+
+using namespace GeneticAlgorithms;
+
+// reference implementation of RandomSplitCrossOver, one bit at a time
+Chromosome bitwiseSplit(const Chromosome &a, const Chromosome &b,
+                        size_t pos) {
+  Chromosome dest(a.size());
+  for (size_t i=0; i<pos; ++i) dest.set(i, a[i]);
+  for (size_t i=pos; i<b.size(); ++i) dest.set(i, b[i]);
+  return dest;
+}
+
+// reference implementation of RandomMixCrossOver, one coin per bit
+Chromosome bitwiseMix(const Chromosome &a, const Chromosome &b,
+                      std::mt19937_64 &rng) {
+  std::uniform_int_distribution<size_t> coin(0u, 1u);
+  Chromosome dest(a.size());
+  for (size_t i=0; i<a.size(); ++i) dest.set(i, coin(rng) == 0u ? a[i] : b[i]);
+  return dest;
+}
+
+template<typename F>
+double nsPerCall(size_t reps, F f) {
+  auto start = chrono::steady_clock::now();
+  for (size_t i=0; i<reps; ++i) f();
+  auto end = chrono::steady_clock::now();
+  return chrono::duration<double, nano>(end - start).count() / reps;
+}
+
+int main() {
+  std::mt19937_64 rng(12564);
+  size_t sink = 0u;
+  cout << setw(8) << "N" << setw(14) << "split_bits" << setw(14) << "split_words"
+       << setw(14) << "mix_bits" << setw(14) << "mix_words" << "   (ns/call)" << endl;
+  const size_t sizes[] = { 64u, 1024u, 16384u, 100000u };
+  for (size_t N : sizes) {
+    RandomInitializer init(N, rng(), 0.5f);
+    Chromosome a = init(), b = init();
+    RandomSplitCrossOver split(N, rng());
+    RandomMixCrossOver mix(rng());
+    std::uniform_int_distribution<size_t> pos_dist(0u, N-1);
+
+    size_t reps = std::max<size_t>(10u, 2000000u / N);
+    double t_split_bits = nsPerCall(reps, [&]{ sink += bitwiseSplit(a, b, pos_dist(rng))[0]; });
+    double t_split_words = nsPerCall(reps, [&]{ sink += split(a, b)[0]; });
+    double t_mix_bits = nsPerCall(reps, [&]{ sink += bitwiseMix(a, b, rng)[0]; });
+    double t_mix_words = nsPerCall(reps, [&]{ sink += mix(a, b)[0]; });
+    cout << setw(8) << N << fixed << setprecision(1)
+         << setw(14) << t_split_bits << setw(14) << t_split_words
+         << setw(14) << t_mix_bits << setw(14) << t_mix_words << endl;
+  }
+  return (sink == 0xFFFFFFFFu) ? 1 : 0;
+}
@@ -0,0 +1,168 @@
+// Micro-benchmarks of the genetic operators and the Decoder, for
+// chromosomes from 64 to 2^20 gens. Run as
+//   ./operators_bench --benchmark_format=json
+// for machine-readable output.
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "chromosome.h"
+#include "crossovers.h"
+#include "initializers.h"
+#include "mutations.h"
+#include "selections.h"
+#include "translators.h"
+
+using namespace GeneticAlgorithms;
+
+// chromosome sizes, 64 ... 2^20 (about 10^6) gens
+#define GENS_RANGE RangeMultiplier(16)->Range(64, 1 << 20)
+// population sizes for the selections
+#define POPULATION_RANGE RangeMultiplier(10)->Range(100, 100000)
+
+static void setGens(benchmark::State &state, const size_t N) {
+  state.SetItemsProcessed(state.iterations() * N);
+  state.SetBytesProcessed(state.iterations() * num_words_for(N) *
+                          sizeof(word_type));
+}
+
+static void BM_RandomInitializer(benchmark::State &state) {
+  const size_t N = state.range(0);
+  RandomInitializer init(N, 1u, 0.5f);
+  for (auto _ : state) {
+    Chromosome x = init();
+    benchmark::DoNotOptimize(x.words());
+  }
+  setGens(state, N);
+}
+BENCHMARK(BM_RandomInitializer)->GENS_RANGE;
+
+template<typename CrossOver>
+static void crossOver(benchmark::State &state, const CrossOver &cross) {
+  const size_t N = state.range(0);
+  RandomInitializer init(N, 1u, 0.5f);
+  const Chromosome a = init(), b = init();
+  Chromosome dest(N);
+  for (auto _ : state) {
+    cross(a, b, dest);
+    benchmark::DoNotOptimize(dest.words());
+  }
+  setGens(state, N);
+}
+
+static void BM_RandomSplitCrossOver(benchmark::State &state) {
+  crossOver(state, RandomSplitCrossOver(state.range(0), 2u));
+}
+BENCHMARK(BM_RandomSplitCrossOver)->GENS_RANGE;
+
+static void BM_RandomMixCrossOver(benchmark::State &state) {
+  crossOver(state, RandomMixCrossOver(2u));
+}
+BENCHMARK(BM_RandomMixCrossOver)->GENS_RANGE;
+
+static void BM_CrossOverOnProb(benchmark::State &state) {
+  crossOver(state, make_cross_over_on_prob(3u, 0.5f, RandomMixCrossOver(2u)));
+}
+BENCHMARK(BM_CrossOverOnProb)->GENS_RANGE;
+
+// second argument is the mutation probability in units of 10^-4,
+// covering both paths of RandomMutate
+static void BM_RandomMutate(benchmark::State &state) {
+  const size_t N = state.range(0);
+  RandomInitializer init(N, 1u, 0.5f);
+  RandomMutate mutate(2u, state.range(1) * 1e-4f);
+  Chromosome x = init();
+  for (auto _ : state) {
+    mutate(x, x);
+    benchmark::DoNotOptimize(x.words());
+  }
+  setGens(state, N);
+}
+BENCHMARK(BM_RandomMutate)->ArgsProduct({benchmark::CreateRange(64, 1 << 20, 16),
+                                         {10, 100, 5000}});
+
+// real vector operators, N values of a FloatVector
+template<typename CrossOver>
+static void realCrossOver(benchmark::State &state, const CrossOver &cross) {
+  const size_t N = state.range(0);
+  UniformFloatInitializer init(N, 1u, -5.0, 5.0);
+  const FloatVector a = init(), b = init();
+  FloatVector dest(N);
+  for (auto _ : state) {
+    cross(a, b, dest);
+    benchmark::DoNotOptimize(dest.data());
+  }
+  state.SetItemsProcessed(state.iterations() * N);
+}
+
+static void BM_SimulatedBinaryCrossOver(benchmark::State &state) {
+  realCrossOver(state, SimulatedBinaryCrossOver(2u, 15.0, -5.0, 5.0));
+}
+BENCHMARK(BM_SimulatedBinaryCrossOver)->RangeMultiplier(16)->Range(16, 1 << 16);
+
+static void BM_BlendCrossOver(benchmark::State &state) {
+  realCrossOver(state, BlendCrossOver(2u, 0.5, -5.0, 5.0));
+}
+BENCHMARK(BM_BlendCrossOver)->RangeMultiplier(16)->Range(16, 1 << 16);
+
+static void BM_PolynomialMutate(benchmark::State &state) {
+  const size_t N = state.range(0);
+  UniformFloatInitializer init(N, 1u, -5.0, 5.0);
+  PolynomialMutate mutate(2u, state.range(1) * 1e-4f, 20.0, -5.0, 5.0);
+  FloatVector x = init();
+  for (auto _ : state) {
+    mutate(x, x);
+    benchmark::DoNotOptimize(x.data());
+  }
+  state.SetItemsProcessed(state.iterations() * N);
+}
+BENCHMARK(BM_PolynomialMutate)->ArgsProduct({benchmark::CreateRange(16, 1 << 16, 16),
+                                             {10, 5000}});
+
+// decodes the whole chromosome as 16 bits floats
+static void BM_Decoder(benchmark::State &state) {
+  const size_t N = state.range(0);
+  RandomInitializer init(N, 1u, 0.5f);
+  const Chromosome x = init();
+  for (auto _ : state) {
+    Decoder decoder(x);
+    float sum = 0.0f;
+    for (size_t i=0; i+16u<=N; i+=16u) sum += decoder.decodeFloat(16u, -5.0f, 5.0f);
+    benchmark::DoNotOptimize(sum);
+  }
+  setGens(state, N);
+}
+BENCHMARK(BM_Decoder)->GENS_RANGE;
+
+template<typename Selection>
+static void selection(benchmark::State &state, const Selection &select) {
+  const size_t n = state.range(0);
+  std::mt19937_64 rng(1u);
+  std::uniform_real_distribution<float> rank_dist(0.0f, 100.0f);
+  std::vector<float> ranks(n);
+  for (float &r : ranks) r = rank_dist(rng);
+  std::vector<IndexCouple> couples(n);
+  for (auto _ : state) {
+    select(ranks, couples);
+    benchmark::DoNotOptimize(couples.data());
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+
+static void BM_RouletteWheelSelection(benchmark::State &state) {
+  selection(state, FloatRouletteWheelSelection(2u));
+}
+BENCHMARK(BM_RouletteWheelSelection)->POPULATION_RANGE;
+
+static void BM_TournamentSelection(benchmark::State &state) {
+  selection(state, FloatTournamentSelection(2u, 2u));
+}
+BENCHMARK(BM_TournamentSelection)->POPULATION_RANGE;
+
+static void BM_TruncationSelection(benchmark::State &state) {
+  selection(state, FloatTruncationSelection(0.5f, 2u));
+}
+BENCHMARK(BM_TruncationSelection)->POPULATION_RANGE;
+
+BENCHMARK_MAIN();
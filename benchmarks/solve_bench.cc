@@ -0,0 +1,210 @@
+// End-to-end benchmarks of the two example problems, reporting
+// generations per second and heap allocations per generation. Run as
+//   ./solve_bench --benchmark_format=json
+// for machine-readable output.
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "chromosome.h"
+#include "crossovers.h"
+#include "genetic_solver.h"
+#include "initializers.h"
+#include "mutations.h"
+#include "selections.h"
+#include "translators.h"
+
+using namespace std;
+
+using namespace GeneticAlgorithms;
+
+// counts every heap allocation of the program; the replacements are
+// not inlined, so the compiler never pairs a counted new with free()
+static std::atomic<size_t> num_allocations(0u);
+
+static void *counted_malloc(size_t size) {
+  num_allocations.fetch_add(1u, std::memory_order_relaxed);
+  void *p = std::malloc(size == 0u ? 1u : size);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+__attribute__((noinline)) void *operator new(size_t size) {
+  return counted_malloc(size);
+}
+
+__attribute__((noinline)) void *operator new[](size_t size) {
+  return counted_malloc(size);
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void *p) noexcept {
+  std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept {
+  std::free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void *p, size_t) noexcept {
+  std::free(p);
+}
+
+#define N 50
+#define GENERATIONS 200u
+
+// example01, maximizes a float decoded from the chromosome
+struct DecodeRank {
+  float operator()(const Chromosome &x) const {
+    Decoder decoder(x);
+    return decoder.decodeFloat(N, -5.0f, 5.0f);
+  }
+};
+
+// example02, knapsack of N objects
+typedef pair<float, float> object_t;
+
+struct KnapsackRank {
+  KnapsackRank() : _objects(N), _Q(5.0f) {
+    std::mt19937_64 rng(12564);
+    std::uniform_real_distribution<float> b_dist(0.0f, 5.0f);
+    std::uniform_real_distribution<float> w_dist(0.0f, 1.0f);
+    for (size_t i=0; i<N; ++i) {
+      float b = b_dist(rng);
+      float w = w_dist(rng);
+      _objects[i] = make_pair(b, w);
+    }
+  }
+  float operator()(const Chromosome &x) const {
+    float W = 0.0f;
+    float B = 0.0f;
+    for (size_t i=0u; i<x.size(); ++i) {
+      if (x[i]) {
+        W += _objects[i].second;
+        if (W > _Q) return 0.0f;
+        B += _objects[i].first;
+      }
+    }
+    return B;
+  }
+  vector<object_t> _objects;
+  float _Q;
+};
+
+static void setCounters(benchmark::State &state, const size_t generations,
+                        const size_t allocations) {
+  state.counters["generations/s"] =
+    benchmark::Counter(double(generations), benchmark::Counter::kIsRate);
+  state.counters["allocs/generation"] = double(allocations) / double(generations);
+}
+
+// a whole evolve() call per iteration, initialization included
+template<typename Rank, typename Init, typename Select, typename Cross,
+         typename Mutate>
+static void solveLoop(benchmark::State &state, SolverOptions options,
+                      const Init &init, const Select &select,
+                      const Cross &cross, const Mutate &mutate) {
+  options.num_iterations = GENERATIONS;
+  options.num_threads = state.range(0);
+  size_t generations = 0u, allocations = 0u;
+  for (auto _ : state) {
+    const size_t before = num_allocations.load();
+    SolverResult<Chromosome, float> result =
+      evolve(options, init, select, cross, mutate, Rank());
+    allocations += num_allocations.load() - before;
+    generations += result.generations;
+    benchmark::DoNotOptimize(result.rank);
+  }
+  setCounters(state, generations, allocations);
+}
+
+// one GeneticSolver::step() per iteration, after initialization
+template<typename Rank, typename Init, typename Select, typename Cross,
+         typename Mutate>
+static void stepLoop(benchmark::State &state, SolverOptions options,
+                     const Init &init, const Select &select,
+                     const Cross &cross, const Mutate &mutate) {
+  options.num_threads = state.range(0);
+  GeneticSolver<float, Init, Select, Cross, Mutate, Rank>
+    solver(options, init, select, cross, mutate, Rank());
+  solver.init();
+  solver.step(); // warms up the buffers of both generations
+  const size_t before = num_allocations.load();
+  for (auto _ : state) {
+    solver.step();
+  }
+  setCounters(state, state.iterations(), num_allocations.load() - before);
+}
+
+static SolverOptions options01() {
+  SolverOptions options;
+  options.population_size = 100u;
+  return options;
+}
+
+static SolverOptions options02() {
+  SolverOptions options;
+  options.population_size = 1000u;
+  return options;
+}
+
+static void BM_Example01Solve(benchmark::State &state) {
+  solveLoop<DecodeRank>(state, options01(),
+                        RandomInitializer(N, 1u, 0.5f),
+                        FloatRouletteWheelSelection(2u),
+                        RandomSplitCrossOver(N, 3u),
+                        RandomMutate(4u, 0.5f));
+}
+BENCHMARK(BM_Example01Solve)->Arg(1)->Arg(4)->UseRealTime();
+
+// as BM_Example01Solve, recording every generation into an event log
+static void BM_Example01SolveLogged(benchmark::State &state) {
+  SolverOptions options = options01();
+  options.log_path = "solve_bench.log";
+  solveLoop<DecodeRank>(state, options,
+                        RandomInitializer(N, 1u, 0.5f),
+                        FloatRouletteWheelSelection(2u),
+                        RandomSplitCrossOver(N, 3u),
+                        RandomMutate(4u, 0.5f));
+  std::remove(options.log_path.c_str());
+}
+BENCHMARK(BM_Example01SolveLogged)->Arg(1)->Arg(4)->UseRealTime();
+
+static void BM_Example01Step(benchmark::State &state) {
+  stepLoop<DecodeRank>(state, options01(),
+                       RandomInitializer(N, 1u, 0.5f),
+                       FloatRouletteWheelSelection(2u),
+                       RandomSplitCrossOver(N, 3u),
+                       RandomMutate(4u, 0.5f));
+}
+BENCHMARK(BM_Example01Step)->Arg(1)->Arg(4)->UseRealTime();
+
+static void BM_Example02Solve(benchmark::State &state) {
+  solveLoop<KnapsackRank>(state, options02(),
+                          RandomInitializer(N, 1u, 0.1f),
+                          FloatRouletteWheelSelection(2u),
+                          make_cross_over_on_prob(3u, 0.5f,
+                                                  RandomMixCrossOver(4u)),
+                          RandomMutate(5u, 0.001f));
+}
+BENCHMARK(BM_Example02Solve)->Arg(1)->Arg(4)->UseRealTime();
+
+static void BM_Example02Step(benchmark::State &state) {
+  stepLoop<KnapsackRank>(state, options02(),
+                         RandomInitializer(N, 1u, 0.1f),
+                         FloatRouletteWheelSelection(2u),
+                         make_cross_over_on_prob(3u, 0.5f,
+                                                 RandomMixCrossOver(4u)),
+                         RandomMutate(5u, 0.001f));
+}
+BENCHMARK(BM_Example02Step)->Arg(1)->Arg(4)->UseRealTime();
+
+BENCHMARK_MAIN();
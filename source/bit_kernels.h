@@ -0,0 +1,367 @@
+/*
+ * This file is part of GeneticAlgorithms toolkit
+ *
+ * Copyright 2017, Francisco Zamora-Martinez
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef BIT_KERNELS_H
+#define BIT_KERNELS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "chromosome.h"
+
+namespace GeneticAlgorithms {
+
+  /**
+   * Word-level kernels used by genetic operators
+   *
+   * All kernels work over arrays of word_type following the layout of
+   * Chromosome and StaticChromosome, so they process 64 gens at once
+   * instead of looping over bits. When the compiler targets AVX2 or
+   * AVX-512 (e.g. -march=native), vectorized versions are used.
+   */
+  namespace kernels {
+
+    /// Copies n words from source to dest
+    inline void copy_words(word_type *dest, const word_type *source,
+                           const size_t n) {
+      if (n > 0u) std::memcpy(dest, source, n * sizeof(word_type));
+    }
+
+    /**
+     * Writes into dest gens [0,pos) from first and gens [pos,n*64)
+     * from second
+     *
+     * Only the word containing position pos is masked, all others are
+     * copied as whole words. dest may be equal to first or second,
+     * then its own words are not copied, otherwise it can't overlap
+     * them.
+     */
+    inline void split_words(word_type *dest,
+                            const word_type *first,
+                            const word_type *second,
+                            const size_t pos,
+                            const size_t n) {
+      const size_t w = std::min(pos / WORD_BITS, n);
+      const size_t r = pos % WORD_BITS;
+      // computed before copying, as dest may be equal to first
+      const bool split = (r != 0u && w < n);
+      word_type middle = 0u;
+      if (split) {
+        const word_type mask = (word_type(1u) << r) - 1u;
+        middle = (first[w] & mask) | (second[w] & ~mask);
+      }
+      if (dest != first) copy_words(dest, first, w);
+      if (dest != second) copy_words(dest + w, second + w, n - w);
+      if (split) dest[w] = middle;
+    }
+
+    /**
+     * Bitwise selection: dest = (a & masks) | (b & ~masks)
+     *
+     * Every bit of masks decides which input provides the
+     * corresponding bit of dest. dest may be equal to a or b.
+     */
+    inline void blend_words(word_type *dest,
+                            const word_type *a,
+                            const word_type *b,
+                            const word_type *masks,
+                            const size_t n) {
+      size_t i = 0u;
+#if defined(__AVX512F__)
+      for (; i + 8u <= n; i += 8u) {
+        const __m512i m = _mm512_loadu_si512(masks + i);
+        const __m512i x = _mm512_loadu_si512(a + i);
+        const __m512i y = _mm512_loadu_si512(b + i);
+        // truth table 0xCA is (m ? x : y)
+        _mm512_storeu_si512(dest + i, _mm512_ternarylogic_epi64(m, x, y, 0xCA));
+      }
+#elif defined(__AVX2__)
+      for (; i + 4u <= n; i += 4u) {
+        const __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(masks + i));
+        const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        const __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i),
+                            _mm256_or_si256(_mm256_and_si256(m, x),
+                                            _mm256_andnot_si256(m, y)));
+      }
+#endif
+      for (; i < n; ++i) {
+        dest[i] = (a[i] & masks[i]) | (b[i] & ~masks[i]);
+      }
+    }
+
+    /// Number of random words generated at once by uniform_blend_words
+    static const size_t MASK_BLOCK_WORDS = 64u;
+
+    /**
+     * Mixes a and b taking every bit from any of them with 0.5
+     * probability
+     *
+     * Random masks are drawn from a 64 bits generator (as
+     * std::mt19937_64) in blocks held on the stack, so no memory is
+     * allocated.
+     */
+    template<typename RNG>
+    void uniform_blend_words(word_type *dest,
+                             const word_type *a,
+                             const word_type *b,
+                             const size_t n,
+                             RNG &rng) {
+      word_type masks[MASK_BLOCK_WORDS];
+      for (size_t i=0; i<n; i+=MASK_BLOCK_WORDS) {
+        const size_t len = std::min(MASK_BLOCK_WORDS, n - i);
+        for (size_t j=0; j<len; ++j) masks[j] = static_cast<word_type>(rng());
+        blend_words(dest + i, a + i, b + i, masks, len);
+      }
+    }
+
+    /// Number of bits set in x
+    inline unsigned popcount(const word_type x) {
+#if defined(__GNUC__)
+      return static_cast<unsigned>(__builtin_popcountll(x));
+#else
+      word_type v = x - ((x >> 1) & 0x5555555555555555ULL);
+      v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+      v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+      return static_cast<unsigned>((v * 0x0101010101010101ULL) >> 56);
+#endif
+    }
+
+    /// Position of the least significant bit set in x, x can't be zero
+    inline unsigned lowest_bit(const word_type x) {
+#if defined(__GNUC__)
+      return static_cast<unsigned>(__builtin_ctzll(x));
+#else
+      return popcount((x & (~x + 1u)) - 1u);
+#endif
+    }
+
+    /// Appends offset + position of every bit set in mask, in order
+    inline void append_positions(word_type mask, const size_t offset,
+                                 std::vector<size_t> &out) {
+      while (mask) {
+        out.push_back(offset + lowest_bit(mask));
+        mask &= mask - 1u;
+      }
+    }
+
+    /**
+     * Counts the ones of every gen over many rows of words, in time
+     * linear in the number of words
+     *
+     * Counters are bit-sliced: plane p holds bit p of the counter of
+     * every gen, so adding a row is a ripple-carry addition of its
+     * words (AND and XOR over 64 gens at once), which stops as soon as
+     * the carry is zero, two planes on average. Planes are added as
+     * counters grow, log2(rows) at most, and counts() converts them
+     * into integers only once.
+     *
+     * ATTENTION: no thread safe object
+     */
+    class ColumnCounter {
+    public:
+      explicit ColumnCounter(const size_t num_words=0u) :
+        _num_words(num_words), _num_planes(0u), _rows(0u) {
+      }
+
+      /// Clears all counters, for rows of num_words words
+      void reset(const size_t num_words) {
+        _num_words = num_words;
+        _num_planes = 0u;
+        _rows = 0u;
+        _planes.clear();
+      }
+
+      /// Adds the gens of a row of numWords() words
+      void add(const word_type *words) {
+        for (size_t w=0; w<_num_words; ++w) {
+          word_type carry = words[w];
+          for (size_t p=0; carry; ++p) {
+            if (p == _num_planes) addPlane();
+            word_type &c = _planes[p * _num_words + w];
+            const word_type next = c & carry;
+            c ^= carry;
+            carry = next;
+          }
+        }
+        ++_rows;
+      }
+
+      size_t numWords() const {
+        return _num_words;
+      }
+
+      /// Number of rows added since reset()
+      size_t rows() const {
+        return _rows;
+      }
+
+      /// Writes the count of every gen into counts, numWords() * 64 of them
+      void counts(size_t *counts) const {
+        std::fill(counts, counts + _num_words * WORD_BITS, size_t(0u));
+        for (size_t p=0; p<_num_planes; ++p) {
+          const size_t weight = size_t(1u) << p;
+          for (size_t w=0; w<_num_words; ++w) {
+            for (word_type x = _planes[p * _num_words + w]; x; x &= x - 1u) {
+              counts[w * WORD_BITS + lowest_bit(x)] += weight;
+            }
+          }
+        }
+      }
+
+    private:
+      size_t _num_words;
+      size_t _num_planes;
+      size_t _rows;
+      /// _num_planes planes of _num_words words
+      std::vector<word_type> _planes;
+
+      void addPlane() {
+        _planes.resize((++_num_planes) * _num_words, 0u);
+      }
+    };
+
+    /// Mask with the valid gens of the last word of an n gens array
+    inline word_type last_word_mask(const size_t n) {
+      const size_t r = n % WORD_BITS;
+      return (r == 0u) ? ~word_type(0u) : ((word_type(1u) << r) - 1u);
+    }
+
+    /// Mask with the n least significant bits set, n in [0,64]
+    inline word_type low_mask(const size_t n) {
+      return (n >= WORD_BITS) ? ~word_type(0u) : ((word_type(1u) << n) - 1u);
+    }
+
+    /**
+     * Reads the n gens starting at pos as an unsigned value, gen pos
+     * being its least significant bit, n in [1,64]
+     *
+     * At most two words are read, the next one only when the field
+     * crosses a word boundary.
+     */
+    inline uint64_t extract_bits(const word_type *words, const size_t pos,
+                                 const size_t n) {
+      const size_t w = pos / WORD_BITS, b = pos % WORD_BITS;
+      word_type x = words[w] >> b;
+      if (b + n > WORD_BITS) x |= words[w + 1u] << (WORD_BITS - b);
+      return x & low_mask(n);
+    }
+
+    /**
+     * Writes the n least significant bits of value into the gens
+     * starting at pos, the inverse of extract_bits()
+     */
+    inline void deposit_bits(word_type *words, const size_t pos,
+                             const size_t n, uint64_t value) {
+      const size_t w = pos / WORD_BITS, b = pos % WORD_BITS;
+      const word_type mask = low_mask(n);
+      value &= mask;
+      words[w] = (words[w] & ~(mask << b)) | (value << b);
+      if (b + n > WORD_BITS) {
+        const size_t r = WORD_BITS - b;
+        words[w + 1u] = (words[w + 1u] & ~(mask >> r)) | (value >> r);
+      }
+    }
+
+    /// Reflected binary (Gray) code of x
+    inline uint64_t gray_encode(const uint64_t x) {
+      return x ^ (x >> 1u);
+    }
+
+    /// Inverse of gray_encode(), a prefix XOR computed in six steps
+    inline uint64_t gray_decode(uint64_t x) {
+      x ^= x >> 1u;
+      x ^= x >> 2u;
+      x ^= x >> 4u;
+      x ^= x >> 8u;
+      x ^= x >> 16u;
+      x ^= x >> 32u;
+      return x;
+    }
+
+    /**
+     * Samples words whose bits follow a Bernoulli distribution
+     *
+     * The probability is rounded to PRECISION_BITS binary digits,
+     * p = 0.b1 b2 ... bK, and every word is composed from K uniform
+     * random words, starting at the least significant digit: a digit
+     * equal to 1 ORs the partial mask with a random word (p' = 1/2 +
+     * p/2) and a digit equal to 0 ANDs them (p' = p/2). Trailing zero
+     * digits are skipped, so probability 0.5 costs a single random
+     * word per 64 bits.
+     */
+    class BernoulliWordSampler {
+    public:
+      static const unsigned PRECISION_BITS = 16u;
+
+      explicit BernoulliWordSampler(const float prob) {
+        const double scale = double(uint32_t(1u) << PRECISION_BITS);
+        double q = std::floor(double(prob) * scale + 0.5);
+        q = std::max(0.0, std::min(q, scale));
+        _q = static_cast<uint32_t>(q);
+        // skip trailing zero digits
+        _shift = 0u;
+        while (_shift < PRECISION_BITS && _q != 0u &&
+               ((_q >> _shift) & 1u) == 0u) ++_shift;
+      }
+
+      template<typename RNG>
+      word_type operator()(RNG &rng) const {
+        if (_q == 0u) return word_type(0u);
+        if (_q == (uint32_t(1u) << PRECISION_BITS)) return ~word_type(0u);
+        word_type m = 0u;
+        for (unsigned j=_shift; j<PRECISION_BITS; ++j) {
+          const word_type r = static_cast<word_type>(rng());
+          if ((_q >> j) & 1u) m |= r;
+          else m &= r;
+        }
+        return m;
+      }
+
+      /// The probability effectively sampled
+      double probability() const {
+        return double(_q) / double(uint32_t(1u) << PRECISION_BITS);
+      }
+
+    private:
+      uint32_t _q;
+      unsigned _shift;
+    }; // class BernoulliWordSampler
+
+  } // namespace kernels
+
+} // namespace GeneticAlgorithms
+
+#endif // BIT_KERNELS_H
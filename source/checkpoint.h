@@ -0,0 +1,439 @@
+/*
+ * This file is part of GeneticAlgorithms toolkit
+ *
+ * Copyright 2017, Francisco Zamora-Martinez
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "chromosome.h"
+
+namespace GeneticAlgorithms {
+
+  /**
+   * Header of a population snapshot, the first bytes of the file
+   *
+   * A snapshot file is laid out as the header followed by four
+   * sections, each one starting at a multiple of SNAPSHOT_ALIGNMENT
+   * bytes so they can be read in place from a memory map:
+   *
+   * - words: num_genomes rows of num_words word_type, the packed gens
+   *   of every Chromosome of the population.
+   * - ranks: num_genomes ranks of rank_size bytes.
+   * - best: num_words word_type of the best Chromosome found, followed
+   *   by its rank.
+   * - state: state_size bytes of text, the random generators of the
+   *   genetic operators (see save_state()).
+   *
+   * Numbers are stored with the byte order of the host, so snapshots
+   * are only portable between hosts with the same one.
+   */
+  struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t rank_size;
+    uint64_t file_size;
+    uint64_t num_genomes;
+    uint64_t num_gens;
+    uint64_t num_words;
+    uint64_t generation;
+    uint64_t last_improvement;
+    uint64_t evaluations;
+    double seconds;
+    uint64_t words_offset;
+    uint64_t ranks_offset;
+    uint64_t best_offset;
+    uint64_t state_offset;
+    uint64_t state_size;
+  };
+
+  static const char SNAPSHOT_MAGIC[8] = {'G','A','S','N','A','P','\0','\0'};
+  static const uint32_t SNAPSHOT_VERSION = 1u;
+  static const uint64_t SNAPSHOT_ALIGNMENT = 64u;
+
+  namespace detail {
+
+    inline uint64_t align_offset(const uint64_t offset) {
+      return (offset + SNAPSHOT_ALIGNMENT - 1u) / SNAPSHOT_ALIGNMENT *
+        SNAPSHOT_ALIGNMENT;
+    }
+
+    /// Directory of a path, for fsync() of renamed files
+    inline std::string directory_of(const std::string &path) {
+      const size_t slash = path.rfind('/');
+      if (slash == std::string::npos) return ".";
+      if (slash == 0u) return "/";
+      return path.substr(0u, slash);
+    }
+
+    /// true when offset + count * size <= limit, without overflows
+    inline bool section_fits(const uint64_t offset, const uint64_t count,
+                             const uint64_t size, const uint64_t limit) {
+      return offset <= limit &&
+        (size == 0u || count <= (limit - offset) / size);
+    }
+
+    inline std::runtime_error io_error(const std::string &what,
+                                       const std::string &path) {
+      return std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+    }
+
+  } // namespace detail
+
+  /**
+   * Returns a header with the offsets and size of a snapshot of
+   * num_genomes Chromosomes and state_size bytes of operators state,
+   * the rest of fields being zero
+   *
+   * Every genome takes num_words words, num_words_for(num_gens) for
+   * Chromosomes, other genome types (as Permutation) give their
+   * numWords().
+   */
+  template<typename T>
+  SnapshotHeader snapshot_layout(const size_t num_genomes,
+                                 const size_t num_gens,
+                                 const size_t state_size,
+                                 const size_t num_words) {
+    SnapshotHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+    h.version = SNAPSHOT_VERSION;
+    h.rank_size = sizeof(T);
+    h.num_genomes = num_genomes;
+    h.num_gens = num_gens;
+    h.num_words = num_words;
+    const uint64_t row_bytes = h.num_words * sizeof(word_type);
+    h.words_offset = detail::align_offset(sizeof(SnapshotHeader));
+    h.ranks_offset = detail::align_offset(h.words_offset + num_genomes * row_bytes);
+    h.best_offset = detail::align_offset(h.ranks_offset + num_genomes * sizeof(T));
+    h.state_offset = detail::align_offset(h.best_offset + row_bytes + sizeof(T));
+    h.state_size = state_size;
+    h.file_size = h.state_offset + state_size;
+    return h;
+  }
+
+  /**
+   * Writes snapshots to a file from a background thread
+   *
+   * The writer keeps two buffers: the caller serializes a snapshot
+   * into buffer() and hands it over with commit(), and the thread
+   * writes it into a temporary file, calls fsync() and renames it
+   * over the given path, so the file always holds a complete
+   * snapshot. Meanwhile the next snapshot can be serialized into the
+   * other buffer, and buffer() only waits when both of them are busy,
+   * so the solver stalls for a memory copy instead of the disk.
+   *
+   * I/O errors of the thread are thrown by the next call to buffer()
+   * or flush().
+   *
+   * ATTENTION: buffer() and commit() should be called from one thread.
+   *
+   * @code
+   * CheckpointWriter writer("run.snapshot");
+   * std::vector<char> &buffer = writer.buffer();
+   * serialize_into(buffer);
+   * writer.commit();
+   * @endcode
+   */
+  class CheckpointWriter {
+  public:
+    explicit CheckpointWriter(const std::string &path) :
+      _path(path),
+      _filled(0),
+      _queued(-1),
+      _writing(-1),
+      _written(0u),
+      _stop(false),
+      _thread([this]{ writeLoop(); }) {
+    }
+
+    /// Writes the committed snapshots before returning
+    ~CheckpointWriter() {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+      }
+      _cv.notify_all();
+      _thread.join();
+    }
+
+    CheckpointWriter(const CheckpointWriter &) = delete;
+    CheckpointWriter &operator=(const CheckpointWriter &) = delete;
+
+    /// The file written by the writer
+    const std::string &path() const {
+      return _path;
+    }
+
+    /**
+     * Returns the buffer for the next snapshot, waiting until the
+     * thread is done with it
+     *
+     * The whole buffer is written to the file at commit().
+     */
+    std::vector<char> &buffer() {
+      std::unique_lock<std::mutex> lock(_mutex);
+      const int next = 1 - _filled;
+      _cv.wait(lock, [this, next]{ return _queued != next && _writing != next; });
+      rethrow();
+      _filled = next;
+      return _buffers[next];
+    }
+
+    /// Queues the last buffer() for writing and returns immediately
+    void commit() {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queued = _filled;
+      }
+      _cv.notify_all();
+    }
+
+    /// Waits until every committed snapshot is on disk
+    void flush() {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _cv.wait(lock, [this]{ return _queued < 0 && _writing < 0; });
+      rethrow();
+    }
+
+    /// Number of snapshots written to disk
+    size_t written() const {
+      std::lock_guard<std::mutex> lock(_mutex);
+      return _written;
+    }
+
+  private:
+    const std::string _path;
+    std::vector<char> _buffers[2];
+    /// buffer returned by the last call to buffer()
+    int _filled;
+    /// buffer waiting for the thread, -1 if none
+    int _queued;
+    /// buffer being written by the thread, -1 if none
+    int _writing;
+    size_t _written;
+    bool _stop;
+    std::exception_ptr _error;
+    mutable std::mutex _mutex;
+    std::condition_variable _cv;
+    std::thread _thread;
+
+    /// throws the error of the thread, _mutex must be locked
+    void rethrow() {
+      if (_error) {
+        std::exception_ptr error = _error;
+        _error = std::exception_ptr();
+        std::rethrow_exception(error);
+      }
+    }
+
+    void writeLoop() {
+      std::unique_lock<std::mutex> lock(_mutex);
+      for (;;) {
+        _cv.wait(lock, [this]{ return _stop || _queued >= 0; });
+        if (_queued < 0) return; // stopped and nothing left
+        _writing = _queued;
+        _queued = -1;
+        const std::vector<char> &data = _buffers[_writing];
+        lock.unlock();
+        std::exception_ptr error;
+        try {
+          writeFile(data);
+        }
+        catch (...) {
+          error = std::current_exception();
+        }
+        lock.lock();
+        if (error) _error = error;
+        else ++_written;
+        _writing = -1;
+        _cv.notify_all();
+      }
+    }
+
+    void writeFile(const std::vector<char> &data) const {
+      const std::string tmp = _path + ".tmp";
+      const int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (fd < 0) throw detail::io_error("cannot create", tmp);
+      size_t done = 0u;
+      while (done < data.size()) {
+        const ssize_t k = ::write(fd, data.data() + done, data.size() - done);
+        if (k < 0 && errno == EINTR) continue;
+        if (k <= 0) {
+          ::close(fd);
+          throw detail::io_error("cannot write", tmp);
+        }
+        done += static_cast<size_t>(k);
+      }
+      if (::fsync(fd) != 0) {
+        ::close(fd);
+        throw detail::io_error("cannot sync", tmp);
+      }
+      ::close(fd);
+      if (std::rename(tmp.c_str(), _path.c_str()) != 0) {
+        throw detail::io_error("cannot rename", tmp);
+      }
+      // makes the rename durable
+      const std::string dir = detail::directory_of(_path);
+      const int dir_fd = ::open(dir.c_str(), O_RDONLY);
+      if (dir_fd >= 0) {
+        ::fsync(dir_fd);
+        ::close(dir_fd);
+      }
+    }
+  }; // class CheckpointWriter
+
+  /**
+   * A snapshot file mapped in memory, read only
+   *
+   * The file is validated at construction, throwing
+   * std::runtime_error when it isn't a complete snapshot. Sections
+   * are read in place, so opening a snapshot doesn't depend on its
+   * size, and pages are loaded by the system when they are read.
+   */
+  class Snapshot {
+  public:
+    explicit Snapshot(const std::string &path) :
+      _data(0), _size(0u) {
+      const int fd = ::open(path.c_str(), O_RDONLY);
+      if (fd < 0) throw detail::io_error("cannot open", path);
+      struct stat st;
+      if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw detail::io_error("cannot stat", path);
+      }
+      _size = static_cast<size_t>(st.st_size);
+      if (_size < sizeof(SnapshotHeader)) {
+        ::close(fd);
+        throw std::runtime_error("not a snapshot " + path);
+      }
+      void *data = ::mmap(0, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+      ::close(fd);
+      if (data == MAP_FAILED) throw detail::io_error("cannot map", path);
+      _data = static_cast<const char*>(data);
+      if (!valid()) {
+        ::munmap(const_cast<char*>(_data), _size);
+        throw std::runtime_error("not a snapshot " + path);
+      }
+    }
+
+    ~Snapshot() {
+      ::munmap(const_cast<char*>(_data), _size);
+    }
+
+    Snapshot(const Snapshot &) = delete;
+    Snapshot &operator=(const Snapshot &) = delete;
+
+    /// true when a file exists at the given path
+    static bool exists(const std::string &path) {
+      return ::access(path.c_str(), R_OK) == 0;
+    }
+
+    const SnapshotHeader &header() const {
+      return *reinterpret_cast<const SnapshotHeader*>(_data);
+    }
+
+    /// The matrix of words, one row of header().num_words per Chromosome
+    const word_type *words() const {
+      return reinterpret_cast<const word_type*>(_data + header().words_offset);
+    }
+
+    /// The ranks of the population, T should match header().rank_size
+    template<typename T>
+    const T *ranks() const {
+      check<T>();
+      return reinterpret_cast<const T*>(_data + header().ranks_offset);
+    }
+
+    /// The words of the best Chromosome
+    const word_type *bestWords() const {
+      return reinterpret_cast<const word_type*>(_data + header().best_offset);
+    }
+
+    template<typename T>
+    T bestRank() const {
+      check<T>();
+      T rank;
+      std::memcpy(&rank, bestWords() + header().num_words, sizeof(T));
+      return rank;
+    }
+
+    /// The text state of the genetic operators
+    std::string state() const {
+      return std::string(_data + header().state_offset, header().state_size);
+    }
+
+  private:
+    const char *_data;
+    size_t _size;
+
+    bool valid() const {
+      const SnapshotHeader &h = header();
+      // sizes are bounded by the file before multiplying them, as the
+      // header may be corrupt
+      if (std::memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic)) != 0 ||
+          h.version != SNAPSHOT_VERSION || h.file_size != _size ||
+          h.num_words > h.file_size / sizeof(word_type) ||
+          h.num_gens > h.num_words * WORD_BITS ||
+          h.rank_size > h.file_size) return false;
+      const uint64_t row_bytes = h.num_words * sizeof(word_type);
+      return detail::section_fits(h.words_offset, h.num_genomes, row_bytes,
+                                  h.ranks_offset) &&
+        detail::section_fits(h.ranks_offset, h.num_genomes, h.rank_size,
+                             h.best_offset) &&
+        detail::section_fits(h.best_offset, 1u, row_bytes + h.rank_size,
+                             h.state_offset) &&
+        h.state_offset <= h.file_size &&
+        h.state_size == h.file_size - h.state_offset;
+    }
+
+    template<typename T>
+    void check() const {
+      if (header().rank_size != sizeof(T)) {
+        throw std::runtime_error("snapshot rank type mismatch");
+      }
+    }
+  }; // class Snapshot
+
+} // namespace GeneticAlgorithms
+
+#endif // CHECKPOINT_H
@@ -28,21 +28,67 @@
 #ifndef CHROMOSOME_H
 #define CHROMOSOME_H
 
+#include <array>
 #include <boost/dynamic_bitset.hpp>
+#include <cassert>
 #include <cstdint>
 #include <cmath>
 #include <numeric>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace GeneticAlgorithms {
 
   typedef boost::dynamic_bitset< > bitset;
-  
+
+  /// Chromosome gens are packed into words of this type
+  typedef uint64_t word_type;
+
+  /// Number of gens stored at every word
+  static const size_t WORD_BITS = 64u;
+
+  /// Number of words needed to store n gens
+  inline size_t num_words_for(const size_t n) {
+    return (n + WORD_BITS - 1u) / WORD_BITS;
+  }
+
+  /// A couple of parents given by their positions in a population
+  typedef std::pair<size_t, size_t> IndexCouple;
+
+  namespace detail {
+
+    /// Copies the gens of a bitset into an array of zeroed words
+    inline void bitset_to_words(const bitset &gens, word_type *words) {
+      for (size_t i = gens.find_first(); i != bitset::npos;
+           i = gens.find_next(i)) {
+        words[i / WORD_BITS] |= word_type(1u) << (i % WORD_BITS);
+      }
+    }
+
+    /// Builds a bitset with the first n gens of the given words
+    inline bitset words_to_bitset(const word_type *words, const size_t n) {
+      bitset gens(n);
+      for (size_t i=0; i<n; ++i) {
+        if ( (words[i / WORD_BITS] >> (i % WORD_BITS)) & 1u ) gens.set(i);
+      }
+      return gens;
+    }
+
+  } // namespace detail
+
   /**
    * A class which represents a complete chromosome for genetic algorithms
    *
    * A Chromosome is represented by its gens combination (a bits
-   * set). Indeed, it is a wrapper over a boost::dynamic_bitset in
-   * order to make it inmutable.
+   * set). The gens are packed into a contiguous array of 64 bits
+   * words, gen i being the bit (i % 64) of word (i / 64), and the
+   * padding bits of the last word are always zero. The number of
+   * gens is given at run time.
+   *
+   * The public interface only reads gens, the mutators set() and
+   * flip() and the non-const words() are meant to be used by genetic
+   * operators for the construction of new chromosomes.
    *
    * A set of utilities is available at `translators.h` which allow
    * the programmer to decode Chromosomes into a different C++
@@ -53,28 +99,176 @@ namespace GeneticAlgorithms {
     typedef std::pair<Chromosome, Chromosome > Couple;
 
     Chromosome(const bitset &gens) :
-      _gens(gens) {
+      _words(num_words_for(gens.size()), 0u),
+      _size(gens.size()) {
+      detail::bitset_to_words(gens, _words.data());
+    }
+
+    /// Builds a chromosome with N gens set to zero
+    explicit Chromosome(const size_t N) :
+      _words(num_words_for(N), 0u),
+      _size(N) {
     }
 
-    Chromosome() {
+    Chromosome() :
+      _size(0u) {
     }
 
     bool operator[](const size_t i) const {
-      return _gens[i];
+      return (_words[i / WORD_BITS] >> (i % WORD_BITS)) & 1u;
     }
 
     size_t size() const {
-      return _gens.size();
+      return _size;
+    }
+
+    /// returns a copy of the gens as a bits set
+    bitset gens() const {
+      return detail::words_to_bitset(_words.data(), _size);
     }
 
-    const bitset &gens() const {
-      return _gens;
+    size_t numWords() const {
+      return _words.size();
+    }
+
+    const word_type *words() const {
+      return _words.data();
+    }
+
+    word_type *words() {
+      return _words.data();
+    }
+
+    void set(const size_t i, const bool value=true) {
+      const word_type mask = word_type(1u) << (i % WORD_BITS);
+      if (value) _words[i / WORD_BITS] |= mask;
+      else _words[i / WORD_BITS] &= ~mask;
+    }
+
+    void flip(const size_t i) {
+      _words[i / WORD_BITS] ^= word_type(1u) << (i % WORD_BITS);
+    }
+
+    /**
+     * Changes the number of gens, new gens are set to zero
+     *
+     * Memory is only allocated when the chromosome grows over its
+     * previous capacity, so genetic operators use this method to
+     * write into reused chromosomes.
+     */
+    void resize(const size_t N) {
+      _words.resize(num_words_for(N), 0u);
+      _size = N;
+      if (N % WORD_BITS != 0u) {
+        _words.back() &= (word_type(1u) << (N % WORD_BITS)) - 1u;
+      }
     }
 
   private:
-    bitset _gens;
+    std::vector<word_type> _words;
+    size_t _size;
   }; // class Chromosome
 
+  /**
+   * A Chromosome whose number of gens is known at compilation time
+   *
+   * It has the same interface as Chromosome, but its gens are stored
+   * in a std::array, so it never allocates memory in the heap and a
+   * vector of StaticChromosome is a contiguous block of gens. All
+   * genetic operators work with both classes.
+   *
+   * @code
+   * const size_t N = 50;
+   * StaticChromosome<N> best = solve(10000u, 100u,
+   *                                  BasicRandomInitializer<StaticChromosome<N> >(N, rng(), 0.5f),
+   *                                  ...);
+   * @endcode
+   */
+  template<size_t N>
+  class StaticChromosome {
+  public:
+    typedef std::pair<StaticChromosome, StaticChromosome > Couple;
+
+    static const size_t NUM_WORDS = (N + WORD_BITS - 1u) / WORD_BITS;
+
+    StaticChromosome(const bitset &gens) {
+      assert(gens.size() == N);
+      _words.fill(0u);
+      detail::bitset_to_words(gens, _words.data());
+    }
+
+    /// Builds a chromosome with all gens set to zero, n should be N
+    explicit StaticChromosome(const size_t n) {
+      assert(n == N);
+      (void)n;
+      _words.fill(0u);
+    }
+
+    StaticChromosome() {
+      _words.fill(0u);
+    }
+
+    bool operator[](const size_t i) const {
+      return (_words[i / WORD_BITS] >> (i % WORD_BITS)) & 1u;
+    }
+
+    size_t size() const {
+      return N;
+    }
+
+    /// returns a copy of the gens as a bits set
+    bitset gens() const {
+      return detail::words_to_bitset(_words.data(), N);
+    }
+
+    size_t numWords() const {
+      return NUM_WORDS;
+    }
+
+    const word_type *words() const {
+      return _words.data();
+    }
+
+    word_type *words() {
+      return _words.data();
+    }
+
+    void set(const size_t i, const bool value=true) {
+      const word_type mask = word_type(1u) << (i % WORD_BITS);
+      if (value) _words[i / WORD_BITS] |= mask;
+      else _words[i / WORD_BITS] &= ~mask;
+    }
+
+    void flip(const size_t i) {
+      _words[i / WORD_BITS] ^= word_type(1u) << (i % WORD_BITS);
+    }
+
+    /// Only for compatibility with Chromosome, n should be N
+    void resize(const size_t n) {
+      assert(n == N);
+      (void)n;
+    }
+
+  private:
+    std::array<word_type, NUM_WORDS> _words;
+  }; // class StaticChromosome
+
+  template<size_t N>
+  const size_t StaticChromosome<N>::NUM_WORDS;
+
+  /// True for the genomes whose words are their gens, one bit each
+  template<typename Genome>
+  struct is_bit_genome : std::false_type {
+  };
+
+  template<>
+  struct is_bit_genome<Chromosome> : std::true_type {
+  };
+
+  template<size_t N>
+  struct is_bit_genome<StaticChromosome<N> > : std::true_type {
+  };
+
 } // namespace GeneticAlgorithms
 
 #endif // CHROMOSOME_H
@@ -0,0 +1,145 @@
+/*
+ * This file is part of GeneticAlgorithms toolkit
+ *
+ * Copyright 2017, Francisco Zamora-Martinez
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef CONCURRENT_QUEUE_H
+#define CONCURRENT_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace GeneticAlgorithms {
+
+  /**
+   * A bounded lock-free queue for multiple producers and consumers
+   *
+   * It follows the algorithm of Dmitry Vyukov: every cell has a
+   * sequence number which tells producers and consumers whether the
+   * cell is ready for them, so push and pop only need one
+   * compare-and-swap in the common case and never block. The capacity
+   * is rounded up to a power of two and all cells are allocated at
+   * construction. When the queue is full tryPush() fails instead of
+   * waiting.
+   *
+   * Item should be default constructible and copy assignable.
+   */
+  template<typename Item>
+  class ConcurrentQueue {
+  public:
+    explicit ConcurrentQueue(const size_t capacity) {
+      size_t n = 2u;
+      while (n < capacity) n <<= 1u;
+      _mask = n - 1u;
+      _cells.reset(new Cell[n]);
+      for (size_t i=0; i<n; ++i) {
+        _cells[i].sequence.store(i, std::memory_order_relaxed);
+      }
+      _enqueue_pos.store(0u, std::memory_order_relaxed);
+      _dequeue_pos.store(0u, std::memory_order_relaxed);
+    }
+
+    ConcurrentQueue(const ConcurrentQueue &) = delete;
+    ConcurrentQueue &operator=(const ConcurrentQueue &) = delete;
+
+    size_t capacity() const {
+      return _mask + 1u;
+    }
+
+    /// Copies x into the queue, returns false if it is full
+    bool tryPush(const Item &x) {
+      Cell *cell;
+      size_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+      for (;;) {
+        cell = &_cells[pos & _mask];
+        const size_t seq = cell->sequence.load(std::memory_order_acquire);
+        const std::ptrdiff_t dif =
+          static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+        if (dif == 0) {
+          if (_enqueue_pos.compare_exchange_weak(pos, pos + 1u,
+                                                 std::memory_order_relaxed)) {
+            break;
+          }
+        }
+        else if (dif < 0) {
+          return false; // full
+        }
+        else {
+          pos = _enqueue_pos.load(std::memory_order_relaxed);
+        }
+      }
+      cell->data = x;
+      cell->sequence.store(pos + 1u, std::memory_order_release);
+      return true;
+    }
+
+    /// Copies the oldest item into x, returns false if it is empty
+    bool tryPop(Item &x) {
+      Cell *cell;
+      size_t pos = _dequeue_pos.load(std::memory_order_relaxed);
+      for (;;) {
+        cell = &_cells[pos & _mask];
+        const size_t seq = cell->sequence.load(std::memory_order_acquire);
+        const std::ptrdiff_t dif =
+          static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1u);
+        if (dif == 0) {
+          if (_dequeue_pos.compare_exchange_weak(pos, pos + 1u,
+                                                 std::memory_order_relaxed)) {
+            break;
+          }
+        }
+        else if (dif < 0) {
+          return false; // empty
+        }
+        else {
+          pos = _dequeue_pos.load(std::memory_order_relaxed);
+        }
+      }
+      x = cell->data;
+      cell->sequence.store(pos + _mask + 1u, std::memory_order_release);
+      return true;
+    }
+
+  private:
+    struct Cell {
+      std::atomic<size_t> sequence;
+      Item data;
+    };
+
+    /// padding avoids false sharing between producers and consumers
+    char _pad0[64];
+    std::unique_ptr<Cell[]> _cells;
+    size_t _mask;
+    char _pad1[64];
+    std::atomic<size_t> _enqueue_pos;
+    char _pad2[64];
+    std::atomic<size_t> _dequeue_pos;
+    char _pad3[64];
+  }; // class ConcurrentQueue
+
+} // namespace GeneticAlgorithms
+
+#endif // CONCURRENT_QUEUE_H
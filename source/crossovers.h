@@ -30,9 +30,19 @@
 
 #include <algorithm>
 #include <boost/dynamic_bitset.hpp>
+#include <istream>
+#include <ostream>
 #include <random>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
+#include "bit_kernels.h"
 #include "chromosome.h"
+#include "operator_traits.h"
+#include "permutation.h"
+#include "real_kernels.h"
+#include "real_vector.h"
 
 namespace GeneticAlgorithms {
 
@@ -43,44 +53,92 @@ namespace GeneticAlgorithms {
    * random integer, and producing a child which mixes together one
    * piece of one parent and the other from the other parent.
    *
+   * The functor works with any genome type (Chromosome,
+   * StaticChromosome), producing a child of the same type. The RNG
+   * template argument is the internal random generator (see
+   * random.h), RandomSplitCrossOver uses std::mt19937_64.
+   *
    * ATTENTION: no thread safe object, it should be created for each
-   * thread in your program.
+   * thread in your program, or used through the overload which
+   * receives a random generator.
    */
-  class RandomSplitCrossOver {
+  template<typename RNG = std::mt19937_64>
+  class BasicRandomSplitCrossOver {
   public:
-    RandomSplitCrossOver(size_t N, unsigned seed) :
+    BasicRandomSplitCrossOver(size_t N, unsigned seed) :
       _rng(seed),
-      _int_dist(0uL, N-1),
-      _binary_dist(0uL, 1uL) {
+      _N(N) {
+    }
+
+    /// Restarts the random generator with the given seed
+    void seed(unsigned seed) {
+      _rng.seed(seed);
+    }
+
+    /// Writes the state of the random generator, see save_state()
+    void saveState(std::ostream &os) const {
+      os << _rng << ' ';
     }
 
-    Chromosome operator()(const Chromosome &a, const Chromosome &b) const {
-      bitset dest(a.size());
+    /// Restores a state written by saveState()
+    void loadState(std::istream &is) const {
+      is >> _rng;
+    }
+
+    template<typename Genome>
+    Genome operator()(const Genome &a, const Genome &b) const {
+      Genome dest(a.size());
+      (*this)(a, b, dest);
+      return dest;
+    }
+
+    /**
+     * As operator()(a, b) for temporary parents, the child is written
+     * into the memory of a and returned without allocating
+     */
+    template<typename Genome,
+             typename = typename std::enable_if<!std::is_lvalue_reference<Genome>::value>::type>
+    Genome operator()(Genome &&a, Genome &&b) const {
+      (*this)(a, b, a, _rng);
+      return std::move(a);
+    }
+
+    /// Writes the child into dest, reusing its memory
+    template<typename Genome>
+    void operator()(const Genome &a, const Genome &b, Genome &dest) const {
+      (*this)(a, b, dest, _rng);
+    }
+
+    /**
+     * As the previous one, drawing random numbers from rng
+     *
+     * The functor state is not modified, so this overload can be
+     * called concurrently with different generators.
+     */
+    template<typename Genome, typename URNG>
+    void operator()(const Genome &a, const Genome &b, Genome &dest,
+                    URNG &rng) const {
+      dest.resize(a.size());
+      std::uniform_int_distribution<size_t> int_dist(0uL, _N-1);
+      std::uniform_int_distribution<size_t> binary_dist(0uL, 1uL);
       // sample a random integer
-      size_t pos = static_cast<size_t>(_int_dist(_rng));
-      if (_binary_dist(_rng) == 0uL) {
-        for (size_t i=0; i<pos; ++i) {
-          dest[i] = a[i];
-        }
-        for (size_t i=pos; i<b.size(); ++i) {
-          dest[i] = b[i];
-        }
+      size_t pos = static_cast<size_t>(int_dist(rng));
+      // whole words are copied, only the word at pos is masked
+      if (binary_dist(rng) == 0uL) {
+        kernels::split_words(dest.words(), a.words(), b.words(),
+                             pos, dest.numWords());
       }
       else {
-        for (size_t i=0; i<pos; ++i) {
-          dest[i] = b[i];
-        }
-        for (size_t i=pos; i<a.size(); ++i) {
-          dest[i] = a[i];
-        }
+        kernels::split_words(dest.words(), b.words(), a.words(),
+                             pos, dest.numWords());
       }
-      return Chromosome(std::move(dest));
     }
   private:
-    mutable std::mt19937_64 _rng;
-    mutable std::uniform_int_distribution<size_t> _int_dist;
-    mutable std::uniform_int_distribution<size_t> _binary_dist;
-  }; // class RandomSplitCrossOver
+    mutable RNG _rng;
+    size_t _N;
+  }; // class BasicRandomSplitCrossOver
+
+  typedef BasicRandomSplitCrossOver<> RandomSplitCrossOver;
 
 
   /**
@@ -91,32 +149,404 @@ namespace GeneticAlgorithms {
    * from any of both parents.
    *
    * ATTENTION: no thread safe object, it should be created for each
-   * thread in your program.
+   * thread in your program, or used through the overload which
+   * receives a random generator.
    */
-  class RandomMixCrossOver {
+  template<typename RNG = std::mt19937_64>
+  class BasicRandomMixCrossOver {
   public:
-    RandomMixCrossOver(unsigned seed) :
-      _rng(seed),
-      _int_dist(0u, 1u) {
+    BasicRandomMixCrossOver(unsigned seed) :
+      _rng(seed) {
     }
 
-    Chromosome operator()(const Chromosome &a, const Chromosome &b) const {
-      bitset dest(a.size());
-      for (size_t i=0; i<a.size(); ++i) {
-        // flip a coin to decide which parent gene copy is at i position
-        if (_int_dist(_rng) == 0u) {
-          dest[i] = a[i];
-        }
-        else {
-          dest[i] = b[i];
+    /// Restarts the random generator with the given seed
+    void seed(unsigned seed) {
+      _rng.seed(seed);
+    }
+
+    /// Writes the state of the random generator, see save_state()
+    void saveState(std::ostream &os) const {
+      os << _rng << ' ';
+    }
+
+    /// Restores a state written by saveState()
+    void loadState(std::istream &is) const {
+      is >> _rng;
+    }
+
+    template<typename Genome>
+    Genome operator()(const Genome &a, const Genome &b) const {
+      Genome dest(a.size());
+      (*this)(a, b, dest);
+      return dest;
+    }
+
+    /**
+     * As operator()(a, b) for temporary parents, the child is written
+     * into the memory of a and returned without allocating
+     */
+    template<typename Genome,
+             typename = typename std::enable_if<!std::is_lvalue_reference<Genome>::value>::type>
+    Genome operator()(Genome &&a, Genome &&b) const {
+      (*this)(a, b, a, _rng);
+      return std::move(a);
+    }
+
+    /// Writes the child into dest, reusing its memory
+    template<typename Genome>
+    void operator()(const Genome &a, const Genome &b, Genome &dest) const {
+      (*this)(a, b, dest, _rng);
+    }
+
+    /// As the previous one, drawing random numbers from rng
+    template<typename Genome, typename URNG>
+    void operator()(const Genome &a, const Genome &b, Genome &dest,
+                    URNG &rng) const {
+      dest.resize(a.size());
+      // every bit of a random word decides which parent gives the
+      // gene, so 64 coins are flipped at once
+      kernels::uniform_blend_words(dest.words(), a.words(), b.words(),
+                                   dest.numWords(), rng);
+    }
+  private:
+    mutable RNG _rng;
+  }; // class BasicRandomMixCrossOver
+
+  typedef BasicRandomMixCrossOver<> RandomMixCrossOver;
+
+
+  /**
+   * The order cross over (OX) of Permutations
+   *
+   * The child takes a random segment of the first parent at the same
+   * positions, and the rest of positions, starting after the segment
+   * and wrapping around, are filled with the missing values in the
+   * order they appear at the second parent, starting after the
+   * segment too. It costs O(N) and allocates nothing once the
+   * per-thread scratch memory reaches N values.
+   *
+   * ATTENTION: no thread safe object, it should be created for each
+   * thread in your program, or used through the overload which
+   * receives a random generator.
+   */
+  template<typename RNG = std::mt19937_64>
+  class BasicOrderCrossOver {
+  public:
+    BasicOrderCrossOver(unsigned seed) :
+      _rng(seed) {
+    }
+
+    /// Restarts the random generator with the given seed
+    void seed(unsigned seed) {
+      _rng.seed(seed);
+    }
+
+    /// Writes the state of the random generator, see save_state()
+    void saveState(std::ostream &os) const {
+      os << _rng << ' ';
+    }
+
+    /// Restores a state written by saveState()
+    void loadState(std::istream &is) const {
+      is >> _rng;
+    }
+
+    Permutation operator()(const Permutation &a, const Permutation &b) const {
+      Permutation dest(a.size());
+      (*this)(a, b, dest);
+      return dest;
+    }
+
+    /// Writes the child into dest, reusing its memory
+    void operator()(const Permutation &a, const Permutation &b,
+                    Permutation &dest) const {
+      (*this)(a, b, dest, _rng);
+    }
+
+    /**
+     * As the previous one, drawing random numbers from rng
+     *
+     * The functor state is not modified, so this overload can be
+     * called concurrently with different generators. dest can't be
+     * a nor b.
+     */
+    template<typename URNG>
+    void operator()(const Permutation &a, const Permutation &b,
+                    Permutation &dest, URNG &rng) const {
+      const size_t n = a.size();
+      dest.resize(n);
+      if (n == 0u) return;
+      size_t first, last;
+      detail::draw_segment(n, rng, first, last);
+      std::vector<uint32_t> &taken = detail::permutation_scratch(n);
+      std::fill(taken.begin(), taken.begin() + n, 0u);
+      const uint32_t *x = a.data(), *y = b.data();
+      uint32_t *z = dest.data();
+      for (size_t i=first; i<=last; ++i) {
+        z[i] = x[i];
+        taken[x[i]] = 1u;
+      }
+      size_t j = (last + 1u == n) ? 0u : last + 1u;
+      size_t k = j;
+      for (size_t count=0; count<n; ++count) {
+        const uint32_t v = y[k];
+        if (!taken[v]) {
+          z[j] = v;
+          if (++j == n) j = 0u;
         }
+        if (++k == n) k = 0u;
       }
-      return Chromosome(std::move(dest));
     }
+
   private:
-    mutable std::mt19937_64 _rng;
-    mutable std::uniform_int_distribution<size_t> _int_dist;
-  }; // class RandomMixCrossOver
+    mutable RNG _rng;
+  }; // class BasicOrderCrossOver
+
+  typedef BasicOrderCrossOver<> OrderCrossOver;
+
+
+  /**
+   * The partially mapped cross over (PMX) of Permutations
+   *
+   * The child starts as a copy of the second parent, and for every
+   * position of a random segment the value of the first parent is
+   * swapped into it, so the segment comes from the first parent and
+   * the rest of values keep the positions of the second one as far
+   * as possible. It costs O(N) and allocates nothing once the
+   * per-thread scratch memory reaches N values.
+   *
+   * ATTENTION: no thread safe object, it should be created for each
+   * thread in your program, or used through the overload which
+   * receives a random generator.
+   */
+  template<typename RNG = std::mt19937_64>
+  class BasicPartiallyMappedCrossOver {
+  public:
+    BasicPartiallyMappedCrossOver(unsigned seed) :
+      _rng(seed) {
+    }
+
+    /// Restarts the random generator with the given seed
+    void seed(unsigned seed) {
+      _rng.seed(seed);
+    }
+
+    /// Writes the state of the random generator, see save_state()
+    void saveState(std::ostream &os) const {
+      os << _rng << ' ';
+    }
+
+    /// Restores a state written by saveState()
+    void loadState(std::istream &is) const {
+      is >> _rng;
+    }
+
+    Permutation operator()(const Permutation &a, const Permutation &b) const {
+      Permutation dest(a.size());
+      (*this)(a, b, dest);
+      return dest;
+    }
+
+    /// Writes the child into dest, reusing its memory
+    void operator()(const Permutation &a, const Permutation &b,
+                    Permutation &dest) const {
+      (*this)(a, b, dest, _rng);
+    }
+
+    /**
+     * As the previous one, drawing random numbers from rng
+     *
+     * The functor state is not modified, so this overload can be
+     * called concurrently with different generators. dest can't be
+     * a nor b.
+     */
+    template<typename URNG>
+    void operator()(const Permutation &a, const Permutation &b,
+                    Permutation &dest, URNG &rng) const {
+      const size_t n = a.size();
+      dest = b;
+      if (n == 0u) return;
+      size_t first, last;
+      detail::draw_segment(n, rng, first, last);
+      // position of every value at dest
+      std::vector<uint32_t> &position = detail::permutation_scratch(n);
+      const uint32_t *x = a.data();
+      uint32_t *z = dest.data();
+      for (size_t i=0; i<n; ++i) position[z[i]] = static_cast<uint32_t>(i);
+      for (size_t i=first; i<=last; ++i) {
+        const uint32_t v = x[i], u = z[i];
+        const uint32_t j = position[v];
+        z[j] = u;
+        z[i] = v;
+        position[u] = j;
+        position[v] = static_cast<uint32_t>(i);
+      }
+    }
+
+  private:
+    mutable RNG _rng;
+  }; // class BasicPartiallyMappedCrossOver
+
+  typedef BasicPartiallyMappedCrossOver<> PartiallyMappedCrossOver;
+
+
+  /**
+   * The simulated binary cross over (SBX) of real vectors
+   *
+   * Children spread around their parents as the children of a one
+   * point cross over of binary encodings do, the larger the
+   * distribution index eta the closer (see kernels::sbx()). Values
+   * are clamped to [lower,upper]. Works with FloatVector and
+   * DoubleVector.
+   *
+   * ATTENTION: no thread safe object, it should be created for each
+   * thread in your program, or used through the overload which
+   * receives a random generator.
+   */
+  template<typename RNG = std::mt19937_64>
+  class BasicSimulatedBinaryCrossOver {
+  public:
+    BasicSimulatedBinaryCrossOver(unsigned seed, double eta,
+                                  double lower, double upper) :
+      _rng(seed),
+      _eta(eta),
+      _lower(lower),
+      _upper(upper) {
+    }
+
+    /// Restarts the random generator with the given seed
+    void seed(unsigned seed) {
+      _rng.seed(seed);
+    }
+
+    /// Writes the state of the random generator, see save_state()
+    void saveState(std::ostream &os) const {
+      os << _rng << ' ';
+    }
+
+    /// Restores a state written by saveState()
+    void loadState(std::istream &is) const {
+      is >> _rng;
+    }
+
+    template<typename Genome>
+    Genome operator()(const Genome &a, const Genome &b) const {
+      Genome dest(a.size());
+      (*this)(a, b, dest);
+      return dest;
+    }
+
+    /// Writes the child into dest, reusing its memory
+    template<typename Genome>
+    void operator()(const Genome &a, const Genome &b, Genome &dest) const {
+      (*this)(a, b, dest, _rng);
+    }
+
+    /**
+     * As the previous one, drawing random numbers from rng
+     *
+     * The functor state is not modified, so this overload can be
+     * called concurrently with different generators. dest may be a or
+     * b.
+     */
+    template<typename Genome, typename URNG>
+    void operator()(const Genome &a, const Genome &b, Genome &dest,
+                    URNG &rng) const {
+      typedef typename Genome::value_type value_type;
+      dest.resize(a.size());
+      kernels::sbx(dest.data(), a.data(), b.data(), a.size(),
+                   static_cast<value_type>(_eta),
+                   static_cast<value_type>(_lower),
+                   static_cast<value_type>(_upper), rng);
+    }
+
+  private:
+    mutable RNG _rng;
+    double _eta;
+    double _lower;
+    double _upper;
+  }; // class BasicSimulatedBinaryCrossOver
+
+  typedef BasicSimulatedBinaryCrossOver<> SimulatedBinaryCrossOver;
+
+
+  /**
+   * The blend cross over (BLX-alpha) of real vectors
+   *
+   * Every value is drawn uniformly from the interval of both parents
+   * widened by alpha times its length (see kernels::blend()), 0.5 is
+   * the usual alpha. Values are clamped to [lower,upper]. Works with
+   * FloatVector and DoubleVector.
+   *
+   * ATTENTION: no thread safe object, it should be created for each
+   * thread in your program, or used through the overload which
+   * receives a random generator.
+   */
+  template<typename RNG = std::mt19937_64>
+  class BasicBlendCrossOver {
+  public:
+    BasicBlendCrossOver(unsigned seed, double alpha,
+                        double lower, double upper) :
+      _rng(seed),
+      _alpha(alpha),
+      _lower(lower),
+      _upper(upper) {
+    }
+
+    /// Restarts the random generator with the given seed
+    void seed(unsigned seed) {
+      _rng.seed(seed);
+    }
+
+    /// Writes the state of the random generator, see save_state()
+    void saveState(std::ostream &os) const {
+      os << _rng << ' ';
+    }
+
+    /// Restores a state written by saveState()
+    void loadState(std::istream &is) const {
+      is >> _rng;
+    }
+
+    template<typename Genome>
+    Genome operator()(const Genome &a, const Genome &b) const {
+      Genome dest(a.size());
+      (*this)(a, b, dest);
+      return dest;
+    }
+
+    /// Writes the child into dest, reusing its memory
+    template<typename Genome>
+    void operator()(const Genome &a, const Genome &b, Genome &dest) const {
+      (*this)(a, b, dest, _rng);
+    }
+
+    /**
+     * As the previous one, drawing random numbers from rng
+     *
+     * The functor state is not modified, so this overload can be
+     * called concurrently with different generators. dest may be a or
+     * b.
+     */
+    template<typename Genome, typename URNG>
+    void operator()(const Genome &a, const Genome &b, Genome &dest,
+                    URNG &rng) const {
+      typedef typename Genome::value_type value_type;
+      dest.resize(a.size());
+      kernels::blend(dest.data(), a.data(), b.data(), a.size(),
+                     static_cast<value_type>(_alpha),
+                     static_cast<value_type>(_lower),
+                     static_cast<value_type>(_upper), rng);
+    }
+
+  private:
+    mutable RNG _rng;
+    double _alpha;
+    double _lower;
+    double _upper;
+  }; // class BasicBlendCrossOver
+
+  typedef BasicBlendCrossOver<> BlendCrossOver;
 
 
   /**
@@ -125,35 +555,93 @@ namespace GeneticAlgorithms {
    * Instead of instantiated directly this class, use the helper function
    * make_cross_over_on_prob
    */
-  template <typename CrossOverFunctor>
+  template <typename CrossOverFunctor, typename RNG = std::mt19937_64>
   class CrossOverOnProbWrapper {
   public:
     CrossOverOnProbWrapper(unsigned seed, float prob,
                            const CrossOverFunctor &crossover) :
       _rng(seed),
-      _real_dist(0.0f, 1.0f),
-      _binary_dist(0uL, 1uL),
       _prob(prob),
       _crossover(crossover) {
     }
 
+    /**
+     * Restarts the random generator with the given seed
+     *
+     * The wrapped functor is seeded with a seed derived from the
+     * given one.
+     */
+    void seed(unsigned seed) {
+      _rng.seed(seed);
+      reseed(_crossover, derive_seed(seed, 1u));
+    }
+
+    /// Writes the state of the random generator, and the one of
+    /// the wrapped functor
+    void saveState(std::ostream &os) const {
+      os << _rng << ' ';
+      save_state(_crossover, os);
+    }
+
+    /// Restores a state written by saveState()
+    void loadState(std::istream &is) const {
+      is >> _rng;
+      load_state(_crossover, is);
+    }
+
     /// Cross-overs with _prob probability, else returns one random parent
-    Chromosome operator()(const Chromosome &a, const Chromosome &b) const {
-      if (_real_dist(_rng) < _prob) {
-        return _crossover(a, b);
-      }
-      else {
-        if (_binary_dist(_rng) == 0uL) return a;
-        else return b;
-      }
+    template<typename Genome>
+    Genome operator()(const Genome &a, const Genome &b) const {
+      const Genome *parent = choose(a, b, _rng);
+      if (!parent) return _crossover(a, b);
+      return *parent;
+    }
+
+    /**
+     * As the previous one for temporary parents, the chosen parent is
+     * moved instead of copied
+     */
+    template<typename Genome,
+             typename = typename std::enable_if<!std::is_lvalue_reference<Genome>::value>::type>
+    Genome operator()(Genome &&a, Genome &&b) const {
+      const Genome *parent = choose(a, b, _rng);
+      if (!parent) return _crossover(std::move(a), std::move(b));
+      return std::move(parent == &a ? a : b);
+    }
+
+    /// Writes the child into dest, reusing its memory
+    template<typename Genome>
+    void operator()(const Genome &a, const Genome &b, Genome &dest) const {
+      const Genome *parent = choose(a, b, _rng);
+      if (!parent) cross_over_into(_crossover, a, b, dest);
+      else dest = *parent;
+    }
+
+    /**
+     * As the previous one, drawing random numbers from rng, which is
+     * also given to the wrapped functor when it accepts it
+     */
+    template<typename Genome, typename URNG>
+    void operator()(const Genome &a, const Genome &b, Genome &dest,
+                    URNG &rng) const {
+      const Genome *parent = choose(a, b, rng);
+      if (!parent) cross_over_into(_crossover, a, b, dest, rng);
+      else dest = *parent;
     }
 
   private:
-    mutable std::mt19937_64 _rng;
-    mutable std::uniform_real_distribution<float> _real_dist;
-    mutable std::uniform_int_distribution<size_t> _binary_dist;
+    mutable RNG _rng;
     float _prob;
     CrossOverFunctor _crossover;
+
+    /// returns null with _prob probability, else one random parent
+    template<typename Genome, typename URNG>
+    const Genome *choose(const Genome &a, const Genome &b, URNG &rng) const {
+      std::uniform_real_distribution<float> real_dist(0.0f, 1.0f);
+      if (real_dist(rng) < _prob) return 0;
+      std::uniform_int_distribution<size_t> binary_dist(0uL, 1uL);
+      return (binary_dist(rng) == 0uL) ? &a : &b;
+    }
   };
 
   /// Helper for construction of CrossOverOnProbWrapper instances
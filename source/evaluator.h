@@ -0,0 +1,308 @@
+/*
+ * This file is part of GeneticAlgorithms toolkit
+ *
+ * Copyright 2017, Francisco Zamora-Martinez
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef EVALUATOR_H
+#define EVALUATOR_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <future>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "bit_kernels.h"
+#include "chromosome.h"
+#include "genetic_solver.h"
+#include "indexed_heap.h"
+#include "operator_traits.h"
+#include "population.h"
+#include "steady_state_solver.h"
+#include "thread_pool.h"
+
+namespace GeneticAlgorithms {
+
+  /**
+   * An asynchronous evaluator which ranks Chromosomes on its own
+   * threads
+   *
+   * Evaluators rank Chromosomes out of the genetic algorithm: submit()
+   * copies the Chromosome and returns a std::future of its rank
+   * immediately. Any class with this method can be used as evaluator
+   * (see RemoteEvaluator for a cluster of workers):
+   *
+   * - `std::future<T> submit(const Genome &x)`
+   *
+   * Exceptions thrown by RankFunctor are stored in the future.
+   * Pending work is finished by the destructor.
+   *
+   * @code
+   * ThreadedEvaluator<MyRank> evaluator(MyRank(), 8u);
+   * std::future<float> rank = evaluator.submit(x);
+   * ... // do something else
+   * float r = rank.get();
+   * @endcode
+   */
+  template<typename RankFunctor, typename Genome = Chromosome,
+           typename T = float>
+  class ThreadedEvaluator {
+  public:
+    ThreadedEvaluator(const RankFunctor &rank_func, size_t num_threads=1u) :
+      _rank_func(rank_func), _stop(false) {
+      if (num_threads == 0u) num_threads = ThreadPool::defaultSize();
+      for (size_t i=0; i<num_threads; ++i) {
+        _workers.push_back(std::thread(&ThreadedEvaluator::workerLoop, this));
+      }
+    }
+
+    ~ThreadedEvaluator() {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+      }
+      _cv.notify_all();
+      for (auto &worker : _workers) worker.join();
+    }
+
+    ThreadedEvaluator(const ThreadedEvaluator &) = delete;
+    ThreadedEvaluator &operator=(const ThreadedEvaluator &) = delete;
+
+    /// Queues a copy of x and returns the future of its rank
+    std::future<T> submit(const Genome &x) {
+      std::promise<T> promise;
+      std::future<T> future = promise.get_future();
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _jobs.push_back(Job(x, std::move(promise)));
+      }
+      _cv.notify_one();
+      return future;
+    }
+
+  private:
+    typedef std::pair<Genome, std::promise<T> > Job;
+
+    RankFunctor _rank_func;
+    std::vector<std::thread> _workers;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<Job> _jobs;
+    bool _stop;
+
+    void workerLoop() {
+      for (;;) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [this]{ return _stop || !_jobs.empty(); });
+        if (_jobs.empty()) return; // _stop, and nothing left
+        Job job(std::move(_jobs.front()));
+        _jobs.pop_front();
+        lock.unlock();
+        try {
+          job.second.set_value(rank_genome<T>(_rank_func, job.first));
+        }
+        catch (...) {
+          job.second.set_exception(std::current_exception());
+        }
+      }
+    }
+  }; // class ThreadedEvaluator
+
+  /**
+   * A RankFunctor which ranks through an evaluator, so generational
+   * solvers (solve(), evolve()) can rank on remote workers
+   *
+   * It implements rank_batch (see has_batch_rank), so Population
+   * submits every Chromosome of a generation before waiting for the
+   * first rank, and the evaluator gets the whole generation at once.
+   * With SolverOptions::num_threads = 1 a single batch is submitted.
+   * The evaluator should outlive this functor.
+   *
+   * @code
+   * RemoteEvaluator<> evaluator(workers);
+   * Chromosome best = solve(options, init, select, cross, mutate,
+   *                         EvaluatorRank<RemoteEvaluator<> >(evaluator, N));
+   * @endcode
+   */
+  template<typename Evaluator, typename Genome = Chromosome,
+           typename T = float>
+  class EvaluatorRank {
+  public:
+    /// num_gens is the size of the ranked Chromosomes
+    EvaluatorRank(Evaluator &evaluator, const size_t num_gens) :
+      _evaluator(&evaluator), _num_gens(num_gens) {
+    }
+
+    T operator()(const Genome &x) const {
+      return _evaluator->submit(x).get();
+    }
+
+    void rank_batch(const word_type *words, const size_t num_words,
+                    const size_t count, T *ranks) const {
+      std::vector<std::future<T> > futures;
+      futures.reserve(count);
+      Genome x(_num_gens);
+      for (size_t r=0; r<count; ++r) {
+        kernels::copy_words(x.words(), words + r * num_words,
+                            std::min(num_words, x.numWords()));
+        futures.push_back(_evaluator->submit(x));
+      }
+      for (size_t r=0; r<count; ++r) ranks[r] = futures[r].get();
+    }
+
+  private:
+    Evaluator *_evaluator;
+    size_t _num_gens;
+  }; // class EvaluatorRank
+
+  namespace detail {
+    /// RankFunctor of populations ranked by evaluators, never called
+    template<typename T>
+    struct RankedElsewhere {
+      template<typename Genome>
+      T operator()(const Genome &) const {
+        return T();
+      }
+    };
+  } // namespace detail
+
+  /**
+   * A steady state genetic algorithm ranking through an evaluator,
+   * with up to in_flight children being ranked at any time
+   *
+   * Children are produced one by one (selection, cross over and
+   * mutation, as SteadyStateSolver does) and submitted until
+   * in_flight of them are pending. Then the solver waits for the
+   * oldest one, inserts it replacing the victim given by
+   * steady_options (SteadyStateOptions::children_per_step is not
+   * used), and produces the next child, so workers never wait at a
+   * generation barrier. Children are inserted in submission order,
+   * so the result doesn't depend on the timing of workers.
+   *
+   * in_flight should be at least the number of remote threads, a few
+   * times more when rank costs vary a lot. The criteria of
+   * SolverOptions apply to inserted children, num_iterations being
+   * their maximum number.
+   *
+   * @code
+   * RemoteEvaluator<> evaluator(workers, 32u);
+   * SolverResult<Chromosome, float> result =
+   *   evolve_async(options, steady, evaluator, 64u, init,
+   *                FloatTournamentSelection(2u, rng()), cross, mutate);
+   * @endcode
+   */
+  template<typename T=float,
+           typename Evaluator,
+           typename InitializerFunctor,
+           typename SelectionFunctor,
+           typename CrossOverFunctor,
+           typename MutationFunctor>
+  SolverResult<typename genome_of<InitializerFunctor>::type, T>
+  evolve_async(const SolverOptions &options,
+               const SteadyStateOptions &steady_options,
+               Evaluator &evaluator,
+               size_t in_flight,
+               const InitializerFunctor &init_func,
+               const SelectionFunctor &select_func,
+               const CrossOverFunctor &cross_over_func,
+               const MutationFunctor &mutate_func) {
+    typedef typename genome_of<InitializerFunctor>::type Genome;
+    const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+    if (in_flight == 0u) in_flight = 1u;
+    typedef Population<detail::RankedElsewhere<T>, T, Genome> population_t;
+    population_t population((detail::RankedElsewhere<T>()));
+    // the initial population is ranked as a whole
+    {
+      std::vector<Genome> initial;
+      std::vector<std::future<T> > futures;
+      for (size_t i=0; i<options.population_size; ++i) {
+        initial.push_back(init_func());
+        futures.push_back(evaluator.submit(initial.back()));
+      }
+      for (size_t i=0; i<initial.size(); ++i) {
+        population.push(std::move(initial[i]), futures[i].get());
+      }
+    }
+    IndexedHeap<T> worst;
+    worst.build(population.ranks().data(), population.size());
+    SolverResult<Genome, T> result;
+    typename population_t::Hypothesis best = population.top();
+    size_t generation = 0u, last_improvement = 0u;
+    size_t evaluations = population.size();
+    std::mt19937_64 rng(options.seed);
+    // ring of children being ranked, oldest at head
+    std::vector<Genome> children(in_flight);
+    std::vector<std::future<T> > futures(in_flight);
+    std::vector<IndexCouple> couple(1u);
+    size_t head = 0u, pending = 0u;
+    while (!detail::check_stop(options, generation, last_improvement,
+                               static_cast<double>(best.second),
+                               evaluations, start, result.reason)) {
+      while (pending < in_flight) {
+        const size_t slot = (head + pending) % in_flight;
+        population.select(select_func, couple);
+        cross_over_into(cross_over_func, population.genome(couple[0].first),
+                        population.genome(couple[0].second), children[slot]);
+        mutate_in_place(mutate_func, children[slot]);
+        futures[slot] = evaluator.submit(children[slot]);
+        ++pending;
+      }
+      const T rank = futures[head].get();
+      const Genome &child = children[head];
+      ++evaluations;
+      const size_t victim = detail::choose_victim(steady_options, population,
+                                                  worst, rng);
+      if (!(rank < population.rank(victim))) {
+        population.replace(victim, child, rank);
+        worst.update(victim, rank);
+      }
+      head = (head + 1u) % in_flight;
+      --pending;
+      ++generation;
+      if (best.second < rank) {
+        best.first = child;
+        best.second = rank;
+        last_improvement = generation;
+      }
+    }
+    result.best = best.first;
+    result.rank = best.second;
+    result.generations = generation;
+    result.evaluations = evaluations;
+    result.seconds = detail::seconds_since(start);
+    return result;
+  }
+
+} // namespace GeneticAlgorithms
+
+#endif // EVALUATOR_H
@@ -0,0 +1,525 @@
+/*
+ * This file is part of GeneticAlgorithms toolkit
+ *
+ * Copyright 2017, Francisco Zamora-Martinez
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "checkpoint.h"
+#include "chromosome.h"
+
+namespace GeneticAlgorithms {
+
+  /**
+   * Header of an event log, the first bytes of the file
+   *
+   * The header is followed, from records_offset, by fixed size
+   * records of record_size bytes, one per generation:
+   *
+   * - an EventLogRecord with the statistics and timers of the
+   *   generation.
+   * - population_size ranks of rank_size bytes, padded to 8 bytes.
+   * - num_words word_type of the best Chromosome of the generation.
+   *
+   * num_records and dropped are written when the log is closed, a
+   * killed run leaves them behind, so readers count the whole records
+   * in the file instead (see EventLog). Numbers are stored with the
+   * byte order of the host.
+   */
+  struct EventLogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t rank_size;
+    uint64_t population_size;
+    uint64_t num_gens;
+    uint64_t num_words;
+    uint64_t record_size;
+    uint64_t records_offset;
+    uint64_t num_records;
+    /// records lost because the disk was slower than the solver
+    uint64_t dropped;
+  };
+
+  /// First bytes of every record of an event log
+  struct EventLogRecord {
+    uint64_t generation;
+    uint64_t evaluations;
+    /// best rank of the generation
+    double best;
+    double mean;
+    double stddev;
+    /// zero unless it was computed by the solver, see GeneticSolver::step()
+    double diversity;
+    uint64_t restarts;
+    uint64_t select_ns;
+    uint64_t crossover_ns;
+    uint64_t mutate_ns;
+    uint64_t rank_ns;
+    uint64_t cache_hits;
+    uint64_t cache_misses;
+  };
+
+  static const char EVENT_LOG_MAGIC[8] = {'G','A','E','V','L','O','G','\0'};
+  static const uint32_t EVENT_LOG_VERSION = 1u;
+
+  /**
+   * Returns the header of an event log of populations of
+   * population_size genomes, which take num_words words each, the
+   * counters being zero
+   */
+  template<typename T>
+  EventLogHeader event_log_layout(const size_t population_size,
+                                  const size_t num_gens,
+                                  const size_t num_words) {
+    EventLogHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, EVENT_LOG_MAGIC, sizeof(h.magic));
+    h.version = EVENT_LOG_VERSION;
+    h.rank_size = sizeof(T);
+    h.population_size = population_size;
+    h.num_gens = num_gens;
+    h.num_words = num_words;
+    h.record_size = sizeof(EventLogRecord) +
+      (population_size * sizeof(T) + 7u) / 8u * 8u +
+      num_words * sizeof(word_type);
+    h.records_offset = detail::align_offset(sizeof(EventLogHeader));
+    return h;
+  }
+
+  namespace detail {
+
+    /// offset of the ranks in a record
+    inline uint64_t event_ranks_offset() {
+      return sizeof(EventLogRecord);
+    }
+
+    /// offset of the words of the best Chromosome in a record
+    inline uint64_t event_words_offset(const EventLogHeader &h) {
+      return h.record_size - h.num_words * sizeof(word_type);
+    }
+
+    inline bool same_event_layout(const EventLogHeader &a,
+                                  const EventLogHeader &b) {
+      return std::memcmp(a.magic, b.magic, sizeof(a.magic)) == 0 &&
+        a.version == b.version && a.rank_size == b.rank_size &&
+        a.population_size == b.population_size &&
+        a.num_gens == b.num_gens && a.num_words == b.num_words &&
+        a.record_size == b.record_size &&
+        a.records_offset == b.records_offset;
+    }
+
+  } // namespace detail
+
+  /**
+   * Appends the records of an event log from a background thread
+   *
+   * Records are written into chunks of chunk_size bytes (at least one
+   * record) taken from a pool of num_chunks, so the memory of the
+   * writer is bounded. A full chunk is handed to the thread, which
+   * writes it to the file and gives it back to the pool. append()
+   * never waits for the disk: when every chunk is full or being
+   * written, the record is dropped and counted in dropped().
+   *
+   * The file is replaced, unless append is true and it exists with
+   * the same layout: then records follow its last whole one, so a run
+   * resumed from a snapshot continues its log. truncate() removes the
+   * generations logged after the snapshot, which the resumed run
+   * produces again, so the log keeps a single history.
+   *
+   * I/O errors of the thread are thrown by the next append() which
+   * takes a chunk from the pool, or by close().
+   *
+   * ATTENTION: no thread safe object, append() and close() should be
+   * called from one thread.
+   *
+   * @code
+   * EventLogWriter log("run.log", event_log_layout<float>(n, N, words));
+   * char *record = log.append();
+   * if (record) fill(record); // before the next call to append()
+   * log.close();
+   * @endcode
+   */
+  class EventLogWriter {
+  public:
+    EventLogWriter(const std::string &path, const EventLogHeader &layout,
+                   const bool append = false,
+                   const size_t chunk_size = 1u << 20,
+                   const size_t num_chunks = 4u) :
+      _path(path),
+      _header(layout),
+      _records_per_chunk(chunk_size / layout.record_size > 0u ?
+                         chunk_size / layout.record_size : 1u),
+      _chunks(num_chunks > 0u ? num_chunks : 1u),
+      _fill(_chunks.size(), 0u),
+      _current(-1),
+      _dropped(0u),
+      _written(0u),
+      _stop(false),
+      _fd(-1) {
+      open(append);
+      for (size_t i=0; i<_chunks.size(); ++i) {
+        _free.push_back(static_cast<int>(i));
+      }
+      _thread = std::thread([this]{ writeLoop(); });
+    }
+
+    /// Closes the log, see close(), errors are lost
+    ~EventLogWriter() {
+      try {
+        close();
+      }
+      catch (...) {
+      }
+    }
+
+    EventLogWriter(const EventLogWriter &) = delete;
+    EventLogWriter &operator=(const EventLogWriter &) = delete;
+
+    /// The header given at construction, with the counters of the file
+    const EventLogHeader &header() const {
+      return _header;
+    }
+
+    /**
+     * Returns the memory of the next record, header().record_size
+     * bytes which should be filled before the next call, or a null
+     * pointer when the record is dropped
+     */
+    char *append() {
+      if (_current >= 0 && _fill[_current] == _records_per_chunk) queue();
+      if (_current < 0) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        rethrow();
+        if (_free.empty()) {
+          ++_dropped;
+          return 0;
+        }
+        _current = _free.front();
+        _free.pop_front();
+        // chunks are allocated when first used, short runs take one
+        if (!_chunks[_current]) {
+          _chunks[_current].reset(new char[_records_per_chunk *
+                                           _header.record_size]);
+        }
+      }
+      const size_t k = _fill[_current]++;
+      return _chunks[_current].get() + k * _header.record_size;
+    }
+
+    /**
+     * Writes the pending records, the final header with num_records
+     * and dropped, and closes the file, throwing the errors of the
+     * thread
+     *
+     * The file isn't synced, a log is not worth the wait for the
+     * disk and readers don't depend on the header counters.
+     */
+    void close() {
+      if (_fd < 0) return;
+      if (_current >= 0 && _fill[_current] > 0u) queue();
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+      }
+      _cv.notify_all();
+      _thread.join();
+      const int fd = _fd;
+      _fd = -1;
+      _header.num_records += _written;
+      _header.dropped += _dropped;
+      const bool ok = !_error &&
+        ::pwrite(fd, &_header, sizeof(_header), 0) ==
+        static_cast<ssize_t>(sizeof(_header));
+      ::close(fd);
+      rethrow();
+      if (!ok) throw detail::io_error("cannot write", _path);
+    }
+
+    /**
+     * Removes the records of the generations after the given one,
+     * before the first append()
+     *
+     * Records are in generation order, so they are removed from the
+     * end of the file.
+     */
+    void truncate(const uint64_t generation) {
+      uint64_t records = _header.num_records;
+      while (records > 0u) {
+        // the generation is the first field of every record
+        uint64_t g;
+        const off_t at = static_cast<off_t>(_header.records_offset +
+                                            (records - 1u) * _header.record_size);
+        if (::pread(_fd, &g, sizeof(g), at) != static_cast<ssize_t>(sizeof(g))) {
+          throw detail::io_error("cannot read", _path);
+        }
+        if (g <= generation) break;
+        --records;
+      }
+      if (records == _header.num_records) return;
+      _header.num_records = records;
+      const off_t end = static_cast<off_t>(_header.records_offset +
+                                           records * _header.record_size);
+      if (::ftruncate(_fd, end) != 0 ||
+          ::pwrite(_fd, &_header, sizeof(_header), 0) !=
+          static_cast<ssize_t>(sizeof(_header)) ||
+          ::lseek(_fd, end, SEEK_SET) < 0) {
+        throw detail::io_error("cannot write", _path);
+      }
+    }
+
+    /// Records dropped since construction
+    size_t dropped() const {
+      return _dropped;
+    }
+
+  private:
+    const std::string _path;
+    EventLogHeader _header;
+    const size_t _records_per_chunk;
+    std::vector<std::unique_ptr<char[]> > _chunks;
+    /// records of every chunk
+    std::vector<size_t> _fill;
+    /// chunk filled by append(), -1 if none
+    int _current;
+    size_t _dropped;
+    /// chunks which can be filled, and chunks waiting for the thread
+    std::deque<int> _free, _queued;
+    /// records written by the thread
+    size_t _written;
+    bool _stop;
+    int _fd;
+    std::exception_ptr _error;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::thread _thread;
+
+    /// throws the error of the thread, _mutex must be locked or joined
+    void rethrow() {
+      if (_error) {
+        std::exception_ptr error = _error;
+        _error = std::exception_ptr();
+        std::rethrow_exception(error);
+      }
+    }
+
+    /// hands _current to the thread
+    void queue() {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queued.push_back(_current);
+      }
+      _current = -1;
+      _cv.notify_all();
+    }
+
+    /// opens the file, appending to it when asked and its layout matches
+    void open(const bool append) {
+      _fd = ::open(_path.c_str(), O_RDWR | O_CREAT, 0644);
+      if (_fd < 0) throw detail::io_error("cannot create", _path);
+      EventLogHeader old;
+      uint64_t end = _header.records_offset;
+      struct stat st;
+      if (append && ::fstat(_fd, &st) == 0 &&
+          ::pread(_fd, &old, sizeof(old), 0) == static_cast<ssize_t>(sizeof(old)) &&
+          detail::same_event_layout(old, _header) &&
+          static_cast<uint64_t>(st.st_size) >= old.records_offset) {
+        const uint64_t records = (static_cast<uint64_t>(st.st_size) -
+                                  old.records_offset) / old.record_size;
+        _header.num_records = records;
+        _header.dropped = old.dropped;
+        end = old.records_offset + records * old.record_size;
+      }
+      std::vector<char> head(_header.records_offset, 0);
+      std::memcpy(head.data(), &_header, sizeof(_header));
+      if (::ftruncate(_fd, static_cast<off_t>(end)) != 0 ||
+          ::pwrite(_fd, head.data(), head.size(), 0) !=
+          static_cast<ssize_t>(head.size()) ||
+          ::lseek(_fd, static_cast<off_t>(end), SEEK_SET) < 0) {
+        ::close(_fd);
+        throw detail::io_error("cannot write", _path);
+      }
+    }
+
+    void writeLoop() {
+      std::unique_lock<std::mutex> lock(_mutex);
+      for (;;) {
+        _cv.wait(lock, [this]{ return _stop || !_queued.empty(); });
+        if (_queued.empty()) return; // stopped and nothing left
+        const int chunk = _queued.front();
+        _queued.pop_front();
+        const bool failed = static_cast<bool>(_error);
+        lock.unlock();
+        std::exception_ptr error;
+        // after an error the records are discarded
+        if (!failed) {
+          try {
+            writeChunk(chunk);
+          }
+          catch (...) {
+            error = std::current_exception();
+          }
+        }
+        lock.lock();
+        if (error) _error = error;
+        else if (!failed) _written += _fill[chunk];
+        _fill[chunk] = 0u;
+        _free.push_back(chunk);
+      }
+    }
+
+    void writeChunk(const int chunk) const {
+      const char *data = _chunks[chunk].get();
+      const size_t size = _fill[chunk] * _header.record_size;
+      size_t done = 0u;
+      while (done < size) {
+        const ssize_t k = ::write(_fd, data + done, size - done);
+        if (k < 0 && errno == EINTR) continue;
+        if (k <= 0) throw detail::io_error("cannot write", _path);
+        done += static_cast<size_t>(k);
+      }
+    }
+  }; // class EventLogWriter
+
+  /**
+   * An event log mapped in memory, read only
+   *
+   * The file is validated at construction, throwing
+   * std::runtime_error when it isn't an event log. The number of
+   * records is given by the size of the file, so the log of a killed
+   * run can be read up to its last whole record.
+   *
+   * @code
+   * EventLog log("run.log");
+   * for (size_t i=0; i<log.size(); ++i) {
+   *   std::cout << log.record(i).generation << " " << log.record(i).best
+   *             << " " << log.ranks<float>(i)[0] << "\n";
+   * }
+   * @endcode
+   */
+  class EventLog {
+  public:
+    explicit EventLog(const std::string &path) :
+      _data(0), _size(0u) {
+      const int fd = ::open(path.c_str(), O_RDONLY);
+      if (fd < 0) throw detail::io_error("cannot open", path);
+      struct stat st;
+      if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw detail::io_error("cannot stat", path);
+      }
+      _size = static_cast<size_t>(st.st_size);
+      if (_size < sizeof(EventLogHeader)) {
+        ::close(fd);
+        throw std::runtime_error("not an event log " + path);
+      }
+      void *data = ::mmap(0, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+      ::close(fd);
+      if (data == MAP_FAILED) throw detail::io_error("cannot map", path);
+      _data = static_cast<const char*>(data);
+      if (!valid()) {
+        ::munmap(const_cast<char*>(_data), _size);
+        throw std::runtime_error("not an event log " + path);
+      }
+    }
+
+    ~EventLog() {
+      ::munmap(const_cast<char*>(_data), _size);
+    }
+
+    EventLog(const EventLog &) = delete;
+    EventLog &operator=(const EventLog &) = delete;
+
+    const EventLogHeader &header() const {
+      return *reinterpret_cast<const EventLogHeader*>(_data);
+    }
+
+    /// Number of whole records in the file
+    size_t size() const {
+      const EventLogHeader &h = header();
+      return (_size - h.records_offset) / h.record_size;
+    }
+
+    const EventLogRecord &record(const size_t i) const {
+      return *reinterpret_cast<const EventLogRecord*>(at(i));
+    }
+
+    /// The ranks of the population of record i
+    template<typename T>
+    const T *ranks(const size_t i) const {
+      if (header().rank_size != sizeof(T)) {
+        throw std::runtime_error("event log rank type mismatch");
+      }
+      return reinterpret_cast<const T*>(at(i) + detail::event_ranks_offset());
+    }
+
+    /// The words of the best Chromosome of record i
+    const word_type *bestWords(const size_t i) const {
+      return reinterpret_cast<const word_type*>
+        (at(i) + detail::event_words_offset(header()));
+    }
+
+  private:
+    const char *_data;
+    size_t _size;
+
+    const char *at(const size_t i) const {
+      const EventLogHeader &h = header();
+      return _data + h.records_offset + i * h.record_size;
+    }
+
+    bool valid() const {
+      const EventLogHeader &h = header();
+      return std::memcmp(h.magic, EVENT_LOG_MAGIC, sizeof(h.magic)) == 0 &&
+        h.version == EVENT_LOG_VERSION &&
+        h.records_offset >= sizeof(EventLogHeader) &&
+        h.records_offset <= _size &&
+        h.record_size == sizeof(EventLogRecord) +
+        (h.population_size * h.rank_size + 7u) / 8u * 8u +
+        h.num_words * sizeof(word_type);
+    }
+  }; // class EventLog
+
+} // namespace GeneticAlgorithms
+
+#endif // EVENT_LOG_H
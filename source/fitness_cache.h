@@ -0,0 +1,225 @@
+/*
+ * This file is part of GeneticAlgorithms toolkit
+ *
+ * Copyright 2017, Francisco Zamora-Martinez
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef FITNESS_CACHE_H
+#define FITNESS_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "chromosome.h"
+
+namespace GeneticAlgorithms {
+
+  /// Finalizer of MurmurHash3, mixes all bits of x
+  inline uint64_t mix_hash(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+  }
+
+  /// A fast 64 bits hash of num_words words holding num_gens gens
+  inline uint64_t words_hash(const word_type *words, const size_t num_words,
+                             const size_t num_gens) {
+    uint64_t h = mix_hash(num_gens ^ 0x9e3779b97f4a7c15ULL);
+    for (size_t i=0; i<num_words; ++i) {
+      h = mix_hash(h ^ words[i]) + 0x9e3779b97f4a7c15ULL;
+    }
+    return h;
+  }
+
+  /// A fast 64 bits hash of the gens of a Chromosome or StaticChromosome
+  template<typename Genome>
+  uint64_t genome_hash(const Genome &x) {
+    return words_hash(x.words(), x.numWords(), x.size());
+  }
+
+  /// Compares the gens of two chromosomes
+  template<typename Genome>
+  bool genome_equal(const Genome &a, const Genome &b) {
+    return a.size() == b.size() &&
+      std::memcmp(a.words(), b.words(),
+                  a.numWords() * sizeof(word_type)) == 0;
+  }
+
+  /**
+   * A bounded cache of ranks indexed by Chromosome
+   *
+   * Entries are found by genome_hash() in an open addressing table
+   * and confirmed by comparing gens, so a hash collision never
+   * returns a wrong rank. When the cache is full, the entry to
+   * replace is chosen by the CLOCK algorithm, an approximation of LRU
+   * with one reference bit per entry. All memory is allocated at
+   * construction, entries are overwritten in place.
+   *
+   * ATTENTION: no thread safe object.
+   */
+  template<typename Genome, typename T>
+  class FitnessCache {
+  public:
+    explicit FitnessCache(const size_t capacity) :
+      _entries(capacity),
+      _size(0u),
+      _hand(0u),
+      _hits(0u),
+      _misses(0u) {
+      size_t table_size = 1u;
+      while (table_size < 2u*capacity) table_size <<= 1u;
+      _table.assign(table_size, EMPTY);
+    }
+
+    size_t capacity() const {
+      return _entries.size();
+    }
+
+    size_t size() const {
+      return _size;
+    }
+
+    /// number of successful find() calls
+    size_t hits() const {
+      return _hits;
+    }
+
+    /// number of failed find() calls
+    size_t misses() const {
+      return _misses;
+    }
+
+    /**
+     * Looks for x, whose hash is h, writing its rank if it is found
+     *
+     * @return true when x was found
+     */
+    bool find(const Genome &x, const uint64_t h, T &rank) {
+      const size_t pos = lookup(x, h);
+      if (pos == EMPTY) {
+        ++_misses;
+        return false;
+      }
+      Entry &e = _entries[_table[pos]];
+      e.referenced = true;
+      rank = e.rank;
+      ++_hits;
+      return true;
+    }
+
+    /// Inserts x, whose hash is h, replacing an old entry if needed
+    void insert(const Genome &x, const uint64_t h, const T rank) {
+      if (_entries.empty() || lookup(x, h) != EMPTY) return;
+      size_t slot;
+      if (_size < _entries.size()) {
+        slot = _size++;
+      }
+      else {
+        // CLOCK: give a second chance to recently used entries
+        while (_entries[_hand].referenced) {
+          _entries[_hand].referenced = false;
+          _hand = (_hand + 1u) % _entries.size();
+        }
+        slot = _hand;
+        _hand = (_hand + 1u) % _entries.size();
+        erase(slot);
+      }
+      Entry &e = _entries[slot];
+      e.genome = x;
+      e.hash = h;
+      e.rank = rank;
+      e.referenced = false;
+      size_t pos = h & (_table.size() - 1u);
+      while (_table[pos] != EMPTY) pos = (pos + 1u) & (_table.size() - 1u);
+      _table[pos] = slot;
+    }
+
+    /// Removes all entries, keeping the memory, and the counters
+    void clear() {
+      std::fill(_table.begin(), _table.end(), EMPTY);
+      _size = 0u;
+      _hand = 0u;
+      _hits = _misses = 0u;
+    }
+
+  private:
+    static const size_t EMPTY = ~size_t(0u);
+
+    struct Entry {
+      Genome genome;
+      uint64_t hash;
+      T rank;
+      bool referenced;
+      Entry() : hash(0u), rank(), referenced(false) { }
+    };
+
+    std::vector<Entry> _entries;
+    /// open addressing table with positions of _entries
+    std::vector<size_t> _table;
+    size_t _size;
+    size_t _hand;
+    size_t _hits;
+    size_t _misses;
+
+    /// returns the table position holding x, or EMPTY
+    size_t lookup(const Genome &x, const uint64_t h) const {
+      if (_table.empty()) return EMPTY;
+      const size_t mask = _table.size() - 1u;
+      for (size_t pos = h & mask; _table[pos] != EMPTY; pos = (pos + 1u) & mask) {
+        const Entry &e = _entries[_table[pos]];
+        if (e.hash == h && genome_equal(e.genome, x)) return pos;
+      }
+      return EMPTY;
+    }
+
+    /// removes the entry at the given slot from the table
+    void erase(const size_t slot) {
+      const size_t mask = _table.size() - 1u;
+      size_t pos = _entries[slot].hash & mask;
+      while (_table[pos] != slot) pos = (pos + 1u) & mask;
+      // backward shift deletion keeps probing sequences valid
+      size_t next = (pos + 1u) & mask;
+      while (_table[next] != EMPTY) {
+        const size_t ideal = _entries[_table[next]].hash & mask;
+        if ( ((next - ideal) & mask) >= ((next - pos) & mask) ) {
+          _table[pos] = _table[next];
+          pos = next;
+        }
+        next = (next + 1u) & mask;
+      }
+      _table[pos] = EMPTY;
+    }
+  }; // class FitnessCache
+
+  template<typename Genome, typename T>
+  const size_t FitnessCache<Genome, T>::EMPTY;
+
+} // namespace GeneticAlgorithms
+
+#endif // FITNESS_CACHE_H
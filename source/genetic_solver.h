@@ -28,24 +28,916 @@
 #ifndef GENETIC_SOLVER_H
 #define GENETIC_SOLVER_H
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
+#include "checkpoint.h"
 #include "chromosome.h"
+#include "event_log.h"
+#include "fitness_cache.h"
+#include "instrumentation.h"
+#include "operator_traits.h"
 #include "population.h"
+#include "random.h"
+#include "thread_pool.h"
 
 namespace GeneticAlgorithms {
 
+  namespace detail {
+    template<typename X>
+    struct voider {
+      typedef void type;
+    };
+  } // namespace detail
+
+  /**
+   * The genome type produced by an InitializerFunctor
+   *
+   * It has no type member when InitializerFunctor can't be called
+   * without arguments, so overloads of solve() are discarded instead
+   * of failing.
+   */
+  template<typename InitializerFunctor, typename Enable = void>
+  struct genome_of {
+  };
+
+  template<typename InitializerFunctor>
+  struct genome_of<InitializerFunctor,
+                   typename detail::voider<decltype(std::declval<const InitializerFunctor&>()())>::type> {
+    typedef typename std::decay<
+      decltype(std::declval<const InitializerFunctor&>()()) >::type type;
+  };
+
+  namespace detail {
+
+    /// writes into slot j of the next generation the child of couple c
+    template<typename PopulationType, typename CrossOverFunctor>
+    void cross_child(PopulationType &pop, const size_t j, const IndexCouple &c,
+                     const CrossOverFunctor &cross_over_func,
+                     std::false_type) {
+      cross_over_into(cross_over_func, pop.genome(c.first),
+                      pop.genome(c.second), pop.child(j));
+    }
+
+    /**
+     * As the previous one, but when the cross over returns a copy of
+     * a parent, the child is declared to the population as this
+     * parent, allowing incremental ranking after its mutation.
+     */
+    template<typename PopulationType, typename CrossOverFunctor>
+    void cross_child(PopulationType &pop, const size_t j, const IndexCouple &c,
+                     const CrossOverFunctor &cross_over_func,
+                     std::true_type) {
+      auto &child = pop.child(j);
+      cross_over_into(cross_over_func, pop.genome(c.first),
+                      pop.genome(c.second), child);
+      // comparing words is much cheaper than ranking
+      size_t parent = PopulationType::NO_PARENT;
+      if (genome_equal(child, pop.genome(c.first))) parent = c.first;
+      else if (genome_equal(child, pop.genome(c.second))) parent = c.second;
+      pop.setChildParent(j, parent);
+    }
+
+    /// mutates in place the slot j of the next generation
+    template<typename PopulationType, typename MutationFunctor>
+    void mutate_child(PopulationType &pop, const size_t j,
+                      const MutationFunctor &mutate_func,
+                      std::false_type) {
+      mutate_in_place(mutate_func, pop.child(j));
+    }
+
+    /// As the previous one, recording the mutated gens
+    template<typename PopulationType, typename MutationFunctor>
+    void mutate_child(PopulationType &pop, const size_t j,
+                      const MutationFunctor &mutate_func,
+                      std::true_type) {
+      auto &child = pop.child(j);
+      mutate_func(static_cast<const typename std::decay<decltype(child)>::type&>(child),
+                  child, pop.childFlips(j));
+    }
+
+    /// As cross_child(), drawing random numbers from rng
+    template<typename PopulationType, typename CrossOverFunctor,
+             typename URNG>
+    void cross_child(PopulationType &pop, const size_t j, const IndexCouple &c,
+                     const CrossOverFunctor &cross_over_func, URNG &rng,
+                     std::false_type) {
+      cross_over_into(cross_over_func, pop.genome(c.first),
+                      pop.genome(c.second), pop.child(j), rng);
+    }
+
+    template<typename PopulationType, typename CrossOverFunctor,
+             typename URNG>
+    void cross_child(PopulationType &pop, const size_t j, const IndexCouple &c,
+                     const CrossOverFunctor &cross_over_func, URNG &rng,
+                     std::true_type) {
+      auto &child = pop.child(j);
+      cross_over_into(cross_over_func, pop.genome(c.first),
+                      pop.genome(c.second), child, rng);
+      size_t parent = PopulationType::NO_PARENT;
+      if (genome_equal(child, pop.genome(c.first))) parent = c.first;
+      else if (genome_equal(child, pop.genome(c.second))) parent = c.second;
+      pop.setChildParent(j, parent);
+    }
+
+    /// As mutate_child(), drawing random numbers from rng
+    template<typename PopulationType, typename MutationFunctor,
+             typename URNG>
+    void mutate_child(PopulationType &pop, const size_t j,
+                      const MutationFunctor &mutate_func, URNG &rng,
+                      std::false_type) {
+      mutate_in_place(mutate_func, pop.child(j), rng);
+    }
+
+    template<typename PopulationType, typename MutationFunctor,
+             typename URNG>
+    void mutate_child(PopulationType &pop, const size_t j,
+                      const MutationFunctor &mutate_func, URNG &rng,
+                      std::true_type) {
+      auto &child = pop.child(j);
+      mutate_func(static_cast<const typename std::decay<decltype(child)>::type&>(child),
+                  child, pop.childFlips(j), rng);
+    }
+
+  } // namespace detail
+
+  /**
+   * Configuration of the genetic algorithm implemented by solve()
+   */
+  struct SolverOptions {
+    /// number of generations
+    size_t num_iterations;
+    /// number of Chromosomes at every generation
+    size_t population_size;
+    /**
+     * messages are written to std::cerr when greater than zero, and
+     * greater than one writes statistics of every generation
+     */
+    int verbosity;
+    /// threads used for ranking, zero means all hardware threads
+    size_t num_threads;
+    /// entries of the FitnessCache, zero disables it
+    size_t cache_capacity;
+    /**
+     * produces children in parallel, see GeneticSolver::step(); it
+     * needs operators which accept an external random generator,
+     * otherwise children are produced sequentially
+     */
+    bool parallel_offspring;
+    /// seed of the random streams used when parallel_offspring
+    uint64_t seed;
+
+    /**
+     * @name Stopping criteria
+     *
+     * The algorithm stops after num_iterations generations or when
+     * any of the following criteria is met, they are checked after
+     * every generation. Default values disable them.
+     * @{
+     */
+    /// generations without improvement of the best rank
+    size_t max_stall_generations;
+    /// stops when the best rank is greater or equal than it
+    double target_rank;
+    /// wall clock budget, in seconds
+    double max_seconds;
+    /// calls to RankFunctor, the last generation may exceed it
+    size_t max_evaluations;
+    /// @}
+
+    /**
+     * file of the snapshots of the population, empty disables them;
+     * GeneticSolver::run() resumes from it when it exists
+     */
+    std::string checkpoint_path;
+    /// generations between snapshots, zero writes only the last one
+    size_t checkpoint_interval;
+
+    /**
+     * file of the event log, empty disables it; GeneticSolver::run()
+     * appends a record per generation, see EventLogWriter
+     */
+    std::string log_path;
+    /// bytes of every buffer of the event log
+    size_t log_chunk_size;
+    /// buffers of the event log, records are dropped when all are busy
+    size_t log_chunks;
+
+    /**
+     * @name Partial restarts
+     *
+     * When the diversity of a generation of GeneticSolver (see
+     * population_diversity()) falls below restart_diversity, all but
+     * the restart_elite best Chromosomes are replaced by new ones from
+     * the initializer. Zero disables restarts. Only bitset genomes
+     * have a diversity (see is_bit_genome), so restart_diversity is
+     * ignored for Permutation and FloatVector.
+     * @{
+     */
+    double restart_diversity;
+    size_t restart_elite;
+    /// @}
+
+    SolverOptions() :
+      num_iterations(1000u),
+      population_size(100u),
+      verbosity(0),
+      num_threads(1u),
+      cache_capacity(0u),
+      parallel_offspring(false),
+      seed(0u),
+      max_stall_generations(0u),
+      target_rank(std::numeric_limits<double>::infinity()),
+      max_seconds(0.0),
+      max_evaluations(0u),
+      checkpoint_interval(100u),
+      log_chunk_size(1u << 20),
+      log_chunks(4u),
+      restart_diversity(0.0),
+      restart_elite(1u) {
+    }
+  };
+
+  /// The reason of solver termination
+  enum StopReason {
+    /// SolverOptions::num_iterations generations have been produced
+    MAX_GENERATIONS,
+    /// SolverOptions::max_stall_generations without improvement
+    STALLED,
+    /// SolverOptions::target_rank has been reached
+    TARGET_REACHED,
+    /// SolverOptions::max_seconds have been spent
+    TIME_BUDGET,
+    /// SolverOptions::max_evaluations have been done
+    EVALUATIONS_BUDGET
+  };
+
+  /// The outcome of a genetic algorithm, as returned by evolve()
+  template<typename Genome, typename T>
+  struct SolverResult {
+    /// the best Chromosome found
+    Genome best;
+    /// its rank
+    T rank;
+    /// number of generations produced, initial population excluded
+    size_t generations;
+    /// number of calls to RankFunctor
+    size_t evaluations;
+    /// wall clock time, in seconds
+    double seconds;
+    StopReason reason;
+
+    SolverResult() :
+      rank(), generations(0u), evaluations(0u), seconds(0.0),
+      reason(MAX_GENERATIONS) {
+    }
+  };
+
+  namespace detail {
+
+    inline double seconds_since(const std::chrono::steady_clock::time_point &start) {
+      return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                           start).count();
+    }
+
+    /// The stopping criteria of SolverOptions, shared by all solvers
+    inline bool check_stop(const SolverOptions &options,
+                           const size_t generation,
+                           const size_t last_improvement,
+                           const double best_rank,
+                           const size_t evaluations,
+                           const std::chrono::steady_clock::time_point &start,
+                           StopReason &reason) {
+      if (generation >= options.num_iterations) {
+        reason = MAX_GENERATIONS;
+        return true;
+      }
+      if (best_rank >= options.target_rank) {
+        reason = TARGET_REACHED;
+        return true;
+      }
+      if (options.max_stall_generations > 0u &&
+          generation - last_improvement >= options.max_stall_generations) {
+        reason = STALLED;
+        return true;
+      }
+      if (options.max_evaluations > 0u &&
+          evaluations >= options.max_evaluations) {
+        reason = EVALUATIONS_BUDGET;
+        return true;
+      }
+      if (options.max_seconds > 0.0 &&
+          seconds_since(start) >= options.max_seconds) {
+        reason = TIME_BUDGET;
+        return true;
+      }
+      return false;
+    }
+
+  } // namespace detail
+
+  /**
+   * The generational genetic algorithm behind solve(), one generation
+   * at a time
+   *
+   * The genetic operators are the ones described at solve(), and they
+   * are kept by reference, so they should outlive the solver. This
+   * class allows to extend the algorithm from outside, as done by
+   * solve_islands(), replacing Chromosomes between generations.
+   *
+   * @code
+   * GeneticSolver<float, I, S, C, M, R> solver(options, i, s, c, m, r);
+   * solver.init();
+   * while (solver.generation() < options.num_iterations) solver.step();
+   * @endcode
+   */
+  template<typename T,
+           typename InitializerFunctor,
+           typename SelectionFunctor,
+           typename CrossOverFunctor,
+           typename MutationFunctor,
+           typename RankFunctor>
+  class GeneticSolver {
+  public:
+    typedef typename genome_of<InitializerFunctor>::type Genome;
+    typedef Population<RankFunctor, T, Genome> population_t;
+    typedef typename population_t::Hypothesis Hypothesis;
+
+    GeneticSolver(const SolverOptions &options,
+                  const InitializerFunctor &init_func,
+                  const SelectionFunctor &select_func,
+                  const CrossOverFunctor &cross_over_func,
+                  const MutationFunctor &mutate_func,
+                  const RankFunctor &rank_func) :
+      _options(options),
+      _init_func(init_func),
+      _select_func(select_func),
+      _cross_over_func(cross_over_func),
+      _mutate_func(mutate_func),
+      _pool(options.num_threads),
+      _population(rank_func),
+      _generation(0u),
+      _last_improvement(0u),
+      _restarts(0u) {
+      _population.enableCache(options.cache_capacity);
+    }
+
+    /**
+     * Generates and ranks the initial population
+     *
+     * With SolverOptions::parallel_offspring and an initializer which
+     * accepts a random generator, Chromosomes are generated in
+     * parallel too, from the Philox4x32 streams of key mix64(seed),
+     * which don't overlap with the streams of the children.
+     */
+    void init() {
+      _population.reset();
+      initPopulation(_options.population_size, mix64(_options.seed),
+                     init_rng_t());
+      _best = _population.top();
+      _generation = 0u;
+      _last_improvement = 0u;
+      _restarts = 0u;
+      _stats = GenerationStats<T>();
+      _start = std::chrono::steady_clock::now();
+    }
+
+    /**
+     * Runs init() and step() until a stopping criterion of
+     * SolverOptions is met
+     *
+     * With SolverOptions::checkpoint_path, a snapshot is written every
+     * checkpoint_interval generations and at the end (see
+     * checkpoint()), and the run starts by resume() instead of init()
+     * when the file exists, so a killed process continues where its
+     * last snapshot was taken.
+     *
+     * With SolverOptions::log_path, the initial population and every
+     * generation are recorded into an event log (see record()), which
+     * is continued when the run is resumed, dropping the records of
+     * the generations after the snapshot.
+     */
+    template<typename Observer>
+    SolverResult<Genome, T> run(Observer &observer) {
+      SolverResult<Genome, T> result;
+      std::unique_ptr<CheckpointWriter> writer;
+      std::unique_ptr<EventLogWriter> log;
+      const std::string &path = _options.checkpoint_path;
+      const bool resumed = !path.empty() && Snapshot::exists(path);
+      if (resumed) resume(Snapshot(path));
+      else init();
+      if (!path.empty()) writer.reset(new CheckpointWriter(path));
+      if (!_options.log_path.empty()) {
+        log.reset(new EventLogWriter(_options.log_path,
+                                     event_log_layout<T>(_population.size(),
+                                                         _best.first.size(),
+                                                         _best.first.numWords()),
+                                     resumed, _options.log_chunk_size,
+                                     _options.log_chunks));
+        if (resumed) log->truncate(_generation);
+        else record(*log);
+      }
+      while (!stopped(result.reason)) {
+        step(observer);
+        if (log) record(*log);
+        if (writer && _options.checkpoint_interval > 0u &&
+            _generation % _options.checkpoint_interval == 0u) {
+          checkpoint(*writer);
+        }
+      }
+      if (writer) {
+        checkpoint(*writer);
+        writer->flush();
+      }
+      if (log) {
+        log->close();
+        if (_options.verbosity > 0 && log->dropped() > 0u) {
+          std::cerr << "# event log dropped " << log->dropped()
+                    << " records" << std::endl;
+        }
+      }
+      result.best = _best.first;
+      result.rank = _best.second;
+      result.generations = _generation;
+      result.evaluations = _population.evaluations();
+      result.seconds = elapsedSeconds();
+      return result;
+    }
+
+    /**
+     * Checks the stopping criteria, writing the reason when true
+     */
+    bool stopped(StopReason &reason) const {
+      return detail::check_stop(_options, _generation, _last_improvement,
+                                static_cast<double>(_best.second),
+                                _population.evaluations(), _start, reason);
+    }
+
+    /// Seconds since init()
+    double elapsedSeconds() const {
+      return detail::seconds_since(_start);
+    }
+
+    /// Produces and ranks the next generation
+    void step() {
+      NullObserver observer;
+      step(observer);
+    }
+
+    /**
+     * Produces and ranks the next generation, giving its
+     * GenerationStats to the observer
+     *
+     * Every genetic operator is applied to all children before the
+     * next one (a phase), so phases are timed with a few clock reads
+     * per generation. Statistics are only computed when the observer
+     * is not a NullObserver and instrumentation is enabled.
+     *
+     * With SolverOptions::parallel_offspring, couples are still
+     * selected sequentially, and then every child is crossed,
+     * mutated and ranked by the same task of the pool (so they are
+     * reported as crossover_ns, mutate_ns being zero). Child j draws
+     * its random numbers from its own Philox4x32 stream, given by the
+     * seed option, the generation and j, so the result is the same
+     * for any number of threads.
+     */
+    template<typename Observer>
+    void step(Observer &observer) {
+      PhaseTimer timer;
+      // offspring are written in place into the back buffer of the
+      // population, so steady state generations don't allocate memory
+      _couples.resize(_options.population_size - 1uL);
+      _population.select(_select_func, _couples);
+      _stats.select_ns = timer.lap();
+      if (_options.parallel_offspring && parallel_t::value) {
+        produceParallel(parallel_t());
+        _stats.crossover_ns = timer.lap();
+        _stats.mutate_ns = 0u;
+      }
+      else {
+        _population.beginGeneration(_couples.size());
+        for (size_t j=0; j<_couples.size(); ++j) {
+          detail::cross_child(_population, j, _couples[j],
+                              _cross_over_func, delta_t());
+        }
+        _stats.crossover_ns = timer.lap();
+        for (size_t j=0; j<_couples.size(); ++j) {
+          detail::mutate_child(_population, j, _mutate_func, delta_t());
+        }
+        _stats.mutate_ns = timer.lap();
+      }
+      // rank the whole generation at once
+      _population.endGeneration(_pool);
+      _stats.rank_ns = timer.lap();
+      ++_generation;
+      updateBest();
+      // elitism: the best one passes directly, with its known rank
+      _population.push(_best.first, _best.second);
+      typedef std::integral_constant<bool, is_bit_genome<Genome>::value> bits_t;
+      const bool may_restart = bits_t::value &&
+        _options.restart_diversity > 0.0;
+      double diversity = 0.0;
+      if (is_active_observer<Observer>::value || may_restart) {
+        diversity = detail::bit_diversity(_population, _column_counter,
+                                          _gen_counts, bits_t());
+      }
+      // the one which triggered the restart, if any
+      _stats.diversity = diversity;
+      if (may_restart && diversity < _options.restart_diversity) restart();
+      if (is_active_observer<Observer>::value) {
+        _stats.generation = _generation;
+        rank_statistics(_population, _stats);
+        _stats.restarts = _restarts;
+        _stats.cache_hits = _population.cacheHits();
+        _stats.cache_misses = _population.cacheMisses();
+        observer(static_cast<const GenerationStats<T>&>(_stats));
+      }
+    }
+
+    /**
+     * Appends a record of the current generation to log: its
+     * GenerationStats, the ranks of the population and the best
+     * Chromosome
+     *
+     * Only the ranks and the words of one Chromosome are copied, the
+     * log writes them from its own thread. The diversity is zero
+     * unless step() computed it. Nothing is done when the log drops
+     * the record.
+     */
+    void record(EventLogWriter &log) {
+      char *data = log.append();
+      if (!data) return;
+      const EventLogHeader &h = log.header();
+      rank_statistics(_population, _stats);
+      EventLogRecord r;
+      r.generation = _generation;
+      r.evaluations = _population.evaluations();
+      r.best = static_cast<double>(_stats.best);
+      r.mean = _stats.mean;
+      r.stddev = _stats.stddev;
+      r.diversity = _stats.diversity;
+      r.restarts = _restarts;
+      r.select_ns = _stats.select_ns;
+      r.crossover_ns = _stats.crossover_ns;
+      r.mutate_ns = _stats.mutate_ns;
+      r.rank_ns = _stats.rank_ns;
+      r.cache_hits = _population.cacheHits();
+      r.cache_misses = _population.cacheMisses();
+      std::memcpy(data, &r, sizeof(r));
+      const size_t n = std::min<size_t>(_population.size(), h.population_size);
+      std::memcpy(data + detail::event_ranks_offset(), _population.ranks().data(),
+                  n * sizeof(T));
+      const population_t &pop = _population;
+      std::memcpy(data + detail::event_words_offset(h),
+                  pop.genome(pop.topIndex()).words(),
+                  h.num_words * sizeof(word_type));
+    }
+
+    /**
+     * Replaces all but the SolverOptions::restart_elite best
+     * Chromosomes of the current generation by new ones from the
+     * initializer, keeping the population size
+     *
+     * step() calls it when the diversity falls below
+     * SolverOptions::restart_diversity. With parallel_offspring and an
+     * initializer which accepts a random generator, new Chromosomes
+     * are drawn in parallel from streams keyed by the seed and the
+     * generation, as init() does.
+     */
+    void restart() {
+      const size_t n = _population.size();
+      const size_t keep = std::min(_options.restart_elite, n);
+      _order.resize(n);
+      for (size_t i=0; i<n; ++i) _order[i] = i;
+      const population_t &pop = _population;
+      std::partial_sort(_order.begin(), _order.begin() + keep, _order.end(),
+                        [&pop](size_t a, size_t b) {
+                          return pop.rank(b) < pop.rank(a) ||
+                            (!(pop.rank(a) < pop.rank(b)) && a < b);
+                        });
+      std::vector<Hypothesis> elite;
+      elite.reserve(keep);
+      for (size_t j=0; j<keep; ++j) {
+        elite.push_back(Hypothesis(pop.genome(_order[j]), pop.rank(_order[j])));
+      }
+      _population.reset();
+      for (Hypothesis &h : elite) _population.push(std::move(h.first), h.second);
+      initPopulation(n - keep, mix64(mix64(_options.seed) + _generation),
+                     init_rng_t());
+      ++_restarts;
+      updateBest();
+    }
+
+    /// Number of restart() calls since init()
+    size_t restarts() const {
+      return _restarts;
+    }
+
+    /**
+     * Replaces the worst Chromosome of the current generation by x
+     *
+     * The best Hypothesis is updated if needed.
+     */
+    void inject(const Genome &x, const T rank) {
+      _population.replace(_population.bottomIndex(), x, rank);
+      updateBest();
+    }
+
+    /// As the previous one, moving x into the population
+    void inject(Genome &&x, const T rank) {
+      _population.replace(_population.bottomIndex(), std::move(x), rank);
+      updateBest();
+    }
+
+    /**
+     * Hands a snapshot of the current generation to writer, which
+     * writes it to disk from its own thread
+     *
+     * The snapshot has the Chromosomes and ranks of the population,
+     * the best Hypothesis, the counters of the stopping criteria and
+     * the state of the random generators of the initializer,
+     * selection, cross-over and mutation functors (see save_state()).
+     * The FitnessCache isn't saved. Only the words of the population
+     * are copied here, in parallel, so the solver barely stalls.
+     */
+    void checkpoint(CheckpointWriter &writer) {
+      std::ostringstream state;
+      save_state(_init_func, state);
+      save_state(_select_func, state);
+      save_state(_cross_over_func, state);
+      save_state(_mutate_func, state);
+      const std::string text = state.str();
+      const size_t n = _population.size();
+      SnapshotHeader h = snapshot_layout<T>(n, _best.first.size(), text.size(),
+                                            _best.first.numWords());
+      h.generation = _generation;
+      h.last_improvement = _last_improvement;
+      h.evaluations = _population.evaluations();
+      h.seconds = elapsedSeconds();
+      std::vector<char> &buffer = writer.buffer();
+      buffer.assign(h.file_size, 0);
+      char *data = buffer.data();
+      std::memcpy(data, &h, sizeof(h));
+      word_type *words = reinterpret_cast<word_type*>(data + h.words_offset);
+      const population_t &pop = _population;
+      const size_t stride = h.num_words;
+      _pool.parallelFor(n, [&pop, words, stride](size_t i) {
+          kernels::copy_words(words + i * stride, pop.genome(i).words(), stride);
+        });
+      std::memcpy(data + h.ranks_offset, pop.ranks().data(), n * sizeof(T));
+      std::memcpy(data + h.best_offset, _best.first.words(),
+                  stride * sizeof(word_type));
+      std::memcpy(data + h.best_offset + stride * sizeof(word_type),
+                  &_best.second, sizeof(T));
+      std::memcpy(data + h.state_offset, text.data(), text.size());
+      writer.commit();
+    }
+
+    /**
+     * Replaces init() by the state saved at the given snapshot
+     *
+     * The population is copied from the memory map without ranking
+     * it, and the genetic operators continue their random sequences,
+     * so the run goes on as if it had not been interrupted (the
+     * FitnessCache excepted). The operators should be built as in
+     * the interrupted run, and std::runtime_error is thrown when the
+     * population size or the genome type don't match.
+     */
+    void resume(const Snapshot &snapshot) {
+      const SnapshotHeader &h = snapshot.header();
+      if (h.num_genomes != _options.population_size) {
+        throw std::runtime_error("snapshot: population size doesn't match the options");
+      }
+      _best.first.resize(h.num_gens);
+      if (_best.first.numWords() != h.num_words) {
+        throw std::runtime_error("snapshot: words don't match the genome type");
+      }
+      _population.reset();
+      _population.restore(snapshot.words(), h.num_gens, snapshot.ranks<T>(),
+                          h.num_genomes, h.evaluations, _pool);
+      kernels::copy_words(_best.first.words(), snapshot.bestWords(),
+                          h.num_words);
+      _best.second = snapshot.bestRank<T>();
+      _generation = h.generation;
+      _last_improvement = h.last_improvement;
+      _start = std::chrono::steady_clock::now() -
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>
+        (std::chrono::duration<double>(h.seconds));
+      std::istringstream state(snapshot.state());
+      load_state(_init_func, state);
+      load_state(_select_func, state);
+      load_state(_cross_over_func, state);
+      load_state(_mutate_func, state);
+      if (state.fail()) {
+        throw std::runtime_error("snapshot: bad state of genetic operators");
+      }
+    }
+
+    /// Number of generations produced since init()
+    size_t generation() const {
+      return _generation;
+    }
+
+    /// The best Hypothesis found since init()
+    const Hypothesis &best() const {
+      return _best;
+    }
+
+    const population_t &population() const {
+      return _population;
+    }
+
+    population_t &population() {
+      return _population;
+    }
+
+  private:
+    // incremental ranking needs the help of both functors
+    typedef std::integral_constant<bool,
+      population_t::SUPPORTS_DELTA &&
+      reports_flips<MutationFunctor, Genome>::value> delta_t;
+
+    // parallel offspring needs both operators to accept a generator
+    typedef std::integral_constant<bool,
+      crosses_with_rng<CrossOverFunctor, Genome, Philox4x32>::value &&
+      (delta_t::value ?
+       reports_flips_with_rng<MutationFunctor, Genome, Philox4x32>::value :
+       mutates_with_rng<MutationFunctor, Genome, Philox4x32>::value)> parallel_t;
+
+    typedef std::integral_constant<bool,
+      initializes_with_rng<InitializerFunctor, Philox4x32>::value> init_rng_t;
+
+    const SolverOptions _options;
+    const InitializerFunctor &_init_func;
+    const SelectionFunctor &_select_func;
+    const CrossOverFunctor &_cross_over_func;
+    const MutationFunctor &_mutate_func;
+    ThreadPool _pool;
+    population_t _population;
+    Hypothesis _best;
+    std::vector<IndexCouple> _couples;
+    size_t _generation;
+    GenerationStats<T> _stats;
+    /// generation of the last improvement of _best
+    size_t _last_improvement;
+    size_t _restarts;
+    std::chrono::steady_clock::time_point _start;
+    /// positions sorted by rank, used by restart()
+    std::vector<size_t> _order;
+    /// buffers of population_diversity(), measured every step
+    kernels::ColumnCounter _column_counter;
+    std::vector<size_t> _gen_counts;
+
+    /// appends size new Chromosomes, key gives the parallel streams
+    void initPopulation(const size_t size, uint64_t, std::false_type) {
+      _population.init(_init_func, size, _pool);
+    }
+
+    void initPopulation(const size_t size, const uint64_t key,
+                        std::true_type) {
+      if (_options.parallel_offspring) {
+        _population.init(_init_func, size, _pool, key);
+      }
+      else {
+        _population.init(_init_func, size, _pool);
+      }
+    }
+
+    void produceParallel(std::false_type) {
+      // unreachable, operators don't accept random generators
+    }
+
+    void produceParallel(std::true_type) {
+      population_t &pop = _population;
+      const IndexCouple *couples = _couples.data();
+      const CrossOverFunctor &cross_over_func = _cross_over_func;
+      const MutationFunctor &mutate_func = _mutate_func;
+      const uint64_t seed = _options.seed;
+      const uint64_t generation = _generation;
+      pop.produceGeneration(_couples.size(), _pool,
+                            [&pop, couples, &cross_over_func, &mutate_func,
+                             seed, generation](size_t j) {
+          Philox4x32 rng = make_stream<Philox4x32>(seed, stream_id(generation, j));
+          detail::cross_child(pop, j, couples[j], cross_over_func, rng,
+                              delta_t());
+          detail::mutate_child(pop, j, mutate_func, rng, delta_t());
+        });
+    }
+
+    void updateBest() {
+      const size_t top = _population.topIndex();
+      if (_best.second < _population.rank(top)) {
+        _best.first = _population.genome(top);
+        _best.second = _population.rank(top);
+        _last_improvement = _generation;
+      }
+    }
+  }; // class GeneticSolver
+
+  /**
+   * As solve(), but returns a SolverResult with the best Chromosome,
+   * its rank, the number of generations and evaluations and the
+   * reason of termination
+   *
+   * Together with the stopping criteria of SolverOptions, it allows
+   * to stop as soon as the algorithm converges:
+   *
+   * @code
+   * SolverOptions options;
+   * options.num_iterations = 10000u;
+   * options.max_stall_generations = 500u;
+   * options.max_seconds = 60.0;
+   * SolverResult<Chromosome, float> result =
+   *   evolve(options, init, select, crossover, mutate, rank);
+   * if (result.reason == STALLED) ...
+   * @endcode
+   */
+  template<typename T=float,
+           typename InitializerFunctor,
+           typename SelectionFunctor,
+           typename CrossOverFunctor,
+           typename MutationFunctor,
+           typename RankFunctor,
+           typename Observer>
+  SolverResult<typename genome_of<InitializerFunctor>::type, T>
+  evolve(const SolverOptions &options,
+         const InitializerFunctor &init_func,
+         const SelectionFunctor &select_func,
+         const CrossOverFunctor &cross_over_func,
+         const MutationFunctor &mutate_func,
+         const RankFunctor &rank_func,
+         Observer &observer) {
+    GeneticSolver<T, InitializerFunctor, SelectionFunctor,
+                  CrossOverFunctor, MutationFunctor,
+                  RankFunctor> solver(options, init_func, select_func,
+                                      cross_over_func, mutate_func,
+                                      rank_func);
+    SolverResult<typename genome_of<InitializerFunctor>::type, T> result =
+      solver.run(observer);
+    if (options.verbosity > 0) {
+      std::cerr << "# generations " << result.generations
+                << " evaluations " << result.evaluations
+                << " seconds " << result.seconds
+                << " reason " << static_cast<int>(result.reason)
+                << " best " << result.rank << std::endl;
+      if (options.cache_capacity > 0u) {
+        std::cerr << "# fitness cache hits " << solver.population().cacheHits()
+                  << " misses " << solver.population().cacheMisses() << std::endl;
+      }
+      if (options.restart_diversity > 0.0) {
+        std::cerr << "# restarts " << solver.restarts() << std::endl;
+      }
+    }
+    return result;
+  }
+
+  /// As the previous one, without observer
+  template<typename T=float,
+           typename InitializerFunctor,
+           typename SelectionFunctor,
+           typename CrossOverFunctor,
+           typename MutationFunctor,
+           typename RankFunctor>
+  SolverResult<typename genome_of<InitializerFunctor>::type, T>
+  evolve(const SolverOptions &options,
+         const InitializerFunctor &init_func,
+         const SelectionFunctor &select_func,
+         const CrossOverFunctor &cross_over_func,
+         const MutationFunctor &mutate_func,
+         const RankFunctor &rank_func) {
+    if (options.verbosity > 1) {
+      StreamObserver observer(std::cerr);
+      return evolve<T>(options, init_func, select_func, cross_over_func,
+                       mutate_func, rank_func, observer);
+    }
+    NullObserver observer;
+    return evolve<T>(options, init_func, select_func, cross_over_func,
+                     mutate_func, rank_func, observer);
+  }
+
   /**
    * This function implements a generic genetic algorithm
    *
    * This algorithm is build on top of several genetic operators:
    *
    * - InitializerFunctor: a functor which returns a Chromosome each
-   *      time it is called.
+   *      time it is called. Its return type is the genome type used
+   *      by the algorithm (Chromosome or StaticChromosome).
    *
-   * - SelectionFunctor: a functor which receives a vector of
-   *      hypothesis and produces as output a vector of
-   *      Chromosome::Couple selected for cross over.
+   * - SelectionFunctor: a functor which receives the vector of ranks
+   *      of the population and fills a vector of IndexCouple with the
+   *      positions of the parents selected for cross over.
    *
    * - CrossOverFunctor: a functor which receives two Chromosome and
    *      returns their child, mixing gens on both inputs.
@@ -54,7 +946,10 @@ namespace GeneticAlgorithms {
    *      returns another one with some gens mutated (or not).
    *
    * - RankFunctor: a functor which receives a Chromosome and returns
-   *      its rank (template typename T)
+   *      its rank (template typename T). When it implements
+   *      rank_delta (see has_rank_delta) and MutationFunctor reports
+   *      the mutated gens, children which are a copy of a parent plus
+   *      mutations are ranked incrementally.
    *
    * ATTENTION this function maximizes by default, change RankFunctor
    * sign for minimization.
@@ -62,6 +957,13 @@ namespace GeneticAlgorithms {
    * @note This function implements basic elitism algorithm, the best
    * candidate survives to next generation.
    *
+   * @note When options.num_threads > 1, the children of every
+   * generation are ranked in parallel (num_threads=0 uses all
+   * hardware threads), so RankFunctor must be safe to call
+   * concurrently. Genetic operators are still called sequentially, so
+   * the result for a given seed doesn't depend on the number of
+   * threads.
+   *
    * @code
    *  struct MyRank {
    *    float operator()(const Chromosome &x) const {
@@ -71,8 +973,11 @@ namespace GeneticAlgorithms {
    *    }
    *  };
    *  std::mt19937_64 rng(12564);
-   *  Chromosome best = solve(1000u, // iterations
-   *                          100u,  // population
+   *  SolverOptions options;
+   *  options.num_iterations = 1000u;
+   *  options.population_size = 100u;
+   *  options.cache_capacity = 1000u;
+   *  Chromosome best = solve(options,
    *                          RandomInitializer(N, rng(), 0.5f),
    *                          FloatRouletteWheelSelection(rng()),
    *                          RandomSplitCrossOver(N, rng()),
@@ -80,41 +985,84 @@ namespace GeneticAlgorithms {
    *                          MyRank());
    * @endcode
    */
+  template<typename T=float,
+           typename InitializerFunctor,
+           typename SelectionFunctor,
+           typename CrossOverFunctor,
+           typename MutationFunctor,
+           typename RankFunctor>
+  typename genome_of<InitializerFunctor>::type
+  solve(const SolverOptions &options,
+        const InitializerFunctor &init_func,
+        const SelectionFunctor &select_func,
+        const CrossOverFunctor &cross_over_func,
+        const MutationFunctor &mutate_func,
+        const RankFunctor &rank_func) {
+    return evolve<T>(options, init_func, select_func, cross_over_func,
+                     mutate_func, rank_func).best;
+  }
+
+  /**
+   * As solve(), calling the observer after every generation
+   *
+   * The observer receives a const GenerationStats<T>& with ranks
+   * statistics, population diversity and the time spent at every
+   * phase of the generation.
+   *
+   * @code
+   * auto observer = [](const GenerationStats<float> &s) {
+   *   std::cout << s.generation << " " << s.best << " " << s.rank_ns << "\n";
+   * };
+   * Chromosome best = solve(options, init, select, crossover, mutate,
+   *                         rank, observer);
+   * @endcode
+   */
+  template<typename T=float,
+           typename InitializerFunctor,
+           typename SelectionFunctor,
+           typename CrossOverFunctor,
+           typename MutationFunctor,
+           typename RankFunctor,
+           typename Observer>
+  typename genome_of<InitializerFunctor>::type
+  solve(const SolverOptions &options,
+        const InitializerFunctor &init_func,
+        const SelectionFunctor &select_func,
+        const CrossOverFunctor &cross_over_func,
+        const MutationFunctor &mutate_func,
+        const RankFunctor &rank_func,
+        Observer &observer) {
+    return evolve<T>(options, init_func, select_func, cross_over_func,
+                     mutate_func, rank_func, observer).best;
+  }
+
+  /**
+   * Runs solve() with the given options and default values for the
+   * rest of SolverOptions
+   */
   template<typename InitializerFunctor,
            typename SelectionFunctor,
            typename CrossOverFunctor,
            typename MutationFunctor,
            typename RankFunctor,
            typename T=float>
-  Chromosome solve(const size_t num_iterations,
-                   const size_t population_size,
-                   const InitializerFunctor &init_func,
-                   const SelectionFunctor &select_func,
-                   const CrossOverFunctor &cross_over_func,
-                   const MutationFunctor &mutate_func,
-                   const RankFunctor &rank_func,
-                   int verbosity=0) {
-    Population<RankFunctor, T> current(rank_func);
-    Population<RankFunctor, T> next(rank_func);
-
-    current.init(init_func, population_size);
-
-    typename Population<RankFunctor, T>::Hypothesis best = current.top();
-
-    for (size_t i=0; i<num_iterations; ++i) {
-      for (auto couple : current.select(select_func, population_size - 1uL)) {
-        next.push(mutate_func(cross_over_func(couple.first, couple.second)));
-      }
-      std::swap(current, next);
-      next.reset();
-      if (best.second < current.top().second) {
-        best = current.top();
-      }
-      // elitism: the best one passes directly
-      current.push(best.first);
-    }
-
-    return best.first;
+  typename genome_of<InitializerFunctor>::type
+  solve(const size_t num_iterations,
+        const size_t population_size,
+        const InitializerFunctor &init_func,
+        const SelectionFunctor &select_func,
+        const CrossOverFunctor &cross_over_func,
+        const MutationFunctor &mutate_func,
+        const RankFunctor &rank_func,
+        int verbosity=0,
+        size_t num_threads=1u) {
+    SolverOptions options;
+    options.num_iterations = num_iterations;
+    options.population_size = population_size;
+    options.verbosity = verbosity;
+    options.num_threads = num_threads;
+    return solve<T>(options, init_func, select_func, cross_over_func,
+                    mutate_func, rank_func);
   }
 
 } // namespace GeneticAlgorithms
@@ -0,0 +1,140 @@
+/*
+ * This file is part of GeneticAlgorithms toolkit
+ *
+ * Copyright 2017, Francisco Zamora-Martinez
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef INDEXED_HEAP_H
+#define INDEXED_HEAP_H
+
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace GeneticAlgorithms {
+
+  /**
+   * A binary heap of the keys of n items, addressed by item position
+   *
+   * top() is the item whose key is the minimum following Compare
+   * (std::less gives a min-heap), and the key of any item can be
+   * changed in O(log n) with update(), since the heap position of
+   * every item is tracked. It is used to find the worst Chromosome
+   * of a population while Chromosomes are replaced one by one.
+   *
+   * ATTENTION: no thread safe object.
+   *
+   * @code
+   * IndexedHeap<float> heap;
+   * heap.build(ranks.data(), ranks.size());
+   * size_t worst = heap.top();
+   * heap.update(worst, new_rank);
+   * @endcode
+   */
+  template<typename T, typename Compare = std::less<T> >
+  class IndexedHeap {
+  public:
+    explicit IndexedHeap(const Compare &compare = Compare()) :
+      _compare(compare) {
+    }
+
+    /// Builds the heap with items [0,n) and the given keys, in O(n)
+    void build(const T *keys, const size_t n) {
+      _keys.assign(keys, keys + n);
+      _heap.resize(n);
+      _pos.resize(n);
+      for (size_t i=0; i<n; ++i) _heap[i] = _pos[i] = i;
+      for (size_t i=n/2u; i>0u; --i) siftDown(i - 1u);
+    }
+
+    size_t size() const {
+      return _heap.size();
+    }
+
+    bool empty() const {
+      return _heap.empty();
+    }
+
+    /// The item with the minimum key, the heap can't be empty
+    size_t top() const {
+      return _heap[0];
+    }
+
+    const T &key(const size_t item) const {
+      return _keys[item];
+    }
+
+    /// Changes the key of the given item, in O(log n)
+    void update(const size_t item, const T &key) {
+      const bool up = _compare(key, _keys[item]);
+      _keys[item] = key;
+      if (up) siftUp(_pos[item]);
+      else siftDown(_pos[item]);
+    }
+
+  private:
+    Compare _compare;
+    std::vector<T> _keys;
+    /// items in heap order
+    std::vector<size_t> _heap;
+    /// position of every item in _heap
+    std::vector<size_t> _pos;
+
+    bool less(const size_t a, const size_t b) const {
+      return _compare(_keys[_heap[a]], _keys[_heap[b]]);
+    }
+
+    void swapNodes(const size_t a, const size_t b) {
+      std::swap(_heap[a], _heap[b]);
+      _pos[_heap[a]] = a;
+      _pos[_heap[b]] = b;
+    }
+
+    void siftUp(size_t i) {
+      while (i > 0u) {
+        const size_t parent = (i - 1u) / 2u;
+        if (!less(i, parent)) break;
+        swapNodes(i, parent);
+        i = parent;
+      }
+    }
+
+    void siftDown(size_t i) {
+      const size_t n = _heap.size();
+      for (;;) {
+        const size_t l = 2u*i + 1u, r = l + 1u;
+        size_t m = i;
+        if (l < n && less(l, m)) m = l;
+        if (r < n && less(r, m)) m = r;
+        if (m == i) break;
+        swapNodes(i, m);
+        i = m;
+      }
+    }
+  }; // class IndexedHeap
+
+} // namespace GeneticAlgorithms
+
+#endif // INDEXED_HEAP_H
@@ -29,10 +29,17 @@
 #define INITIALIZERS_H
 
 #include <boost/dynamic_bitset.hpp>
+#include <istream>
 #include <limits>
+#include <ostream>
 #include <random>
+#include <utility>
 
+#include "bit_kernels.h"
 #include "chromosome.h"
+#include "permutation.h"
+#include "real_kernels.h"
+#include "real_vector.h"
 
 namespace GeneticAlgorithms {
 
@@ -41,35 +48,201 @@ namespace GeneticAlgorithms {
    *
    * The functor uses the given probability to decide if a gen should
    * be 0 or 1, following a Bernoulli distribution with parameter
-   * p=prob.
+   * p=prob. Gens are drawn 64 at a time, by composing random words
+   * with AND/OR operations (see kernels::BernoulliWordSampler), so
+   * prob is rounded to 16 binary digits and p=0.5 costs one random
+   * word per 64 gens.
+   *
+   * The Genome template argument is the type of the generated
+   * chromosomes, RandomInitializer is the one for Chromosome. The RNG
+   * template argument is the internal random generator (see
+   * random.h).
    *
    * ATTENTION: no thread safe object, it should be created for each
-   * thread in your program.
+   * thread in your program, or used through the overload which
+   * receives a random generator.
    */
-  class RandomInitializer {
+  template<typename Genome, typename RNG = std::mt19937_64>
+  class BasicRandomInitializer {
   public:
-    RandomInitializer(size_t N, unsigned seed, float prob) :
+    BasicRandomInitializer(size_t N, unsigned seed, float prob) :
       _N(N),
       _rng(seed),
-      _real_dist(0.0f, 1.0f),
-      _prob(prob) {
+      _sampler(prob) {
+    }
+
+    /// Restarts the random generator with the given seed
+    void seed(unsigned seed) {
+      _rng.seed(seed);
+    }
+
+    /// Writes the state of the random generator, see save_state()
+    void saveState(std::ostream &os) const {
+      os << _rng << ' ';
+    }
+
+    /// Restores a state written by saveState()
+    void loadState(std::istream &is) const {
+      is >> _rng;
+    }
+
+    Genome operator()() const {
+      return (*this)(_rng);
+    }
+
+    /**
+     * As the previous one, drawing random numbers from rng
+     *
+     * The functor state is not modified, so this overload can be
+     * called concurrently with different generators.
+     */
+    template<typename URNG>
+    Genome operator()(URNG &rng) const {
+      Genome dest(_N);
+      word_type *words = dest.words();
+      const size_t n = dest.numWords();
+      for (size_t i=0; i<n; ++i) words[i] = _sampler(rng);
+      // padding gens must be zero
+      if (n > 0u) words[n-1u] &= kernels::last_word_mask(_N);
+      return dest;
+    }
+
+  private:
+    const size_t _N;
+    mutable RNG _rng;
+    const kernels::BernoulliWordSampler _sampler;
+  }; // class BasicRandomInitializer
+
+  typedef BasicRandomInitializer<Chromosome> RandomInitializer;
+
+  /**
+   * This class generates uniformly random Permutations of N values
+   *
+   * Every permutation is drawn by a Fisher-Yates shuffle of the
+   * identity. The RNG template argument is the internal random
+   * generator (see random.h).
+   *
+   * ATTENTION: no thread safe object, it should be created for each
+   * thread in your program, or used through the overload which
+   * receives a random generator.
+   */
+  template<typename RNG = std::mt19937_64>
+  class BasicRandomPermutationInitializer {
+  public:
+    BasicRandomPermutationInitializer(size_t N, unsigned seed) :
+      _N(N),
+      _rng(seed) {
+    }
+
+    /// Restarts the random generator with the given seed
+    void seed(unsigned seed) {
+      _rng.seed(seed);
+    }
+
+    /// Writes the state of the random generator, see save_state()
+    void saveState(std::ostream &os) const {
+      os << _rng << ' ';
+    }
+
+    /// Restores a state written by saveState()
+    void loadState(std::istream &is) const {
+      is >> _rng;
+    }
+
+    Permutation operator()() const {
+      return (*this)(_rng);
     }
 
-    Chromosome operator()() const {
-      bitset dest(_N);
-      for (size_t i=0; i<_N; ++i) {
-        // sample from the distribution and decide if 0 or 1
-        dest[i] = (_real_dist(_rng) < _prob);
+    /**
+     * As the previous one, drawing random numbers from rng
+     *
+     * The functor state is not modified, so this overload can be
+     * called concurrently with different generators.
+     */
+    template<typename URNG>
+    Permutation operator()(URNG &rng) const {
+      Permutation dest(_N);
+      uint32_t *values = dest.data();
+      for (size_t i=_N; i>1u; --i) {
+        std::uniform_int_distribution<size_t> dist(0u, i - 1u);
+        std::swap(values[i - 1u], values[dist(rng)]);
       }
-      return Chromosome(std::move(dest));
+      return dest;
+    }
+
+  private:
+    const size_t _N;
+    mutable RNG _rng;
+  }; // class BasicRandomPermutationInitializer
+
+  typedef BasicRandomPermutationInitializer<> RandomPermutationInitializer;
+
+  /**
+   * This class generates real vectors with values drawn uniformly
+   * from (lower,upper)
+   *
+   * The Genome template argument is FloatVector or DoubleVector. The
+   * RNG template argument is the internal random generator (see
+   * random.h), a 64 bits one (see real_kernels.h).
+   *
+   * ATTENTION: no thread safe object, it should be created for each
+   * thread in your program, or used through the overload which
+   * receives a random generator.
+   */
+  template<typename Genome, typename RNG = std::mt19937_64>
+  class BasicUniformRealInitializer {
+  public:
+    typedef typename Genome::value_type value_type;
+
+    BasicUniformRealInitializer(size_t N, unsigned seed,
+                                double lower, double upper) :
+      _N(N),
+      _rng(seed),
+      _lower(static_cast<value_type>(lower)),
+      _upper(static_cast<value_type>(upper)) {
+    }
+
+    /// Restarts the random generator with the given seed
+    void seed(unsigned seed) {
+      _rng.seed(seed);
+    }
+
+    /// Writes the state of the random generator, see save_state()
+    void saveState(std::ostream &os) const {
+      os << _rng << ' ';
+    }
+
+    /// Restores a state written by saveState()
+    void loadState(std::istream &is) const {
+      is >> _rng;
+    }
+
+    Genome operator()() const {
+      return (*this)(_rng);
+    }
+
+    /**
+     * As the previous one, drawing random numbers from rng
+     *
+     * The functor state is not modified, so this overload can be
+     * called concurrently with different generators.
+     */
+    template<typename URNG>
+    Genome operator()(URNG &rng) const {
+      Genome dest(_N);
+      kernels::uniform_fill(dest.data(), _N, _lower, _upper, rng);
+      return dest;
     }
 
   private:
-    const unsigned _N;
-    mutable std::mt19937_64 _rng;
-    mutable std::uniform_real_distribution<float> _real_dist;
-    const float _prob;
-  }; // class RandomMutate
+    const size_t _N;
+    mutable RNG _rng;
+    const value_type _lower;
+    const value_type _upper;
+  }; // class BasicUniformRealInitializer
+
+  typedef BasicUniformRealInitializer<FloatVector> UniformFloatInitializer;
+  typedef BasicUniformRealInitializer<DoubleVector> UniformDoubleInitializer;
 
 } // namespace GeneticAlgorithms
 
@@ -0,0 +1,265 @@
+/*
+ * This file is part of GeneticAlgorithms toolkit
+ *
+ * Copyright 2017, Francisco Zamora-Martinez
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+#include "bit_kernels.h"
+#include "chromosome.h"
+
+/**
+ * Define GA_DISABLE_INSTRUMENTATION before including any header of
+ * the toolkit to remove timers, statistics and observer calls from
+ * the generated code.
+ */
+#ifdef GA_DISABLE_INSTRUMENTATION
+#define GA_INSTRUMENTATION 0
+#else
+#define GA_INSTRUMENTATION 1
+#endif
+
+namespace GeneticAlgorithms {
+
+  /**
+   * Statistics of one generation, given to observers
+   *
+   * Ranks statistics are computed over the current population (the
+   * elite included). Timers are measured in nanoseconds and cache
+   * counters are accumulated since the beginning.
+   */
+  template<typename T>
+  struct GenerationStats {
+    size_t generation;
+    size_t population_size;
+    /// best rank in the population
+    T best;
+    double mean;
+    double stddev;
+    /**
+     * mean Hamming distance between pairs, divided by the genome size,
+     * see population_diversity(). Zero for genomes which aren't
+     * bitsets.
+     */
+    double diversity;
+    /// partial restarts since the beginning, see SolverOptions
+    size_t restarts;
+    uint64_t select_ns;
+    uint64_t crossover_ns;
+    uint64_t mutate_ns;
+    uint64_t rank_ns;
+    size_t cache_hits;
+    size_t cache_misses;
+
+    GenerationStats() :
+      generation(0u), population_size(0u), best(), mean(0.0),
+      stddev(0.0), diversity(0.0), restarts(0u), select_ns(0u), crossover_ns(0u),
+      mutate_ns(0u), rank_ns(0u), cache_hits(0u), cache_misses(0u) {
+    }
+  };
+
+  /**
+   * The default observer, it does nothing
+   *
+   * When the observer of a solver is a NullObserver, no statistic is
+   * computed.
+   */
+  struct NullObserver {
+    template<typename Stats>
+    void operator()(const Stats &) const {
+    }
+  };
+
+  /// True unless Observer is NullObserver
+  template<typename Observer>
+  struct is_active_observer {
+    static const bool value = GA_INSTRUMENTATION &&
+      !std::is_same<typename std::decay<Observer>::type, NullObserver>::value;
+  };
+
+  /// An observer which writes one line per generation into a stream
+  class StreamObserver {
+  public:
+    explicit StreamObserver(std::ostream &out = std::cerr,
+                            const size_t interval = 1u) :
+      _out(out), _interval(interval) {
+    }
+
+    template<typename T>
+    void operator()(const GenerationStats<T> &s) const {
+      if (_interval == 0u || s.generation % _interval != 0u) return;
+      _out << "# gen " << s.generation
+           << " best " << s.best
+           << " mean " << s.mean
+           << " stddev " << s.stddev
+           << " diversity " << s.diversity
+           << " restarts " << s.restarts
+           << " select_ns " << s.select_ns
+           << " crossover_ns " << s.crossover_ns
+           << " mutate_ns " << s.mutate_ns
+           << " rank_ns " << s.rank_ns
+           << " cache_hits " << s.cache_hits
+           << " cache_misses " << s.cache_misses << "\n";
+    }
+
+  private:
+    std::ostream &_out;
+    size_t _interval;
+  };
+
+  /**
+   * Measures the time between consecutive calls to lap()
+   *
+   * All methods are empty when instrumentation is disabled.
+   */
+  class PhaseTimer {
+  public:
+    PhaseTimer() {
+      restart();
+    }
+
+    void restart() {
+#if GA_INSTRUMENTATION
+      _last = std::chrono::steady_clock::now();
+#endif
+    }
+
+    /// nanoseconds since last call to lap() or restart()
+    uint64_t lap() {
+#if GA_INSTRUMENTATION
+      const std::chrono::steady_clock::time_point now =
+        std::chrono::steady_clock::now();
+      const uint64_t ns = static_cast<uint64_t>
+        (std::chrono::duration_cast<std::chrono::nanoseconds>(now - _last).count());
+      _last = now;
+      return ns;
+#else
+      return 0u;
+#endif
+    }
+
+  private:
+#if GA_INSTRUMENTATION
+    std::chrono::steady_clock::time_point _last;
+#endif
+  };
+
+  /**
+   * Computes mean and standard deviation of the ranks of a population
+   */
+  template<typename PopulationType, typename T>
+  void rank_statistics(const PopulationType &pop, GenerationStats<T> &stats) {
+    const size_t n = pop.size();
+    stats.population_size = n;
+    if (n == 0u) return;
+    double sum = 0.0, sum2 = 0.0;
+    for (size_t i=0; i<n; ++i) {
+      const double r = static_cast<double>(pop.rank(i));
+      sum += r;
+      sum2 += r*r;
+    }
+    stats.best = pop.rank(pop.topIndex());
+    stats.mean = sum / n;
+    stats.stddev = std::sqrt(std::max(0.0, sum2 / n - stats.mean * stats.mean));
+  }
+
+  /**
+   * Mean Hamming distance from the Chromosomes of a population to
+   * their centroid, divided by the number of gens
+   *
+   * With c_j the number of ones of gen j over the n Chromosomes, the
+   * centroid is p_j = c_j / n and the mean distance to it is
+   * sum_j 2 p_j (1 - p_j) / N, which is also the mean Hamming distance
+   * between pairs. It is zero for a population of clones and 0.5 for
+   * a random one.
+   *
+   * Counts are accumulated by a kernels::ColumnCounter over the words
+   * of every Chromosome, so the cost is O(n * words) plus
+   * O(N log n) to read the counters, instead of a loop over every
+   * gen set. Only bitset genomes (see is_bit_genome) are accepted: the
+   * words of Permutation or RealVector aren't gens.
+   *
+   * counter and counts are working buffers, so callers which measure
+   * every generation keep them and don't allocate once they are warm.
+   */
+  template<typename PopulationType>
+  double population_diversity(const PopulationType &pop,
+                              kernels::ColumnCounter &counter,
+                              std::vector<size_t> &counts) {
+    typedef typename std::decay<decltype(pop.genome(0))>::type genome_t;
+    static_assert(is_bit_genome<genome_t>::value,
+                  "population_diversity() needs bitset genomes");
+    const size_t n = pop.size();
+    if (n == 0u) return 0.0;
+    const size_t N = pop.genome(0).size();
+    if (N == 0u) return 0.0;
+    const size_t num_words = num_words_for(N);
+    counter.reset(num_words);
+    for (size_t i=0; i<n; ++i) counter.add(pop.genome(i).words());
+    counts.resize(num_words * WORD_BITS);
+    counter.counts(counts.data());
+    double sum = 0.0;
+    for (size_t j=0; j<N; ++j) {
+      sum += 2.0 * double(counts[j]) * double(n - counts[j]);
+    }
+    return sum / (double(n) * double(n) * double(N));
+  }
+
+  /// As the previous one, with its own buffers
+  template<typename PopulationType>
+  double population_diversity(const PopulationType &pop) {
+    kernels::ColumnCounter counter;
+    std::vector<size_t> counts;
+    return population_diversity(pop, counter, counts);
+  }
+
+  namespace detail {
+    /// population_diversity() of bitset genomes, zero for the rest
+    template<typename PopulationType>
+    double bit_diversity(const PopulationType &pop,
+                         kernels::ColumnCounter &counter,
+                         std::vector<size_t> &counts, std::true_type) {
+      return population_diversity(pop, counter, counts);
+    }
+
+    template<typename PopulationType>
+    double bit_diversity(const PopulationType &, kernels::ColumnCounter &,
+                         std::vector<size_t> &, std::false_type) {
+      return 0.0;
+    }
+  } // namespace detail
+
+} // namespace GeneticAlgorithms
+
+#endif // INSTRUMENTATION_H
@@ -0,0 +1,261 @@
+/*
+ * This file is part of GeneticAlgorithms toolkit
+ *
+ * Copyright 2017, Francisco Zamora-Martinez
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef ISLAND_SOLVER_H
+#define ISLAND_SOLVER_H
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "concurrent_queue.h"
+#include "genetic_solver.h"
+#include "operator_traits.h"
+#include "thread_pool.h"
+
+namespace GeneticAlgorithms {
+
+  /**
+   * Configuration of the island model implemented by solve_islands()
+   */
+  struct IslandOptions {
+    /// destination of migrants
+    enum Topology {
+      /// island i sends to island (i+1) % num_islands
+      RING,
+      /// every migrant goes to a random island, other than its own
+      RANDOM
+    };
+
+    /// number of islands, each one runs in its own thread
+    size_t num_islands;
+    /// generations between migrations
+    size_t migration_interval;
+    /// number of best Chromosomes sent at every migration
+    size_t num_migrants;
+    Topology topology;
+    /// seed for the operators of every island and the topology
+    unsigned seed;
+    /// migrants waiting at every island, extra migrants are dropped
+    size_t queue_capacity;
+
+    IslandOptions() :
+      num_islands(ThreadPool::defaultSize()),
+      migration_interval(50u),
+      num_migrants(2u),
+      topology(RING),
+      seed(12345u),
+      queue_capacity(64u) {
+    }
+  };
+
+  namespace detail {
+
+    /// The state of one island, its operators are not shared
+    template<typename T,
+             typename InitializerFunctor,
+             typename SelectionFunctor,
+             typename CrossOverFunctor,
+             typename MutationFunctor,
+             typename RankFunctor>
+    struct Island {
+      typedef GeneticSolver<T, InitializerFunctor, SelectionFunctor,
+                            CrossOverFunctor, MutationFunctor,
+                            RankFunctor> solver_t;
+      typedef typename solver_t::Hypothesis Hypothesis;
+
+      InitializerFunctor init_func;
+      SelectionFunctor select_func;
+      CrossOverFunctor cross_over_func;
+      MutationFunctor mutate_func;
+      RankFunctor rank_func;
+      /// migrants sent to this island by any other one
+      ConcurrentQueue<Hypothesis> inbox;
+      std::mt19937_64 rng;
+      Hypothesis best;
+      std::exception_ptr error;
+
+      Island(const InitializerFunctor &init_func,
+             const SelectionFunctor &select_func,
+             const CrossOverFunctor &cross_over_func,
+             const MutationFunctor &mutate_func,
+             const RankFunctor &rank_func,
+             const unsigned seed,
+             const size_t queue_capacity) :
+        init_func(init_func),
+        select_func(select_func),
+        cross_over_func(cross_over_func),
+        mutate_func(mutate_func),
+        rank_func(rank_func),
+        inbox(queue_capacity),
+        rng(seed) {
+        // copies of the operators would repeat the same random numbers
+        reseed(this->init_func, derive_seed(seed, 1u));
+        reseed(this->select_func, derive_seed(seed, 2u));
+        reseed(this->cross_over_func, derive_seed(seed, 3u));
+        reseed(this->mutate_func, derive_seed(seed, 4u));
+      }
+    };
+
+  } // namespace detail
+
+  /**
+   * Island model genetic algorithm running on several threads
+   *
+   * IslandOptions::num_islands independent populations evolve as in
+   * solve(), every one in its own thread and with its own copies of
+   * the genetic operators, which are reseeded with different seeds
+   * (see reseed(), user functors without a seed() method are just
+   * copied). Every IslandOptions::migration_interval generations, each
+   * island receives the migrants waiting at its queue, which replace
+   * its worst Chromosomes, and sends copies of its best
+   * IslandOptions::num_migrants Chromosomes to other islands following
+   * the given topology. Queues are lock-free, so islands never wait
+   * for each other.
+   *
+   * Every island runs options.num_iterations generations with
+   * options.population_size Chromosomes ranked on its thread
+   * (options.num_threads is ignored). The best Chromosome over all
+   * islands is returned.
+   *
+   * @note Since migrations are asynchronous, results for a given seed
+   * depend on thread scheduling unless num_islands is 1.
+   *
+   * @code
+   * IslandOptions islands;
+   * islands.num_islands = 8u;
+   * Chromosome best = solve_islands(options, islands,
+   *                                 RandomInitializer(N, rng(), 0.5f),
+   *                                 FloatRouletteWheelSelection(rng()),
+   *                                 RandomSplitCrossOver(N, rng()),
+   *                                 RandomMutate(rng(), 0.01f),
+   *                                 MyRank());
+   * @endcode
+   */
+  template<typename T=float,
+           typename InitializerFunctor,
+           typename SelectionFunctor,
+           typename CrossOverFunctor,
+           typename MutationFunctor,
+           typename RankFunctor>
+  typename genome_of<InitializerFunctor>::type
+  solve_islands(const SolverOptions &options,
+                const IslandOptions &islands,
+                const InitializerFunctor &init_func,
+                const SelectionFunctor &select_func,
+                const CrossOverFunctor &cross_over_func,
+                const MutationFunctor &mutate_func,
+                const RankFunctor &rank_func) {
+    typedef detail::Island<T, InitializerFunctor, SelectionFunctor,
+                           CrossOverFunctor, MutationFunctor,
+                           RankFunctor> island_t;
+    typedef typename island_t::solver_t solver_t;
+    const size_t K = std::max<size_t>(1u, islands.num_islands);
+
+    std::vector<std::unique_ptr<island_t> > state;
+    for (size_t k=0; k<K; ++k) {
+      state.push_back(std::unique_ptr<island_t>
+                      (new island_t(init_func, select_func, cross_over_func,
+                                    mutate_func, rank_func,
+                                    derive_seed(islands.seed, k),
+                                    islands.queue_capacity)));
+    }
+
+    SolverOptions island_options = options;
+    island_options.num_threads = 1u;
+
+    auto run = [&](const size_t k) {
+      island_t &island = *state[k];
+      try {
+        solver_t solver(island_options, island.init_func,
+                        island.select_func, island.cross_over_func,
+                        island.mutate_func, island.rank_func);
+        solver.init();
+        std::vector<size_t> order;
+        typename island_t::Hypothesis migrant;
+        std::uniform_int_distribution<size_t> other(0u, K > 1u ? K - 2u : 0u);
+        for (size_t i=0; i<options.num_iterations; ++i) {
+          solver.step();
+          if (K == 1u || islands.migration_interval == 0u ||
+              (i + 1u) % islands.migration_interval != 0u) continue;
+          // immigrants replace the worst ones
+          while (island.inbox.tryPop(migrant)) {
+            solver.inject(std::move(migrant.first), migrant.second);
+          }
+          // emigrants are the best ones
+          const auto &pop = solver.population();
+          const size_t m = std::min(islands.num_migrants, pop.size());
+          order.resize(pop.size());
+          std::iota(order.begin(), order.end(), size_t(0u));
+          std::nth_element(order.begin(), order.begin() + m, order.end(),
+                           [&pop](size_t a, size_t b) {
+                             return pop.rank(b) < pop.rank(a);
+                           });
+          for (size_t j=0; j<m; ++j) {
+            size_t dest = (k + 1u) % K;
+            if (islands.topology == IslandOptions::RANDOM) {
+              dest = other(island.rng);
+              if (dest >= k) ++dest;
+            }
+            migrant.first = pop.genome(order[j]);
+            migrant.second = pop.rank(order[j]);
+            state[dest]->inbox.tryPush(migrant);
+          }
+        }
+        island.best = solver.best();
+        if (options.verbosity > 0) {
+          std::cerr << "# island " << k << " best " << island.best.second
+                    << std::endl;
+        }
+      }
+      catch (...) {
+        island.error = std::current_exception();
+      }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t k=1u; k<K; ++k) threads.push_back(std::thread(run, k));
+    run(0u);
+    for (auto &t : threads) t.join();
+
+    size_t best = 0u;
+    for (size_t k=0; k<K; ++k) {
+      if (state[k]->error) std::rethrow_exception(state[k]->error);
+      if (state[best]->best.second < state[k]->best.second) best = k;
+    }
+    return state[best]->best.first;
+  }
+
+} // namespace GeneticAlgorithms
+
+#endif // ISLAND_SOLVER_H
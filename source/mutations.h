@@ -28,11 +28,20 @@
 #ifndef TRANSFORMS_H
 #define TRANSFORMS_H
 
-#include <boost/dynamic_bitset.hpp>
+#include <algorithm>
+#include <istream>
+#include <limits>
+#include <ostream>
 #include <random>
-#include <unordered_set>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
+#include "bit_kernels.h"
 #include "chromosome.h"
+#include "permutation.h"
+#include "real_kernels.h"
+#include "real_vector.h"
 
 namespace GeneticAlgorithms {
 
@@ -44,69 +53,497 @@ namespace GeneticAlgorithms {
    * left with its original value, and when it is 1, its value is
    * flipped.
    *
+   * The RNG template argument is the internal random generator (see
+   * random.h), RandomMutate uses std::mt19937_64.
+   *
    * ATTENTION: no thread safe object, it should be created for each
-   * thread in your program.
+   * thread in your program, or used through the overloads which
+   * receive a random generator.
    */
-  class RandomMutate {
+  template<typename RNG = std::mt19937_64>
+  class BasicRandomMutate {
   public:
-    RandomMutate(unsigned seed, float prob) :
+    BasicRandomMutate(unsigned seed, float prob) :
       _rng(seed),
-      _real_dist(0.0f, 1.0f),
+      _geo_dist(std::min(std::max(prob, 1e-12f), 1.0f)),
+      _sampler(prob),
       _prob(prob) {
     }
 
+    /// Restarts the random generator with the given seed
+    void seed(unsigned seed) {
+      _rng.seed(seed);
+    }
+
+    /// Writes the state of the random generator, see save_state()
+    void saveState(std::ostream &os) const {
+      os << _rng << ' ';
+    }
+
+    /// Restores a state written by saveState()
+    void loadState(std::istream &is) const {
+      is >> _rng;
+    }
+
     /**
      * Functor which applies random mutations to a given Chromosome
      *
      * The functor follows two code paths:
      *
-     * - When the probability of mutation is very high, we assume it
-     *   is better to ask every bit if it should be or not mutated.
+     * - When the probability of mutation is high, a random mask with
+     *   the given bit density is drawn for every word and XORed with
+     *   it (see kernels::BernoulliWordSampler).
+     *
+     * - Otherwise, the gap between consecutive mutated gens is drawn
+     *   from a geometric distribution, so the gens are traversed in
+     *   one pass jumping from one mutation to the next, and the cost
+     *   is proportional to the number of mutations.
      *
-     * - Otherwise, we assume it is better to draw the number of
-     *   mutated bits from a binomial distribution, and proceed
-     *   sampling as many bits as necessary from a uniform
-     *   distribution.
+     * Both paths flip every gene independently with the given
+     * probability.
      */
-    Chromosome operator()(const Chromosome &source) const {
-      bitset dest(source.gens());
-      
-      if (_prob > 0.2f) {
-        // high mutation probability, traverse all bits
-        for (size_t i=0; i<source.size(); ++i) {
-          if (_real_dist(_rng) < _prob) dest.flip(i);
+    template<typename Genome>
+    Genome operator()(const Genome &source) const {
+      Genome dest(source);
+      mutate(dest, 0, _rng);
+      return dest;
+    }
+
+    /**
+     * As the previous one for a temporary source, which is mutated in
+     * place and returned without allocating
+     */
+    template<typename Genome,
+             typename = typename std::enable_if<!std::is_lvalue_reference<Genome>::value>::type>
+    Genome operator()(Genome &&source) const {
+      mutate(source, 0, _rng);
+      return std::move(source);
+    }
+
+    /**
+     * Writes the mutation of source into dest, reusing its memory
+     *
+     * source and dest can be the same object, mutating it in place.
+     */
+    template<typename Genome>
+    void operator()(const Genome &source, Genome &dest) const {
+      if (&source != &dest) dest = source;
+      mutate(dest, 0, _rng);
+    }
+
+    /**
+     * As the previous one, and writes into flipped the positions of
+     * the mutated gens in increasing order
+     *
+     * This overload allows incremental ranking, see has_rank_delta.
+     */
+    template<typename Genome>
+    void operator()(const Genome &source, Genome &dest,
+                    std::vector<size_t> &flipped) const {
+      if (&source != &dest) dest = source;
+      flipped.clear();
+      mutate(dest, &flipped, _rng);
+    }
+
+    /**
+     * As operator()(source, dest), drawing random numbers from rng
+     *
+     * The functor state is not modified, so this overload can be
+     * called concurrently with different generators.
+     */
+    template<typename Genome, typename URNG>
+    void operator()(const Genome &source, Genome &dest, URNG &rng) const {
+      if (&source != &dest) dest = source;
+      mutate(dest, 0, rng);
+    }
+
+    /// As operator()(source, dest, flipped), drawing from rng
+    template<typename Genome, typename URNG>
+    void operator()(const Genome &source, Genome &dest,
+                    std::vector<size_t> &flipped, URNG &rng) const {
+      if (&source != &dest) dest = source;
+      flipped.clear();
+      mutate(dest, &flipped, rng);
+    }
+
+  private:
+    mutable RNG _rng;
+    /// number of non mutated gens before next mutation, copied at
+    /// every call so the functor stays reentrant
+    std::geometric_distribution<size_t> _geo_dist;
+    kernels::BernoulliWordSampler _sampler;
+    float _prob;
+
+    template<typename Genome, typename URNG>
+    void mutate(Genome &dest, std::vector<size_t> *flipped,
+                URNG &rng) const {
+      if (_prob <= 0.0f) return;
+      // above 0.05 random masks are cheaper than geometric skips
+      if (_prob > 0.05f) {
+        // high mutation probability, flip 64 gens at once
+        word_type *words = dest.words();
+        const size_t n = dest.numWords();
+        for (size_t i=0; i<n; ++i) {
+          word_type mask = _sampler(rng);
+          if (i == n-1u) mask &= kernels::last_word_mask(dest.size());
+          words[i] ^= mask;
+          if (flipped) kernels::append_positions(mask, i * WORD_BITS, *flipped);
         }
       }
-      else { // _prob <= 0.2f
-        // low mutation probability, draw from a binomial
-        
-        // This set avoids possible repeated mutation candidates
-        std::unordered_set<size_t> positions;
-        // Sample the number of bits to mutate from this distribution
-        std::binomial_distribution<size_t> bdist(source.size(), _prob);
-        size_t n_gens_to_mutate = bdist(_rng);
-        if (n_gens_to_mutate > 0uL) {
-          // Sample which bit should be mutated from next distribution
-          std::uniform_int_distribution<size_t> dist(0uL, source.size() - 1);
-          size_t n_mutations = 0uL;
-          while(n_mutations < n_gens_to_mutate) {
-            size_t pos = dist(_rng);
-            if (positions.find(pos) == positions.end()) {
-              dest.flip(pos);
-              positions.insert(pos);
-              ++n_mutations;
-            }
-          }
+      else { // _prob <= 0.05f
+        // low mutation probability, skip the gens which don't mutate
+        const size_t N = dest.size();
+        std::geometric_distribution<size_t> geo_dist(_geo_dist.param());
+        size_t pos = geo_dist(rng);
+        while (pos < N) {
+          dest.flip(pos);
+          if (flipped) flipped->push_back(pos);
+          const size_t gap = geo_dist(rng);
+          if (gap >= N - pos) break; // avoids overflow for huge gaps
+          pos += gap + 1u;
         }
       }
-      return Chromosome(std::move(dest));
+    }
+  }; // class BasicRandomMutate
+
+  typedef BasicRandomMutate<> RandomMutate;
+
+  /**
+   * This class functor swaps the values of random positions of a
+   * Permutation
+   *
+   * Every position is chosen with the given probability and swapped
+   * with a uniformly random position, the gap between chosen
+   * positions being drawn from a geometric distribution, so the cost
+   * is proportional to the number of swaps.
+   *
+   * ATTENTION: no thread safe object, it should be created for each
+   * thread in your program, or used through the overload which
+   * receives a random generator.
+   */
+  template<typename RNG = std::mt19937_64>
+  class BasicSwapMutate {
+  public:
+    BasicSwapMutate(unsigned seed, float prob) :
+      _rng(seed),
+      _geo_dist(std::min(std::max(prob, 1e-12f), 1.0f)),
+      _prob(prob) {
+    }
+
+    /// Restarts the random generator with the given seed
+    void seed(unsigned seed) {
+      _rng.seed(seed);
+    }
+
+    /// Writes the state of the random generator, see save_state()
+    void saveState(std::ostream &os) const {
+      os << _rng << ' ';
+    }
+
+    /// Restores a state written by saveState()
+    void loadState(std::istream &is) const {
+      is >> _rng;
+    }
+
+    Permutation operator()(const Permutation &source) const {
+      Permutation dest(source);
+      mutate(dest, _rng);
+      return dest;
+    }
+
+    /**
+     * Writes the mutation of source into dest, reusing its memory
+     *
+     * source and dest can be the same object, mutating it in place.
+     */
+    void operator()(const Permutation &source, Permutation &dest) const {
+      if (&source != &dest) dest = source;
+      mutate(dest, _rng);
+    }
+
+    /**
+     * As the previous one, drawing random numbers from rng
+     *
+     * The functor state is not modified, so this overload can be
+     * called concurrently with different generators.
+     */
+    template<typename URNG>
+    void operator()(const Permutation &source, Permutation &dest,
+                    URNG &rng) const {
+      if (&source != &dest) dest = source;
+      mutate(dest, rng);
     }
 
   private:
-    mutable std::mt19937_64 _rng;
-    mutable std::uniform_real_distribution<float> _real_dist;
+    mutable RNG _rng;
+    std::geometric_distribution<size_t> _geo_dist;
     float _prob;
-  }; // class RandomMutate
+
+    template<typename URNG>
+    void mutate(Permutation &dest, URNG &rng) const {
+      const size_t N = dest.size();
+      if (_prob <= 0.0f || N < 2u) return;
+      std::geometric_distribution<size_t> geo_dist(_geo_dist.param());
+      std::uniform_int_distribution<size_t> other(0u, N - 1u);
+      size_t pos = geo_dist(rng);
+      while (pos < N) {
+        dest.swap(pos, other(rng));
+        const size_t gap = geo_dist(rng);
+        if (gap >= N - pos) break; // avoids overflow for huge gaps
+        pos += gap + 1u;
+      }
+    }
+  }; // class BasicSwapMutate
+
+  typedef BasicSwapMutate<> SwapMutate;
+
+  /**
+   * This class functor reverses a random segment of a Permutation
+   * with the given probability
+   *
+   * For routing problems it replaces two edges of the tour, as the
+   * 2-opt move does.
+   *
+   * ATTENTION: no thread safe object, it should be created for each
+   * thread in your program, or used through the overload which
+   * receives a random generator.
+   */
+  template<typename RNG = std::mt19937_64>
+  class BasicInversionMutate {
+  public:
+    BasicInversionMutate(unsigned seed, float prob) :
+      _rng(seed),
+      _prob(prob) {
+    }
+
+    /// Restarts the random generator with the given seed
+    void seed(unsigned seed) {
+      _rng.seed(seed);
+    }
+
+    /// Writes the state of the random generator, see save_state()
+    void saveState(std::ostream &os) const {
+      os << _rng << ' ';
+    }
+
+    /// Restores a state written by saveState()
+    void loadState(std::istream &is) const {
+      is >> _rng;
+    }
+
+    Permutation operator()(const Permutation &source) const {
+      Permutation dest(source);
+      mutate(dest, _rng);
+      return dest;
+    }
+
+    /**
+     * Writes the mutation of source into dest, reusing its memory
+     *
+     * source and dest can be the same object, mutating it in place.
+     */
+    void operator()(const Permutation &source, Permutation &dest) const {
+      if (&source != &dest) dest = source;
+      mutate(dest, _rng);
+    }
+
+    /**
+     * As the previous one, drawing random numbers from rng
+     *
+     * The functor state is not modified, so this overload can be
+     * called concurrently with different generators.
+     */
+    template<typename URNG>
+    void operator()(const Permutation &source, Permutation &dest,
+                    URNG &rng) const {
+      if (&source != &dest) dest = source;
+      mutate(dest, rng);
+    }
+
+  private:
+    mutable RNG _rng;
+    float _prob;
+
+    template<typename URNG>
+    void mutate(Permutation &dest, URNG &rng) const {
+      const size_t N = dest.size();
+      if (N < 2u) return;
+      std::uniform_real_distribution<float> real_dist(0.0f, 1.0f);
+      if (!(real_dist(rng) < _prob)) return;
+      size_t first, last;
+      detail::draw_segment(N, rng, first, last);
+      std::reverse(dest.data() + first, dest.data() + last + 1u);
+    }
+  }; // class BasicInversionMutate
+
+  typedef BasicInversionMutate<> InversionMutate;
+
+  /**
+   * This class functor applies the polynomial mutation of Deb to the
+   * values of a real vector
+   *
+   * Every value is mutated with the given probability by a step of
+   * polynomial distribution with index eta, scaled by upper - lower,
+   * and clamped to [lower,upper] (see kernels::polynomial_mutate()).
+   * Works with FloatVector and DoubleVector.
+   *
+   * ATTENTION: no thread safe object, it should be created for each
+   * thread in your program, or used through the overload which
+   * receives a random generator.
+   */
+  template<typename RNG = std::mt19937_64>
+  class BasicPolynomialMutate {
+  public:
+    BasicPolynomialMutate(unsigned seed, float prob, double eta,
+                          double lower, double upper) :
+      _rng(seed),
+      _prob(prob),
+      _eta(eta),
+      _lower(lower),
+      _upper(upper) {
+    }
+
+    /// Restarts the random generator with the given seed
+    void seed(unsigned seed) {
+      _rng.seed(seed);
+    }
+
+    /// Writes the state of the random generator, see save_state()
+    void saveState(std::ostream &os) const {
+      os << _rng << ' ';
+    }
+
+    /// Restores a state written by saveState()
+    void loadState(std::istream &is) const {
+      is >> _rng;
+    }
+
+    template<typename Genome>
+    Genome operator()(const Genome &source) const {
+      Genome dest(source);
+      (*this)(dest, dest, _rng);
+      return dest;
+    }
+
+    /**
+     * Writes the mutation of source into dest, reusing its memory
+     *
+     * source and dest can be the same object, mutating it in place.
+     */
+    template<typename Genome>
+    void operator()(const Genome &source, Genome &dest) const {
+      (*this)(source, dest, _rng);
+    }
+
+    /**
+     * As the previous one, drawing random numbers from rng
+     *
+     * The functor state is not modified, so this overload can be
+     * called concurrently with different generators.
+     */
+    template<typename Genome, typename URNG>
+    void operator()(const Genome &source, Genome &dest, URNG &rng) const {
+      typedef typename Genome::value_type value_type;
+      if (&source != &dest) dest = source;
+      kernels::polynomial_mutate(dest.data(), dest.size(), _prob,
+                                 static_cast<value_type>(_eta),
+                                 static_cast<value_type>(_lower),
+                                 static_cast<value_type>(_upper), rng);
+    }
+
+  private:
+    mutable RNG _rng;
+    float _prob;
+    double _eta;
+    double _lower;
+    double _upper;
+  }; // class BasicPolynomialMutate
+
+  typedef BasicPolynomialMutate<> PolynomialMutate;
+
+  /**
+   * This class functor adds gaussian noise to the values of a real
+   * vector
+   *
+   * Every value is mutated with the given probability by adding a
+   * normal step of standard deviation sigma, and clamped to
+   * [lower,upper] (see kernels::gaussian_mutate()). Works with
+   * FloatVector and DoubleVector.
+   *
+   * ATTENTION: no thread safe object, it should be created for each
+   * thread in your program, or used through the overload which
+   * receives a random generator.
+   */
+  template<typename RNG = std::mt19937_64>
+  class BasicGaussianMutate {
+  public:
+    BasicGaussianMutate(unsigned seed, float prob, double sigma,
+                        double lower=-std::numeric_limits<double>::infinity(),
+                        double upper=std::numeric_limits<double>::infinity()) :
+      _rng(seed),
+      _prob(prob),
+      _sigma(sigma),
+      _lower(lower),
+      _upper(upper) {
+    }
+
+    /// Restarts the random generator with the given seed
+    void seed(unsigned seed) {
+      _rng.seed(seed);
+    }
+
+    /// Writes the state of the random generator, see save_state()
+    void saveState(std::ostream &os) const {
+      os << _rng << ' ';
+    }
+
+    /// Restores a state written by saveState()
+    void loadState(std::istream &is) const {
+      is >> _rng;
+    }
+
+    template<typename Genome>
+    Genome operator()(const Genome &source) const {
+      Genome dest(source);
+      (*this)(dest, dest, _rng);
+      return dest;
+    }
+
+    /**
+     * Writes the mutation of source into dest, reusing its memory
+     *
+     * source and dest can be the same object, mutating it in place.
+     */
+    template<typename Genome>
+    void operator()(const Genome &source, Genome &dest) const {
+      (*this)(source, dest, _rng);
+    }
+
+    /**
+     * As the previous one, drawing random numbers from rng
+     *
+     * The functor state is not modified, so this overload can be
+     * called concurrently with different generators.
+     */
+    template<typename Genome, typename URNG>
+    void operator()(const Genome &source, Genome &dest, URNG &rng) const {
+      typedef typename Genome::value_type value_type;
+      if (&source != &dest) dest = source;
+      kernels::gaussian_mutate(dest.data(), dest.size(), _prob,
+                               static_cast<value_type>(_sigma),
+                               static_cast<value_type>(_lower),
+                               static_cast<value_type>(_upper), rng);
+    }
+
+  private:
+    mutable RNG _rng;
+    float _prob;
+    double _sigma;
+    double _lower;
+    double _upper;
+  }; // class BasicGaussianMutate
+
+  typedef BasicGaussianMutate<> GaussianMutate;
   
 } // namespace GeneticAlgorithms
 #endif // TRANSFORMS_H
@@ -0,0 +1,839 @@
+/*
+ * This file is part of GeneticAlgorithms toolkit
+ *
+ * Copyright 2017, Francisco Zamora-Martinez
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef NSGA2_H
+#define NSGA2_H
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <random>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "chromosome.h"
+#include "genetic_solver.h"
+#include "operator_traits.h"
+#include "random.h"
+#include "thread_pool.h"
+
+namespace GeneticAlgorithms {
+
+  /**
+   * The value type and number of objectives of a multi-objective
+   * RankFunctor result, defined for std::array<T, M>
+   */
+  template<typename Objectives>
+  struct objectives_traits {
+  };
+
+  template<typename T, size_t M>
+  struct objectives_traits<std::array<T, M> > {
+    typedef T value_type;
+    static const size_t size = M;
+  };
+
+  namespace detail {
+
+    /// true when x Pareto dominates y, all objectives are maximized
+    template<typename T>
+    bool dominates(const T *x, const T *y, const size_t m) {
+      bool better = false;
+      for (size_t k=0; k<m; ++k) {
+        if (x[k] < y[k]) return false;
+        if (y[k] < x[k]) better = true;
+      }
+      return better;
+    }
+
+    /// lexicographic descending order of objective vectors, then index
+    template<typename T>
+    struct LexicographicGreater {
+      const T *objectives;
+      size_t m;
+
+      bool operator()(const uint32_t a, const uint32_t b) const {
+        const T *x = objectives + a * m, *y = objectives + b * m;
+        for (size_t k=0; k<m; ++k) {
+          if (x[k] != y[k]) return y[k] < x[k];
+        }
+        return a < b;
+      }
+    };
+
+    /// true when both objective vectors are equal
+    template<typename T>
+    bool same_objectives(const T *x, const T *y, const size_t m) {
+      for (size_t k=0; k<m; ++k) if (x[k] != y[k]) return false;
+      return true;
+    }
+
+  } // namespace detail
+
+  /**
+   * Fast non-dominated sorting of n objective vectors, all objectives
+   * being maximized
+   *
+   * Vectors are swept in lexicographic descending order, so a vector
+   * can only be dominated by the ones already visited, and each one is
+   * placed by binary search over the fronts built so far (the
+   * efficient non-dominated sort, ENS-BS). The check against a front
+   * depends on the number of objectives m:
+   *
+   * - m <= 2: the last member of the front decides, O(1), so the whole
+   *   sort is O(n log n).
+   * - m == 3: every front keeps the staircase of its members projected
+   *   over the last two objectives (their 2D maxima) in a std::map,
+   *   O(log n), as the sweep of Jensen's algorithm. The sort is
+   *   O(n log^2 n).
+   * - m > 3: members of the front are checked from the last one, the
+   *   sort is O(m n^2) in the worst case but much less in practice.
+   *
+   * Front 0 is the Pareto front. Equal vectors go to the same front.
+   * Memory is reused between calls. Objectives can't be NaN.
+   *
+   * ATTENTION: no thread safe object
+   *
+   * @code
+   * NonDominatedSorter<float> sorter;
+   * std::vector<uint32_t> front(n);
+   * size_t num_fronts = sorter(objectives.data(), n, 2u, front.data());
+   * @endcode
+   */
+  template<typename T=float>
+  class NonDominatedSorter {
+  public:
+    NonDominatedSorter() : _num_fronts(0u) {
+    }
+
+    /**
+     * Writes the front of every vector into front, objectives being
+     * n rows of m values, and returns the number of fronts
+     */
+    size_t operator()(const T *objectives, const size_t n, const size_t m,
+                      uint32_t *front) {
+      if (n == 0u) return 0u;
+      _order.resize(n);
+      for (size_t i=0; i<n; ++i) _order[i] = static_cast<uint32_t>(i);
+      std::sort(_order.begin(), _order.end(),
+                detail::LexicographicGreater<T>{objectives, m});
+      _num_fronts = 0u;
+      for (const uint32_t p : _order) {
+        // first front which doesn't dominate p
+        size_t lo = 0u, hi = _num_fronts;
+        while (lo < hi) {
+          const size_t mid = (lo + hi) / 2u;
+          if (dominatedBy(mid, objectives, m, p)) lo = mid + 1u;
+          else hi = mid;
+        }
+        if (lo == _num_fronts) openFront(m);
+        insert(lo, objectives, m, p);
+        front[p] = static_cast<uint32_t>(lo);
+      }
+      return _num_fronts;
+    }
+
+  private:
+    std::vector<uint32_t> _order;
+    size_t _num_fronts;
+    /// m <= 2, the last member of every front
+    std::vector<uint32_t> _last;
+    /// m == 3, staircases keyed by the second objective
+    std::vector<std::map<T, uint32_t> > _stairs;
+    /// m > 3, the members of every front
+    std::vector<std::vector<uint32_t> > _members;
+
+    void openFront(const size_t m) {
+      const size_t k = _num_fronts++;
+      if (m <= 2u) {
+        if (_last.size() < _num_fronts) _last.resize(_num_fronts);
+      }
+      else if (m == 3u) {
+        if (_stairs.size() < _num_fronts) _stairs.resize(_num_fronts);
+        _stairs[k].clear();
+      }
+      else {
+        if (_members.size() < _num_fronts) _members.resize(_num_fronts);
+        _members[k].clear();
+      }
+    }
+
+    bool dominatedBy(const size_t k, const T *objectives, const size_t m,
+                     const uint32_t p) const {
+      const T *y = objectives + p * m;
+      if (m <= 2u) {
+        // visited first, so x[0] >= y[0], and x has the front's best x[m-1]
+        const T *x = objectives + _last[k] * m;
+        const size_t l = m - 1u;
+        return y[l] < x[l] || (x[l] == y[l] && y[0] < x[0]);
+      }
+      if (m == 3u) {
+        const std::map<T, uint32_t> &stairs = _stairs[k];
+        typename std::map<T, uint32_t>::const_iterator it = stairs.lower_bound(y[1]);
+        if (it == stairs.end()) return false;
+        const T *x = objectives + it->second * m;
+        if (x[2] < y[2]) return false;
+        // the same projection is a domination unless it is the same vector
+        return !detail::same_objectives(x, y, m);
+      }
+      const std::vector<uint32_t> &members = _members[k];
+      for (size_t j=members.size(); j>0u; --j) {
+        if (detail::dominates(objectives + members[j-1u] * m, y, m)) return true;
+      }
+      return false;
+    }
+
+    void insert(const size_t k, const T *objectives, const size_t m,
+                const uint32_t p) {
+      if (m <= 2u) {
+        _last[k] = p;
+      }
+      else if (m == 3u) {
+        const T *y = objectives + p * m;
+        std::map<T, uint32_t> &stairs = _stairs[k];
+        typename std::map<T, uint32_t>::iterator it = stairs.lower_bound(y[1]);
+        if (it != stairs.end() && it->first == y[1]) {
+          // an equal vector is already there
+          if (objectives[it->second * m + 2u] == y[2]) return;
+          it = stairs.erase(it);
+        }
+        // previous steps with f2 < y[1] and f3 <= y[2] are covered by p
+        while (it != stairs.begin()) {
+          typename std::map<T, uint32_t>::iterator prev = it;
+          --prev;
+          if (y[2] < objectives[prev->second * m + 2u]) break;
+          stairs.erase(prev);
+        }
+        stairs.insert(it, std::make_pair(y[1], p));
+      }
+      else {
+        _members[k].push_back(p);
+      }
+    }
+  }; // class NonDominatedSorter
+
+  /**
+   * Crowding distance of NSGA-II, the sum over objectives of the
+   * normalized distance between the neighbours of every vector in
+   * its front
+   *
+   * Boundary vectors of every front get an infinite distance. Every
+   * couple of front and objective is sorted as an independent task
+   * over the ThreadPool, and the contributions are added in a second
+   * parallel loop in a fixed order, so results don't depend on the
+   * number of threads. Memory is reused between calls.
+   *
+   * ATTENTION: no thread safe object
+   */
+  template<typename T=float>
+  class CrowdingDistance {
+  public:
+    /**
+     * Writes into distance the crowding distance of n objective
+     * vectors of m values, grouped in num_fronts fronts as written by
+     * NonDominatedSorter
+     */
+    void operator()(const T *objectives, const size_t n, const size_t m,
+                    const uint32_t *front, const size_t num_fronts,
+                    double *distance, ThreadPool &pool) {
+      if (n == 0u) return;
+      // members grouped by front, in index order
+      _start.assign(num_fronts + 1u, 0u);
+      for (size_t i=0; i<n; ++i) ++_start[front[i] + 1u];
+      for (size_t f=0; f<num_fronts; ++f) _start[f + 1u] += _start[f];
+      _members.resize(n);
+      _fill.assign(_start.begin(), _start.end() - 1);
+      for (size_t i=0; i<n; ++i) {
+        _members[_fill[front[i]]++] = static_cast<uint32_t>(i);
+      }
+      _sorted.resize(m * n);
+      _contrib.resize(m * n);
+      const uint32_t *start = _start.data();
+      const uint32_t *members = _members.data();
+      uint32_t *sorted = _sorted.data();
+      double *contrib = _contrib.data();
+      pool.parallelFor(num_fronts * m, [=](size_t t) {
+          const size_t f = t / m, k = t % m;
+          const size_t first = start[f], count = start[f + 1u] - first;
+          uint32_t *s = sorted + k * n + first;
+          double *c = contrib + k * n;
+          std::copy(members + first, members + first + count, s);
+          std::sort(s, s + count, [=](uint32_t a, uint32_t b) {
+              const T x = objectives[a * m + k], y = objectives[b * m + k];
+              return x < y || (x == y && a < b);
+            });
+          const double inf = std::numeric_limits<double>::infinity();
+          c[s[0]] = inf;
+          c[s[count - 1u]] = inf;
+          if (count <= 2u) return;
+          const double range =
+            static_cast<double>(objectives[s[count - 1u] * m + k]) -
+            static_cast<double>(objectives[s[0] * m + k]);
+          for (size_t j=1u; j+1u<count; ++j) {
+            c[s[j]] = (range > 0.0) ?
+              (static_cast<double>(objectives[s[j + 1u] * m + k]) -
+               static_cast<double>(objectives[s[j - 1u] * m + k])) / range : 0.0;
+          }
+        });
+      pool.parallelFor(n, [=](size_t i) {
+          double sum = 0.0;
+          for (size_t k=0; k<m; ++k) sum += contrib[k * n + i];
+          distance[i] = sum;
+        });
+    }
+
+  private:
+    std::vector<uint32_t> _start;
+    std::vector<uint32_t> _fill;
+    std::vector<uint32_t> _members;
+    /// members sorted by every objective, m blocks of n
+    std::vector<uint32_t> _sorted;
+    /// distance contributed by every objective, m blocks of n
+    std::vector<double> _contrib;
+  }; // class CrowdingDistance
+
+  /**
+   * The non-dominated solutions found during a multi-objective search
+   *
+   * merge() adds a batch of candidates and keeps the Pareto front of
+   * the union by means of NonDominatedSorter, so a batch costs
+   * O(k log k) instead of comparing every candidate with every
+   * member. Candidates with the objectives of a member are dropped.
+   * With a capacity, the members of largest crowding distance are
+   * kept when the front grows beyond it.
+   *
+   * ATTENTION: no thread safe object
+   */
+  template<typename Genome=Chromosome, typename T=float>
+  class ParetoArchive {
+  public:
+    /// capacity zero means unbounded
+    explicit ParetoArchive(const size_t num_objectives=1u,
+                           const size_t capacity=0u) :
+      _m(num_objectives), _capacity(capacity) {
+    }
+
+    size_t size() const {
+      return _genomes.size();
+    }
+
+    size_t numObjectives() const {
+      return _m;
+    }
+
+    size_t capacity() const {
+      return _capacity;
+    }
+
+    const Genome &genome(const size_t i) const {
+      return _genomes[i];
+    }
+
+    const std::vector<Genome> &genomes() const {
+      return _genomes;
+    }
+
+    /// the numObjectives() objectives of member i
+    const T *objectives(const size_t i) const {
+      return _objectives.data() + i * _m;
+    }
+
+    void clear() {
+      _genomes.clear();
+      _objectives.clear();
+    }
+
+    /**
+     * Merges count candidates, objectives being count rows of
+     * numObjectives() values
+     */
+    void merge(const Genome *genomes, const T *objectives, const size_t count,
+               ThreadPool &pool) {
+      const size_t size = _genomes.size(), total = size + count;
+      _all.resize(total * _m);
+      std::copy(_objectives.begin(), _objectives.end(), _all.begin());
+      std::copy(objectives, objectives + count * _m, _all.begin() + size * _m);
+      _front.resize(total);
+      _sorter(_all.data(), total, _m, _front.data());
+      // the Pareto front, members before candidates on ties
+      _keep.clear();
+      for (size_t i=0; i<total; ++i) {
+        if (_front[i] == 0u) _keep.push_back(static_cast<uint32_t>(i));
+      }
+      std::sort(_keep.begin(), _keep.end(),
+                detail::LexicographicGreater<T>{_all.data(), _m});
+      _keep.erase(std::unique(_keep.begin(), _keep.end(),
+                              [this](uint32_t a, uint32_t b) {
+                                return detail::same_objectives(_all.data() + a * _m,
+                                                               _all.data() + b * _m, _m);
+                              }), _keep.end());
+      std::sort(_keep.begin(), _keep.end());
+      if (_capacity > 0u && _keep.size() > _capacity) truncate(pool);
+      // members are moved, accepted candidates copied
+      _next_genomes.clear();
+      _next_genomes.reserve(_keep.size());
+      _objectives.resize(_keep.size() * _m);
+      for (size_t j=0; j<_keep.size(); ++j) {
+        const size_t i = _keep[j];
+        if (i < size) _next_genomes.push_back(std::move(_genomes[i]));
+        else _next_genomes.push_back(genomes[i - size]);
+        std::copy(_all.begin() + i * _m, _all.begin() + (i + 1u) * _m,
+                  _objectives.begin() + j * _m);
+      }
+      _genomes.swap(_next_genomes);
+    }
+
+    /// As the previous one, in the calling thread
+    void merge(const Genome *genomes, const T *objectives, const size_t count) {
+      ThreadPool pool(1u);
+      merge(genomes, objectives, count, pool);
+    }
+
+  private:
+    size_t _m;
+    size_t _capacity;
+    std::vector<Genome> _genomes;
+    std::vector<T> _objectives;
+    // buffers of merge()
+    std::vector<Genome> _next_genomes;
+    std::vector<T> _all;
+    std::vector<uint32_t> _front;
+    std::vector<uint32_t> _keep;
+    std::vector<T> _kept;
+    std::vector<double> _distance;
+    std::vector<uint32_t> _order;
+    NonDominatedSorter<T> _sorter;
+    CrowdingDistance<T> _crowding;
+
+    /// keeps the _capacity entries of _keep with largest crowding distance
+    void truncate(ThreadPool &pool) {
+      const size_t k = _keep.size();
+      _kept.resize(k * _m);
+      for (size_t j=0; j<k; ++j) {
+        std::copy(_all.begin() + _keep[j] * _m, _all.begin() + (_keep[j] + 1u) * _m,
+                  _kept.begin() + j * _m);
+      }
+      _front.assign(k, 0u);
+      _distance.resize(k);
+      _crowding(_kept.data(), k, _m, _front.data(), 1u, _distance.data(), pool);
+      _order.resize(k);
+      for (size_t j=0; j<k; ++j) _order[j] = static_cast<uint32_t>(j);
+      const double *distance = _distance.data();
+      std::nth_element(_order.begin(), _order.begin() + _capacity, _order.end(),
+                       [distance](uint32_t a, uint32_t b) {
+                         return distance[b] < distance[a] ||
+                           (distance[a] == distance[b] && a < b);
+                       });
+      _order.resize(_capacity);
+      std::sort(_order.begin(), _order.end());
+      for (size_t j=0; j<_capacity; ++j) _order[j] = _keep[_order[j]];
+      _keep.swap(_order);
+    }
+
+  }; // class ParetoArchive
+
+  /// The outcome of a multi-objective search, as returned by evolve_nsga2()
+  template<typename Genome, typename T>
+  struct MultiObjectiveResult {
+    /// the non-dominated solutions found
+    ParetoArchive<Genome, T> archive;
+    /// number of generations produced, initial population excluded
+    size_t generations;
+    /// number of calls to RankFunctor
+    size_t evaluations;
+    /// wall clock time, in seconds
+    double seconds;
+    StopReason reason;
+
+    MultiObjectiveResult() :
+      generations(0u), evaluations(0u), seconds(0.0),
+      reason(MAX_GENERATIONS) {
+    }
+  };
+
+  /**
+   * The NSGA-II multi-objective genetic algorithm, one generation at
+   * a time
+   *
+   * RankFunctor returns a std::array<T, M> with M objectives, all of
+   * them maximized as ranks are. Every generation produces
+   * population_size children from parents chosen by crowded
+   * tournaments (lower front first, then larger crowding distance),
+   * ranks them over the ThreadPool, sorts parents and children with
+   * NonDominatedSorter and keeps the best population_size by front
+   * and crowding distance. Children are merged into a ParetoArchive.
+   *
+   * From SolverOptions, max_stall_generations and target_rank don't
+   * apply, and cache_capacity and checkpoint_path are not supported.
+   * With parallel_offspring and operators which accept a random
+   * generator, selection, cross over and mutation of every child run
+   * in parallel over the Philox4x32 stream of its generation and
+   * position, as GeneticSolver does.
+   *
+   * Operators are kept by reference, so they should outlive the
+   * solver.
+   *
+   * @code
+   * NSGA2Solver<I, C, M, R> solver(options, i, c, m, r);
+   * solver.init();
+   * while (solver.generation() < options.num_iterations) solver.step();
+   * @endcode
+   */
+  template<typename InitializerFunctor,
+           typename CrossOverFunctor,
+           typename MutationFunctor,
+           typename RankFunctor>
+  class NSGA2Solver {
+  public:
+    typedef typename genome_of<InitializerFunctor>::type Genome;
+    typedef typename std::decay<
+      decltype(std::declval<const RankFunctor&>()(std::declval<const Genome&>()))
+      >::type objectives_type;
+    typedef typename objectives_traits<objectives_type>::value_type T;
+    static const size_t M = objectives_traits<objectives_type>::size;
+
+    /// archive_capacity zero means an unbounded archive
+    NSGA2Solver(const SolverOptions &options,
+                const InitializerFunctor &init_func,
+                const CrossOverFunctor &cross_over_func,
+                const MutationFunctor &mutate_func,
+                const RankFunctor &rank_func,
+                const size_t archive_capacity=0u,
+                const size_t tournament_size=2u) :
+      _options(options),
+      _init_func(init_func),
+      _cross_over_func(cross_over_func),
+      _mutate_func(mutate_func),
+      _rank_func(rank_func),
+      _tournament_size(std::max<size_t>(1u, tournament_size)),
+      _pool(options.num_threads),
+      _archive(M, archive_capacity),
+      _rng(options.seed),
+      _size(0u),
+      _num_fronts(0u),
+      _generation(0u),
+      _evaluations(0u) {
+    }
+
+    /// Generates, ranks and sorts the initial population
+    void init() {
+      _start = std::chrono::steady_clock::now();
+      _size = _options.population_size;
+      _genomes.clear();
+      _genomes.reserve(2u * _size);
+      for (size_t i=0; i<_size; ++i) _genomes.push_back(_init_func());
+      // children slots, written in place by the operators
+      for (size_t i=0; i<_size; ++i) _genomes.push_back(_genomes[i]);
+      _next = _genomes;
+      _objectives.resize(2u * _size * M);
+      _next_objectives.resize(2u * _size * M);
+      _front.resize(2u * _size);
+      _distance.resize(2u * _size);
+      _next_front.resize(_size);
+      _next_distance.resize(_size);
+      rankRange(0u, _size);
+      _num_fronts = _sorter(_objectives.data(), _size, M, _front.data());
+      _crowding(_objectives.data(), _size, M, _front.data(), _num_fronts,
+                _distance.data(), _pool);
+      _archive.clear();
+      _archive.merge(_genomes.data(), _objectives.data(), _size, _pool);
+      _generation = 0u;
+      _evaluations = _size;
+    }
+
+    /// Runs init() and step() until a stopping criterion is met
+    MultiObjectiveResult<Genome, T> run() {
+      MultiObjectiveResult<Genome, T> result;
+      init();
+      while (!stopped(result.reason)) step();
+      result.archive = _archive;
+      result.generations = _generation;
+      result.evaluations = _evaluations;
+      result.seconds = detail::seconds_since(_start);
+      return result;
+    }
+
+    /// Checks the stopping criteria, writing the reason when true
+    bool stopped(StopReason &reason) const {
+      return detail::check_stop(_options, _generation, _generation,
+                                -std::numeric_limits<double>::infinity(),
+                                _evaluations, _start, reason);
+    }
+
+    /// Produces, ranks and selects the next generation
+    void step() {
+      if (_options.parallel_offspring) produceParallel(parallel_t());
+      else produceSequential();
+      rankRange(_size, 2u * _size);
+      _evaluations += _size;
+      const size_t n = 2u * _size;
+      const size_t num_fronts = _sorter(_objectives.data(), n, M, _front.data());
+      _crowding(_objectives.data(), n, M, _front.data(), num_fronts,
+                _distance.data(), _pool);
+      _archive.merge(_genomes.data() + _size, _objectives.data() + _size * M,
+                     _size, _pool);
+      selectSurvivors(num_fronts);
+      ++_generation;
+      if (_options.verbosity > 1) {
+        std::cerr << "# generation " << _generation
+                  << " fronts " << _num_fronts
+                  << " archive " << _archive.size() << std::endl;
+      }
+    }
+
+    size_t generation() const {
+      return _generation;
+    }
+
+    size_t evaluations() const {
+      return _evaluations;
+    }
+
+    /// number of individuals of the current population
+    size_t size() const {
+      return _size;
+    }
+
+    const Genome &genome(const size_t i) const {
+      return _genomes[i];
+    }
+
+    /// the M objectives of individual i
+    const T *objectives(const size_t i) const {
+      return _objectives.data() + i * M;
+    }
+
+    /// front of individual i, 0 is the non-dominated one
+    size_t front(const size_t i) const {
+      return _front[i];
+    }
+
+    double crowdingDistance(const size_t i) const {
+      return _distance[i];
+    }
+
+    /// number of fronts of the current population
+    size_t numFronts() const {
+      return _num_fronts;
+    }
+
+    const ParetoArchive<Genome, T> &archive() const {
+      return _archive;
+    }
+
+  private:
+    typedef std::integral_constant<bool,
+      crosses_with_rng<CrossOverFunctor, Genome, Philox4x32>::value &&
+      mutates_with_rng<MutationFunctor, Genome, Philox4x32>::value> parallel_t;
+
+    const SolverOptions _options;
+    const InitializerFunctor &_init_func;
+    const CrossOverFunctor &_cross_over_func;
+    const MutationFunctor &_mutate_func;
+    const RankFunctor &_rank_func;
+    const size_t _tournament_size;
+    ThreadPool _pool;
+    ParetoArchive<Genome, T> _archive;
+    NonDominatedSorter<T> _sorter;
+    CrowdingDistance<T> _crowding;
+    std::mt19937_64 _rng;
+    /// parents at [0,_size) and their children at [_size,2*_size)
+    std::vector<Genome> _genomes;
+    std::vector<T> _objectives;
+    std::vector<uint32_t> _front;
+    std::vector<double> _distance;
+    // survivors are written here and swapped
+    std::vector<Genome> _next;
+    std::vector<T> _next_objectives;
+    std::vector<uint32_t> _next_front;
+    std::vector<double> _next_distance;
+    std::vector<uint32_t> _survivors;
+    size_t _size;
+    size_t _num_fronts;
+    size_t _generation;
+    size_t _evaluations;
+    std::chrono::steady_clock::time_point _start;
+
+    /// true when parent a wins the crowded comparison against b
+    bool crowdedBetter(const size_t a, const size_t b) const {
+      return _front[a] < _front[b] ||
+        (_front[a] == _front[b] && _distance[b] < _distance[a]);
+    }
+
+    template<typename URNG>
+    size_t tournament(URNG &rng) const {
+      std::uniform_int_distribution<size_t> subject(0u, _size - 1u);
+      size_t winner = subject(rng);
+      for (size_t j=1u; j<_tournament_size; ++j) {
+        const size_t i = subject(rng);
+        if (crowdedBetter(i, winner)) winner = i;
+      }
+      return winner;
+    }
+
+    void produceSequential() {
+      for (size_t j=0; j<_size; ++j) {
+        const size_t a = tournament(_rng);
+        const size_t b = tournament(_rng);
+        Genome &child = _genomes[_size + j];
+        cross_over_into(_cross_over_func, _genomes[a], _genomes[b], child);
+        mutate_in_place(_mutate_func, child);
+      }
+    }
+
+    void produceParallel(std::false_type) {
+      produceSequential();
+    }
+
+    void produceParallel(std::true_type) {
+      const uint64_t seed = _options.seed;
+      const uint64_t generation = _generation;
+      const size_t size = _size;
+      _pool.parallelFor(size, [this, seed, generation, size](size_t j) {
+          Philox4x32 rng = make_stream<Philox4x32>(seed, stream_id(generation, j));
+          const size_t a = tournament(rng);
+          const size_t b = tournament(rng);
+          Genome &child = _genomes[size + j];
+          cross_over_into(_cross_over_func, _genomes[a], _genomes[b], child, rng);
+          mutate_in_place(_mutate_func, child, rng);
+        });
+    }
+
+    /// ranks individuals [first,last) over the pool
+    void rankRange(const size_t first, const size_t last) {
+      T *objectives = _objectives.data();
+      _pool.parallelFor(last - first, [this, first, objectives](size_t j) {
+          const objectives_type r = _rank_func(_genomes[first + j]);
+          std::copy(r.begin(), r.end(), objectives + (first + j) * M);
+        });
+    }
+
+    /// keeps the best _size of parents and children
+    void selectSurvivors(const size_t num_fronts) {
+      const size_t n = 2u * _size;
+      // whole fronts while they fit, by counting their sizes
+      _survivors.assign(num_fronts + 1u, 0u);
+      for (size_t i=0; i<n; ++i) ++_survivors[_front[i]];
+      size_t last = 0u, taken = 0u;
+      while (last < num_fronts && taken + _survivors[last] <= _size) {
+        taken += _survivors[last++];
+      }
+      std::vector<uint32_t> &order = _survivors;
+      order.clear();
+      for (size_t i=0; i<n; ++i) {
+        if (_front[i] < last) order.push_back(static_cast<uint32_t>(i));
+      }
+      if (taken < _size) {
+        // the first front which doesn't fit, by crowding distance
+        for (size_t i=0; i<n; ++i) {
+          if (_front[i] == last) order.push_back(static_cast<uint32_t>(i));
+        }
+        const double *distance = _distance.data();
+        std::nth_element(order.begin() + taken, order.begin() + _size,
+                         order.end(), [distance](uint32_t a, uint32_t b) {
+                           return distance[b] < distance[a] ||
+                             (distance[a] == distance[b] && a < b);
+                         });
+        order.resize(_size);
+      }
+      for (size_t j=0; j<_size; ++j) {
+        const size_t i = order[j];
+        _next[j] = _genomes[i];
+        std::copy(_objectives.begin() + i * M, _objectives.begin() + (i + 1u) * M,
+                  _next_objectives.begin() + j * M);
+        _next_front[j] = _front[i];
+        _next_distance[j] = _distance[i];
+      }
+      _genomes.swap(_next);
+      _objectives.swap(_next_objectives);
+      std::copy(_next_front.begin(), _next_front.end(), _front.begin());
+      std::copy(_next_distance.begin(), _next_distance.end(), _distance.begin());
+      _num_fronts = (taken < _size) ? last + 1u : last;
+    }
+  }; // class NSGA2Solver
+
+  template<typename I, typename C, typename U, typename R>
+  const size_t NSGA2Solver<I, C, U, R>::M;
+
+  /**
+   * Runs NSGA-II (see NSGA2Solver) and returns the Pareto archive
+   * with the statistics of the run
+   *
+   * @code
+   * struct Rank {
+   *   std::array<float, 3> operator()(const Chromosome &x) const {
+   *     return {{ -cost(x), -latency(x), -memory(x) }};
+   *   }
+   * };
+   * MultiObjectiveResult<Chromosome, float> result =
+   *   evolve_nsga2(options, init, cross, mutate, Rank(), 1000u);
+   * for (size_t i=0; i<result.archive.size(); ++i) ...
+   * @endcode
+   */
+  template<typename InitializerFunctor,
+           typename CrossOverFunctor,
+           typename MutationFunctor,
+           typename RankFunctor>
+  MultiObjectiveResult<typename NSGA2Solver<InitializerFunctor, CrossOverFunctor,
+                                            MutationFunctor, RankFunctor>::Genome,
+                       typename NSGA2Solver<InitializerFunctor, CrossOverFunctor,
+                                            MutationFunctor, RankFunctor>::T>
+  evolve_nsga2(const SolverOptions &options,
+               const InitializerFunctor &init_func,
+               const CrossOverFunctor &cross_over_func,
+               const MutationFunctor &mutate_func,
+               const RankFunctor &rank_func,
+               const size_t archive_capacity=0u) {
+    NSGA2Solver<InitializerFunctor, CrossOverFunctor,
+                MutationFunctor, RankFunctor> solver(options, init_func,
+                                                     cross_over_func,
+                                                     mutate_func, rank_func,
+                                                     archive_capacity);
+    MultiObjectiveResult<typename NSGA2Solver<InitializerFunctor, CrossOverFunctor,
+                                              MutationFunctor, RankFunctor>::Genome,
+                         typename NSGA2Solver<InitializerFunctor, CrossOverFunctor,
+                                              MutationFunctor, RankFunctor>::T>
+      result = solver.run();
+    if (options.verbosity > 0) {
+      std::cerr << "# generations " << result.generations
+                << " evaluations " << result.evaluations
+                << " seconds " << result.seconds
+                << " reason " << static_cast<int>(result.reason)
+                << " archive " << result.archive.size() << std::endl;
+    }
+    return result;
+  }
+
+} // namespace GeneticAlgorithms
+
+#endif // NSGA2_H
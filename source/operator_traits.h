@@ -0,0 +1,440 @@
+/*
+ * This file is part of GeneticAlgorithms toolkit
+ *
+ * Copyright 2017, Francisco Zamora-Martinez
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef OPERATOR_TRAITS_H
+#define OPERATOR_TRAITS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "chromosome.h"
+
+namespace GeneticAlgorithms {
+
+  /**
+   * Helpers which call genetic operators writing into a given genome
+   *
+   * Operators of this library provide overloads which write their
+   * result into an existing genome, reusing its memory:
+   *
+   * - CrossOverFunctor: `void operator()(const G &a, const G &b, G &dest)`
+   * - MutationFunctor: `void operator()(const G &source, G &dest)`,
+   *   where source and dest may be the same object.
+   *
+   * User functors don't need to implement them, these helpers detect
+   * at compilation time if the overloads exist, falling back to the
+   * functors returning a new genome.
+   */
+  namespace detail {
+
+    template<typename F, typename G>
+    auto cross_over_into(const F &f, const G &a, const G &b, G &dest, int) ->
+      decltype(f(a, b, dest), void()) {
+      f(a, b, dest);
+    }
+
+    template<typename F, typename G>
+    void cross_over_into(const F &f, const G &a, const G &b, G &dest, long) {
+      dest = f(a, b);
+    }
+
+    template<typename F, typename G>
+    auto mutate_into(const F &f, G &x, int) ->
+      decltype(f(static_cast<const G&>(x), x), void()) {
+      f(static_cast<const G&>(x), x);
+    }
+
+    template<typename F, typename G>
+    void mutate_into(const F &f, G &x, long) {
+      x = f(static_cast<const G&>(x));
+    }
+
+    template<typename F, typename G, typename URNG>
+    auto cross_over_into(const F &f, const G &a, const G &b, G &dest,
+                         URNG &rng, int) ->
+      decltype(f(a, b, dest, rng), void()) {
+      f(a, b, dest, rng);
+    }
+
+    template<typename F, typename G, typename URNG>
+    void cross_over_into(const F &f, const G &a, const G &b, G &dest,
+                         URNG &, long) {
+      cross_over_into(f, a, b, dest, 0);
+    }
+
+    template<typename F, typename G, typename URNG>
+    auto mutate_into(const F &f, G &x, URNG &rng, int) ->
+      decltype(f(static_cast<const G&>(x), x, rng), void()) {
+      f(static_cast<const G&>(x), x, rng);
+    }
+
+    template<typename F, typename G, typename URNG>
+    void mutate_into(const F &f, G &x, URNG &, long) {
+      mutate_into(f, x, 0);
+    }
+
+    template<typename R, typename G, typename T>
+    T rank_delta(const R &, const T parent_rank, const G &,
+                 const std::vector<size_t> &, std::false_type) {
+      // unreachable, RankFunctor has no rank_delta
+      return parent_rank;
+    }
+
+    template<typename R, typename G, typename T>
+    T rank_delta(const R &r, const T parent_rank, const G &parent,
+                 const std::vector<size_t> &flipped, std::true_type) {
+      return r.rank_delta(parent_rank, parent, flipped);
+    }
+
+    template<typename T, typename R, typename G>
+    auto rank_genome(const R &r, const G &x, int) ->
+      decltype(static_cast<T>(r(x))) {
+      return static_cast<T>(r(x));
+    }
+
+    template<typename T, typename R, typename G>
+    T rank_genome(const R &r, const G &x, long) {
+      T rank = T();
+      r.rank_batch(x.words(), x.numWords(), 1u, &rank);
+      return rank;
+    }
+
+    template<typename R, typename T>
+    void rank_batch(const R &, const word_type *, size_t, size_t, T *,
+                    std::false_type) {
+      // unreachable, RankFunctor has no rank_batch
+    }
+
+    template<typename R, typename T>
+    void rank_batch(const R &r, const word_type *words, size_t num_words,
+                    size_t count, T *ranks, std::true_type) {
+      r.rank_batch(words, num_words, count, ranks);
+    }
+
+    template<typename F>
+    auto reseed(F &f, unsigned seed, int) -> decltype(f.seed(seed), void()) {
+      f.seed(seed);
+    }
+
+    template<typename F>
+    void reseed(F &, unsigned, long) {
+    }
+
+    template<typename F>
+    auto save_state(const F &f, std::ostream &os, int) ->
+      decltype(f.saveState(os), void()) {
+      f.saveState(os);
+    }
+
+    template<typename F>
+    void save_state(const F &, std::ostream &, long) {
+    }
+
+    template<typename F>
+    auto load_state(const F &f, std::istream &is, int) ->
+      decltype(f.loadState(is), void()) {
+      f.loadState(is);
+    }
+
+    template<typename F>
+    void load_state(const F &, std::istream &, long) {
+    }
+
+  } // namespace detail
+
+  /**
+   * Derives a new seed from a seed and an index
+   *
+   * It uses the SplitMix64 mixing function, so close indices produce
+   * unrelated seeds.
+   */
+  inline unsigned derive_seed(const unsigned seed, const uint64_t index) {
+    uint64_t z = (uint64_t(seed) << 32) + index + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return static_cast<unsigned>(z ^ (z >> 31));
+  }
+
+  /**
+   * Restarts the random generator of a functor, if it has one
+   *
+   * It calls `f.seed(seed)` when this method exists, otherwise it
+   * does nothing. All random operators of this library have it.
+   */
+  template<typename Functor>
+  void reseed(Functor &f, const unsigned seed) {
+    detail::reseed(f, seed, 0);
+  }
+
+  /**
+   * Writes the state of the random generator of a functor, if it has
+   * one, as text
+   *
+   * It calls `f.saveState(os)` when this method exists, otherwise it
+   * does nothing. All random operators of this library have it, and
+   * the state is written as the engines of <random> do.
+   */
+  template<typename Functor>
+  void save_state(const Functor &f, std::ostream &os) {
+    detail::save_state(f, os, 0);
+  }
+
+  /**
+   * Restores a state written by save_state()
+   *
+   * It calls `f.loadState(is)` when this method exists. The random
+   * generators of the operators are mutable, as they are advanced by
+   * their const operator(), so a const functor can be restored.
+   */
+  template<typename Functor>
+  void load_state(const Functor &f, std::istream &is) {
+    detail::load_state(f, is, 0);
+  }
+
+  /**
+   * True when MutationFunctor reports the mutated positions
+   *
+   * It needs the overload `void operator()(const G &source, G &dest,
+   * std::vector<size_t> &flipped) const`.
+   */
+  template<typename MutationFunctor, typename Genome>
+  struct reports_flips {
+    template<typename F>
+    static auto test(int) ->
+      decltype(std::declval<const F&>()(std::declval<const Genome&>(),
+                                        std::declval<Genome&>(),
+                                        std::declval<std::vector<size_t>&>()),
+               std::true_type());
+    template<typename F>
+    static std::false_type test(...);
+    static const bool value = decltype(test<MutationFunctor>(0))::value;
+  };
+
+  /**
+   * True when CrossOverFunctor accepts an external random generator,
+   * `void operator()(const G &a, const G &b, G &dest, URNG &rng) const`
+   */
+  template<typename CrossOverFunctor, typename Genome, typename URNG>
+  struct crosses_with_rng {
+    template<typename F>
+    static auto test(int) ->
+      decltype(std::declval<const F&>()(std::declval<const Genome&>(),
+                                        std::declval<const Genome&>(),
+                                        std::declval<Genome&>(),
+                                        std::declval<URNG&>()),
+               std::true_type());
+    template<typename F>
+    static std::false_type test(...);
+    static const bool value = decltype(test<CrossOverFunctor>(0))::value;
+  };
+
+  /**
+   * True when MutationFunctor accepts an external random generator,
+   * `void operator()(const G &source, G &dest, URNG &rng) const`
+   */
+  template<typename MutationFunctor, typename Genome, typename URNG>
+  struct mutates_with_rng {
+    template<typename F>
+    static auto test(int) ->
+      decltype(std::declval<const F&>()(std::declval<const Genome&>(),
+                                        std::declval<Genome&>(),
+                                        std::declval<URNG&>()),
+               std::true_type());
+    template<typename F>
+    static std::false_type test(...);
+    static const bool value = decltype(test<MutationFunctor>(0))::value;
+  };
+
+  /**
+   * True when MutationFunctor reports the mutated positions drawing
+   * from an external random generator, `void operator()(const G
+   * &source, G &dest, std::vector<size_t> &flipped, URNG &rng) const`
+   */
+  template<typename MutationFunctor, typename Genome, typename URNG>
+  struct reports_flips_with_rng {
+    template<typename F>
+    static auto test(int) ->
+      decltype(std::declval<const F&>()(std::declval<const Genome&>(),
+                                        std::declval<Genome&>(),
+                                        std::declval<std::vector<size_t>&>(),
+                                        std::declval<URNG&>()),
+               std::true_type());
+    template<typename F>
+    static std::false_type test(...);
+    static const bool value = decltype(test<MutationFunctor>(0))::value;
+  };
+
+  /**
+   * True when InitializerFunctor accepts an external random
+   * generator, `G operator()(URNG &rng) const`
+   */
+  template<typename InitializerFunctor, typename URNG>
+  struct initializes_with_rng {
+    template<typename F>
+    static auto test(int) ->
+      decltype(std::declval<const F&>()(std::declval<URNG&>()),
+               std::true_type());
+    template<typename F>
+    static std::false_type test(...);
+    static const bool value = decltype(test<InitializerFunctor>(0))::value;
+  };
+
+  /**
+   * True when RankFunctor allows incremental ranking
+   *
+   * It needs a method `T rank_delta(T parent_rank, const G &parent,
+   * const std::vector<size_t> &flipped) const` which returns the rank
+   * of the Chromosome obtained by flipping the given positions of
+   * parent, whose rank is parent_rank. For additive fitness functions
+   * it costs O(flipped.size()) instead of O(N):
+   *
+   * @code
+   * struct MyRank {
+   *   float operator()(const Chromosome &x) const {
+   *     float r = 0.0f;
+   *     for (size_t i=0; i<x.size(); ++i) if (x[i]) r += w[i];
+   *     return r;
+   *   }
+   *   float rank_delta(float parent_rank, const Chromosome &parent,
+   *                    const std::vector<size_t> &flipped) const {
+   *     for (size_t i : flipped) parent_rank += parent[i] ? -w[i] : w[i];
+   *     return parent_rank;
+   *   }
+   *   std::vector<float> w;
+   * };
+   * @endcode
+   */
+  template<typename RankFunctor, typename Genome, typename T>
+  struct has_rank_delta {
+    template<typename F>
+    static auto test(int) ->
+      decltype(static_cast<T>(std::declval<const F&>().rank_delta(std::declval<T>(),
+                                                                  std::declval<const Genome&>(),
+                                                                  std::declval<const std::vector<size_t>&>())),
+               std::true_type());
+    template<typename F>
+    static std::false_type test(...);
+    static const bool value = decltype(test<RankFunctor>(0))::value;
+  };
+
+  /**
+   * True when RankFunctor ranks whole batches of Chromosomes
+   *
+   * It needs a method `void rank_batch(const word_type *words, size_t
+   * num_words, size_t count, T *ranks) const`, where words is a
+   * row-major matrix of count Chromosomes with num_words words each
+   * (the layout of Chromosome::words(), padding gens set to zero),
+   * and ranks receives count values. Population gathers the
+   * Chromosomes to rank into such a matrix, so fitness functions
+   * which are a product of the gens matrix by a vector can use SIMD
+   * kernels or a GPU.
+   *
+   * The functor may omit operator(), single Chromosomes are then
+   * ranked as batches of one element (see rank_genome()).
+   *
+   * @code
+   * struct Knapsack {
+   *   void rank_batch(const word_type *words, size_t num_words,
+   *                   size_t count, float *ranks) const {
+   *     for (size_t r=0; r<count; ++r, words+=num_words) {
+   *       float b = 0.0f;
+   *       for (size_t w=0; w<num_words; ++w)
+   *         for (word_type m=words[w]; m; m&=m-1u)
+   *           b += benefit[w*WORD_BITS + __builtin_ctzll(m)];
+   *       ranks[r] = b;
+   *     }
+   *   }
+   *   std::vector<float> benefit;
+   * };
+   * @endcode
+   */
+  template<typename RankFunctor, typename T>
+  struct has_batch_rank {
+    template<typename F>
+    static auto test(int) ->
+      decltype(std::declval<const F&>().rank_batch(std::declval<const word_type*>(),
+                                                   std::declval<size_t>(),
+                                                   std::declval<size_t>(),
+                                                   std::declval<T*>()),
+               std::true_type());
+    template<typename F>
+    static std::false_type test(...);
+    static const bool value = decltype(test<RankFunctor>(0))::value;
+  };
+
+  /**
+   * Ranks a single Chromosome, calling `f(x)` when RankFunctor has
+   * operator() and `f.rank_batch()` with one row otherwise
+   */
+  template<typename T, typename RankFunctor, typename Genome>
+  T rank_genome(const RankFunctor &f, const Genome &x) {
+    return detail::rank_genome<T>(f, x, 0);
+  }
+
+  /// Writes into dest the child of a and b produced by f
+  template<typename CrossOverFunctor, typename Genome>
+  void cross_over_into(const CrossOverFunctor &f,
+                       const Genome &a, const Genome &b, Genome &dest) {
+    detail::cross_over_into(f, a, b, dest, 0);
+  }
+
+  /// Mutates x in place by using f
+  template<typename MutationFunctor, typename Genome>
+  void mutate_in_place(const MutationFunctor &f, Genome &x) {
+    detail::mutate_into(f, x, 0);
+  }
+
+  /**
+   * As cross_over_into(), drawing random numbers from rng when f has
+   * the overload `void operator()(const G &a, const G &b, G &dest,
+   * URNG &rng) const`, which doesn't touch the internal generator of
+   * f and so can be called concurrently
+   */
+  template<typename CrossOverFunctor, typename Genome, typename URNG>
+  void cross_over_into(const CrossOverFunctor &f, const Genome &a,
+                       const Genome &b, Genome &dest, URNG &rng) {
+    detail::cross_over_into(f, a, b, dest, rng, 0);
+  }
+
+  /**
+   * As mutate_in_place(), drawing random numbers from rng when f has
+   * the overload `void operator()(const G &source, G &dest, URNG &rng)
+   * const`
+   */
+  template<typename MutationFunctor, typename Genome, typename URNG>
+  void mutate_in_place(const MutationFunctor &f, Genome &x, URNG &rng) {
+    detail::mutate_into(f, x, rng, 0);
+  }
+
+} // namespace GeneticAlgorithms
+
+#endif // OPERATOR_TRAITS_H
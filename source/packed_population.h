@@ -0,0 +1,802 @@
+/*
+ * This file is part of GeneticAlgorithms toolkit
+ *
+ * Copyright 2017, Francisco Zamora-Martinez
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef PACKED_POPULATION_H
+#define PACKED_POPULATION_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <vector>
+
+#include "bit_kernels.h"
+#include "chromosome.h"
+#include "fitness_cache.h"
+#include "genetic_solver.h"
+#include "indexed_heap.h"
+#include "operator_traits.h"
+#include "thread_pool.h"
+
+namespace GeneticAlgorithms {
+
+  namespace detail {
+
+    /**
+     * A growable array of words aligned to cache lines
+     *
+     * Growing keeps the content, as std::vector does, but the memory
+     * is never value-initialized.
+     */
+    class AlignedWords {
+    public:
+      static const size_t ALIGNMENT = 64u;
+
+      AlignedWords() : _data(0), _capacity(0u) {
+      }
+
+      ~AlignedWords() {
+        std::free(_data);
+      }
+
+      AlignedWords(const AlignedWords &) = delete;
+      AlignedWords &operator=(const AlignedWords &) = delete;
+
+      void swap(AlignedWords &other) {
+        std::swap(_data, other._data);
+        std::swap(_capacity, other._capacity);
+      }
+
+      /// Ensures room for n words, keeping the first used ones
+      void reserve(const size_t n, const size_t used) {
+        if (n <= _capacity) return;
+        void *p = 0;
+        if (posix_memalign(&p, ALIGNMENT, n * sizeof(word_type)) != 0) {
+          throw std::bad_alloc();
+        }
+        word_type *data = static_cast<word_type*>(p);
+        if (used > 0u) kernels::copy_words(data, _data, used);
+        std::free(_data);
+        _data = data;
+        _capacity = n;
+      }
+
+      word_type *data() { return _data; }
+      const word_type *data() const { return _data; }
+      size_t capacity() const { return _capacity; }
+
+    private:
+      word_type *_data;
+      size_t _capacity;
+    };
+
+  } // namespace detail
+
+  /**
+   * A population stored as one matrix of words
+   *
+   * Every Chromosome is a row of stride() words of a contiguous,
+   * cache line aligned matrix, and ranks are another array, so there
+   * is no per Chromosome header nor heap block and loops over the
+   * population walk memory linearly. All Chromosomes have num_gens
+   * gens.
+   *
+   * With deduplication, identical Chromosomes share one
+   * reference-counted row, found through an open addressing table of
+   * row hashes; a pushed Chromosome equal to a ranked row takes its
+   * rank without calling RankFunctor. Rows which reach zero
+   * references are reused by the next pushes.
+   *
+   * Chromosomes are pushed without rank and ranked together by
+   * rankPending(), in parallel. When RankFunctor implements
+   * rank_batch (see has_batch_rank), the rows are given to it straight
+   * from the matrix (gathered only when they aren't contiguous);
+   * otherwise every thread copies rows into a Genome.
+   *
+   * Genetic operators work on Genome objects, so genome() copies a
+   * row out of the matrix.
+   *
+   * @code
+   * PackedPopulation<MyRank> pop(MyRank(), N, true);
+   * for (size_t i=0; i<n; ++i) pop.push(init());
+   * pop.rankPending(pool);
+   * Chromosome x;
+   * pop.genome(pop.topIndex(), x);
+   * @endcode
+   */
+  template<typename RankFunctor, typename T = float,
+           typename Genome = Chromosome>
+  class PackedPopulation {
+  public:
+    /// true when RankFunctor implements rank_batch
+    static const bool BATCH_RANK = has_batch_rank<RankFunctor, T>::value;
+
+    /// index of a row, so a population holds less than 2^32 rows
+    typedef uint32_t row_type;
+
+    PackedPopulation(const RankFunctor &rank_func, const size_t num_gens,
+                     const bool deduplicate = false) :
+      _rank_func(rank_func),
+      _num_gens(num_gens),
+      _stride(num_words_for(num_gens)),
+      _deduplicate(deduplicate),
+      _num_rows(0u),
+      _used_rows(0u),
+      _table_size(0u),
+      _top(0u),
+      _best_built(false) {
+    }
+
+    /// Number of Chromosomes
+    size_t size() const {
+      return _rows.size();
+    }
+
+    size_t numGens() const {
+      return _num_gens;
+    }
+
+    /// Words of every row of the matrix
+    size_t stride() const {
+      return _stride;
+    }
+
+    bool deduplicates() const {
+      return _deduplicate;
+    }
+
+    /// Rows in use, equal to size() without deduplication
+    size_t uniqueRows() const {
+      return _used_rows;
+    }
+
+    /// Row of Chromosome i
+    row_type row(const size_t i) const {
+      return _rows[i];
+    }
+
+    /// Number of Chromosomes sharing row r
+    size_t refCount(const size_t r) const {
+      return _refs[r];
+    }
+
+    /// The words of Chromosome i
+    const word_type *words(const size_t i) const {
+      return _matrix.data() + _rows[i] * _stride;
+    }
+
+    /// returns the rank of Chromosome i, known after rankPending()
+    T rank(const size_t i) const {
+      return _ranks[i];
+    }
+
+    /// returns all ranks, in the same order as the Chromosomes
+    const std::vector<T> &ranks() const {
+      return _ranks;
+    }
+
+    /// returns the position of the best Chromosome, size() must be > 0
+    size_t topIndex() const {
+      return _top;
+    }
+
+    /// returns the position of the worst Chromosome, size() must be > 0
+    size_t bottomIndex() const {
+      return static_cast<size_t>(std::min_element(_ranks.begin(), _ranks.end()) -
+                                 _ranks.begin());
+    }
+
+    /// Copies Chromosome i into dest, reusing its memory
+    void genome(const size_t i, Genome &dest) const {
+      dest.resize(_num_gens);
+      kernels::copy_words(dest.words(), words(i), _stride);
+    }
+
+    Genome genome(const size_t i) const {
+      Genome dest(_num_gens);
+      genome(i, dest);
+      return dest;
+    }
+
+    /// Heap bytes held by the population
+    size_t memoryBytes() const {
+      return _matrix.capacity() * sizeof(word_type) +
+        _rows.capacity() * sizeof(row_type) + _ranks.capacity() * sizeof(T) +
+        _refs.capacity() * sizeof(row_type) + _row_ranks.capacity() * sizeof(T) +
+        _row_ranked.capacity() + _row_hashes.capacity() * sizeof(uint64_t) +
+        (_table.capacity() + _free_rows.capacity() + _pending.capacity()) *
+        sizeof(row_type);
+    }
+
+    /// Allocates memory for n Chromosomes with different gens
+    void reserve(const size_t n) {
+      _matrix.reserve(n * _stride, _num_rows * _stride);
+      _rows.reserve(n);
+      _ranks.reserve(n);
+      _refs.reserve(n);
+      _row_ranks.reserve(n);
+      _row_ranked.reserve(n);
+      if (_deduplicate) _row_hashes.reserve(n);
+    }
+
+    /// As clear(), changing the number of gens of the Chromosomes
+    void reset(const size_t num_gens) {
+      clear();
+      _num_gens = num_gens;
+      _stride = num_words_for(num_gens);
+    }
+
+    /// Removes all Chromosomes, memory is kept for the next pushes
+    void clear() {
+      _rows.clear();
+      _ranks.clear();
+      _num_rows = 0u;
+      _used_rows = 0u;
+      _free_rows.clear();
+      _pending.clear();
+      std::fill(_table.begin(), _table.end(), EMPTY);
+      _table_size = 0u;
+      _top = 0u;
+      _best_built = false;
+    }
+
+    /**
+     * Appends x, which is ranked by the next rankPending() unless it
+     * shares a row with an already ranked Chromosome
+     */
+    void push(const Genome &x) {
+      const row_type r = storeRow(x.words());
+      _rows.push_back(r);
+      _ranks.push_back(_row_ranked[r] ? _row_ranks[r] : T());
+      _best_built = false;
+      if (_row_ranked[r]) updateTop(_rows.size() - 1u);
+    }
+
+    /// Appends x with an already known rank
+    void push(const Genome &x, const T rank) {
+      const row_type r = storeRow(x.words());
+      setRowRank(r, rank);
+      _rows.push_back(r);
+      _ranks.push_back(rank);
+      _best_built = false;
+      updateTop(_rows.size() - 1u);
+    }
+
+    /**
+     * Replaces Chromosome i by x, which gets the given rank
+     *
+     * The top keeps i on ties, and when it gets worse the new one is
+     * taken from a max-heap of the ranks, built by the first
+     * replacement after any other change, so it is never searched.
+     */
+    void replace(const size_t i, const Genome &x, const T rank) {
+      releaseRow(_rows[i]);
+      const row_type r = storeRow(x.words());
+      setRowRank(r, rank);
+      _rows[i] = r;
+      const bool top = !(rank < _ranks[_top]);
+      _ranks[i] = rank;
+      if (_best_built) {
+        _best.update(i, rank);
+      }
+      else {
+        _best.build(_ranks.data(), _ranks.size());
+        _best_built = true;
+      }
+      if (top) _top = i;
+      else if (i == _top) _top = _best.top();
+    }
+
+    /**
+     * Ranks in parallel the rows pushed without rank, returning the
+     * number of ranked rows
+     */
+    size_t rankPending(ThreadPool &pool) {
+      const size_t n = _pending.size();
+      if (n > 0u) {
+        rankRows(pool, std::integral_constant<bool, BATCH_RANK>());
+        for (const row_type r : _pending) _row_ranked[r] = 1u;
+        _pending.clear();
+      }
+      _top = 0u;
+      _best_built = false;
+      for (size_t i=0; i<_rows.size(); ++i) {
+        _ranks[i] = _row_ranks[_rows[i]];
+        if (_ranks[_top] < _ranks[i]) _top = i;
+      }
+      return n;
+    }
+
+    /**
+     * Given a selection functor, fills result with couples of positions
+     *
+     * The number of couples is given by result.size(), and the
+     * SelectionFunctor only receives the ranks of the population.
+     */
+    template<typename SelectionFunctor>
+    void select(const SelectionFunctor &select_func,
+                std::vector<IndexCouple> &result) const {
+      select_func(_ranks, result);
+    }
+
+    void swap(PackedPopulation &other) {
+      std::swap(_num_gens, other._num_gens);
+      std::swap(_stride, other._stride);
+      std::swap(_deduplicate, other._deduplicate);
+      _matrix.swap(other._matrix);
+      std::swap(_num_rows, other._num_rows);
+      std::swap(_used_rows, other._used_rows);
+      _rows.swap(other._rows);
+      _ranks.swap(other._ranks);
+      _refs.swap(other._refs);
+      _row_ranks.swap(other._row_ranks);
+      _row_ranked.swap(other._row_ranked);
+      _row_hashes.swap(other._row_hashes);
+      _free_rows.swap(other._free_rows);
+      _pending.swap(other._pending);
+      _table.swap(other._table);
+      std::swap(_table_size, other._table_size);
+      std::swap(_top, other._top);
+      _best_built = other._best_built = false;
+    }
+
+  private:
+    /// empty slot of the row table
+    static const row_type EMPTY = ~row_type(0u);
+
+    RankFunctor _rank_func;
+    size_t _num_gens;
+    size_t _stride;
+    bool _deduplicate;
+    /// The matrix, rows [0,_num_rows) have been written
+    detail::AlignedWords _matrix;
+    size_t _num_rows;
+    /// rows with at least one reference
+    size_t _used_rows;
+    /// row of every Chromosome, and their ranks
+    std::vector<row_type> _rows;
+    std::vector<T> _ranks;
+    /// per row: references, rank, if it is ranked, and its hash
+    std::vector<row_type> _refs;
+    std::vector<T> _row_ranks;
+    std::vector<unsigned char> _row_ranked;
+    std::vector<uint64_t> _row_hashes;
+    /// rows without references, reused before growing the matrix
+    std::vector<row_type> _free_rows;
+    /// rows waiting for rankPending()
+    std::vector<row_type> _pending;
+    /// open addressing table of rows by hash, only with deduplication
+    std::vector<row_type> _table;
+    size_t _table_size;
+    size_t _top;
+    /// max-heap of _ranks for replace(), valid while _best_built
+    IndexedHeap<T, std::greater<T> > _best;
+    bool _best_built;
+    /// staging matrix and ranks for rank_batch of scattered rows
+    std::vector<word_type> _batch_words;
+    std::vector<T> _batch_ranks;
+
+    word_type *rowWords(const size_t r) {
+      return _matrix.data() + r * _stride;
+    }
+
+    const word_type *rowWords(const size_t r) const {
+      return _matrix.data() + r * _stride;
+    }
+
+    void updateTop(const size_t i) {
+      if (i == 0u || _ranks[_top] < _ranks[i]) _top = i;
+    }
+
+    void setRowRank(const row_type r, const T rank) {
+      if (!_row_ranked[r]) {
+        _row_ranks[r] = rank;
+        _row_ranked[r] = 1u;
+        dropPending(r);
+      }
+    }
+
+    /// the row is not pending any more, usually the last pushed one
+    void dropPending(const row_type r) {
+      if (!_pending.empty() && _pending.back() == r) {
+        _pending.pop_back();
+        return;
+      }
+      std::vector<row_type>::iterator it =
+        std::find(_pending.begin(), _pending.end(), r);
+      if (it != _pending.end()) _pending.erase(it);
+    }
+
+    /// returns the row with the given words, adding one reference
+    row_type storeRow(const word_type *words) {
+      uint64_t h = 0u;
+      if (_deduplicate) {
+        h = words_hash(words, _stride, _num_gens);
+        const row_type r = findRow(words, h);
+        if (r != EMPTY) {
+          ++_refs[r];
+          return r;
+        }
+      }
+      const row_type r = newRow();
+      kernels::copy_words(rowWords(r), words, _stride);
+      _refs[r] = 1u;
+      _row_ranked[r] = 0u;
+      _pending.push_back(r);
+      if (_deduplicate) {
+        _row_hashes[r] = h;
+        insertRow(r);
+      }
+      return r;
+    }
+
+    /// drops one reference of row r
+    void releaseRow(const row_type r) {
+      if (--_refs[r] > 0u) return;
+      if (_deduplicate) eraseRow(r);
+      if (!_row_ranked[r]) dropPending(r);
+      _free_rows.push_back(r);
+      --_used_rows;
+    }
+
+    row_type newRow() {
+      ++_used_rows;
+      if (!_free_rows.empty()) {
+        const row_type r = _free_rows.back();
+        _free_rows.pop_back();
+        return r;
+      }
+      const row_type r = static_cast<row_type>(_num_rows++);
+      if (_num_rows * _stride > _matrix.capacity()) {
+        _matrix.reserve(std::max(_num_rows * _stride, 2u * _matrix.capacity()),
+                        r * _stride);
+      }
+      if (_refs.size() < _num_rows) {
+        _refs.resize(_num_rows);
+        _row_ranks.resize(_num_rows);
+        _row_ranked.resize(_num_rows);
+        if (_deduplicate) _row_hashes.resize(_num_rows);
+      }
+      return r;
+    }
+
+    /// keeps the table load under one half
+    void growTable() {
+      if (2u * (_used_rows + 1u) <= _table.size()) return;
+      std::vector<row_type> old;
+      old.swap(_table);
+      _table.assign(std::max<size_t>(16u, 2u * old.size()), EMPTY);
+      _table_size = 0u;
+      for (const row_type r : old) {
+        if (r != EMPTY) placeRow(r);
+      }
+    }
+
+    void placeRow(const row_type r) {
+      const size_t mask = _table.size() - 1u;
+      size_t k = _row_hashes[r] & mask;
+      while (_table[k] != EMPTY) k = (k + 1u) & mask;
+      _table[k] = r;
+      ++_table_size;
+    }
+
+    void insertRow(const row_type r) {
+      growTable();
+      placeRow(r);
+    }
+
+    row_type findRow(const word_type *words, const uint64_t h) const {
+      if (_table.empty()) return EMPTY;
+      const size_t mask = _table.size() - 1u;
+      for (size_t k = h & mask; _table[k] != EMPTY; k = (k + 1u) & mask) {
+        const row_type r = _table[k];
+        if (_row_hashes[r] == h &&
+            std::memcmp(rowWords(r), words, _stride * sizeof(word_type)) == 0) {
+          return r;
+        }
+      }
+      return EMPTY;
+    }
+
+    /// removes row r from the table, shifting back its cluster
+    void eraseRow(const row_type r) {
+      const size_t mask = _table.size() - 1u;
+      size_t k = _row_hashes[r] & mask;
+      while (_table[k] != r) k = (k + 1u) & mask;
+      _table[k] = EMPTY;
+      --_table_size;
+      for (size_t j = (k + 1u) & mask; _table[j] != EMPTY; j = (j + 1u) & mask) {
+        const row_type s = _table[j];
+        const size_t home = _row_hashes[s] & mask;
+        // s may move to k when k is in the cyclic range [home, j)
+        if (((j - home) & mask) >= ((j - k) & mask)) {
+          _table[k] = s;
+          _table[j] = EMPTY;
+          k = j;
+        }
+      }
+    }
+
+    /// ranks _pending rows copying them into Genomes
+    void rankRows(ThreadPool &pool, std::false_type) {
+      const size_t n = _pending.size();
+      const size_t blocks = std::min(pool.size(), n);
+      const RankFunctor *rank_func = &_rank_func;
+      const word_type *matrix = _matrix.data();
+      const row_type *pending = _pending.data();
+      T *row_ranks = _row_ranks.data();
+      const size_t num_gens = _num_gens;
+      const size_t stride = _stride;
+      pool.parallelFor(blocks, [rank_func, matrix, pending, row_ranks,
+                                num_gens, stride, n, blocks](size_t b) {
+          Genome x(num_gens);
+          for (size_t j = n * b / blocks; j < n * (b + 1u) / blocks; ++j) {
+            kernels::copy_words(x.words(), matrix + pending[j] * stride, stride);
+            row_ranks[pending[j]] = rank_genome<T>(*rank_func, x);
+          }
+        });
+    }
+
+    /// ranks _pending rows with rank_batch, one call per thread
+    void rankRows(ThreadPool &pool, std::true_type) {
+      const size_t n = _pending.size();
+      const size_t first_row = _pending[0];
+      bool contiguous = true;
+      for (size_t j=1u; j<n && contiguous; ++j) {
+        contiguous = (_pending[j] == first_row + j);
+      }
+      const word_type *matrix = rowWords(first_row);
+      T *ranks = _row_ranks.data() + first_row;
+      if (!contiguous) {
+        _batch_words.resize(n * _stride);
+        _batch_ranks.resize(n);
+        for (size_t j=0; j<n; ++j) {
+          kernels::copy_words(_batch_words.data() + j * _stride,
+                              rowWords(_pending[j]), _stride);
+        }
+        matrix = _batch_words.data();
+        ranks = _batch_ranks.data();
+      }
+      const size_t blocks = std::min(pool.size(), n);
+      const RankFunctor *rank_func = &_rank_func;
+      const size_t stride = _stride;
+      pool.parallelFor(blocks, [rank_func, matrix, ranks, stride, n,
+                                blocks](size_t b) {
+          const size_t first = n * b / blocks;
+          const size_t last = n * (b + 1u) / blocks;
+          rank_func->rank_batch(matrix + first * stride, stride,
+                                last - first, ranks + first);
+        });
+      if (!contiguous) {
+        for (size_t j=0; j<n; ++j) _row_ranks[_pending[j]] = _batch_ranks[j];
+      }
+    }
+  }; // class PackedPopulation
+
+  template<typename RankFunctor, typename T, typename Genome>
+  const bool PackedPopulation<RankFunctor, T, Genome>::BATCH_RANK;
+
+  template<typename RankFunctor, typename T, typename Genome>
+  const typename PackedPopulation<RankFunctor, T, Genome>::row_type
+  PackedPopulation<RankFunctor, T, Genome>::EMPTY;
+
+  /**
+   * The generational algorithm of GeneticSolver over two
+   * PackedPopulation buffers
+   *
+   * Every generation the parents are copied out of the matrix, crossed
+   * and mutated sequentially into one reused child, which is packed
+   * into the next generation; then new rows are ranked in parallel
+   * and the best Chromosome passes directly (elitism). With
+   * deduplication, duplicated children are ranked once, and
+   * evaluations only count ranked rows.
+   *
+   * @code
+   * PackedGeneticSolver<float, I, S, C, M, R> solver(options, true,
+   *                                                  i, s, c, m, r);
+   * SolverResult<Chromosome, float> result = solver.run();
+   * @endcode
+   */
+  template<typename T,
+           typename InitializerFunctor,
+           typename SelectionFunctor,
+           typename CrossOverFunctor,
+           typename MutationFunctor,
+           typename RankFunctor>
+  class PackedGeneticSolver {
+  public:
+    typedef typename genome_of<InitializerFunctor>::type Genome;
+    typedef PackedPopulation<RankFunctor, T, Genome> population_t;
+    typedef std::pair<Genome, T> Hypothesis;
+
+    PackedGeneticSolver(const SolverOptions &options,
+                        const bool deduplicate,
+                        const InitializerFunctor &init_func,
+                        const SelectionFunctor &select_func,
+                        const CrossOverFunctor &cross_over_func,
+                        const MutationFunctor &mutate_func,
+                        const RankFunctor &rank_func) :
+      _options(options),
+      _init_func(init_func),
+      _select_func(select_func),
+      _cross_over_func(cross_over_func),
+      _mutate_func(mutate_func),
+      _pool(options.num_threads),
+      _population(rank_func, 0u, deduplicate),
+      _next(rank_func, 0u, deduplicate),
+      _generation(0u),
+      _last_improvement(0u),
+      _evaluations(0u) {
+    }
+
+    /**
+     * Generates and ranks the initial population, the number of gens
+     * is given by the first Chromosome
+     */
+    void init() {
+      for (size_t i=0; i<_options.population_size; ++i) {
+        const Genome x = _init_func();
+        if (i == 0u) {
+          _population.reset(x.size());
+          _next.reset(x.size());
+          _population.reserve(_options.population_size);
+          _next.reserve(_options.population_size);
+        }
+        _population.push(x);
+      }
+      _evaluations = _population.rankPending(_pool);
+      _best.first = _population.genome(_population.topIndex());
+      _best.second = _population.rank(_population.topIndex());
+      _generation = 0u;
+      _last_improvement = 0u;
+      _start = std::chrono::steady_clock::now();
+    }
+
+    /**
+     * Runs init() and step() until a stopping criterion of
+     * SolverOptions is met
+     */
+    SolverResult<Genome, T> run() {
+      SolverResult<Genome, T> result;
+      init();
+      while (!stopped(result.reason)) {
+        step();
+      }
+      result.best = _best.first;
+      result.rank = _best.second;
+      result.generations = _generation;
+      result.evaluations = _evaluations;
+      result.seconds = detail::seconds_since(_start);
+      return result;
+    }
+
+    /// Checks the stopping criteria, writing the reason when true
+    bool stopped(StopReason &reason) const {
+      return detail::check_stop(_options, _generation, _last_improvement,
+                                static_cast<double>(_best.second),
+                                _evaluations, _start, reason);
+    }
+
+    /// Produces and ranks the next generation
+    void step() {
+      _couples.resize(_options.population_size - 1uL);
+      _population.select(_select_func, _couples);
+      _next.clear();
+      for (const IndexCouple &couple : _couples) {
+        _population.genome(couple.first, _a);
+        _population.genome(couple.second, _b);
+        cross_over_into(_cross_over_func, _a, _b, _child);
+        mutate_in_place(_mutate_func, _child);
+        _next.push(_child);
+      }
+      _evaluations += _next.rankPending(_pool);
+      _population.swap(_next);
+      ++_generation;
+      const size_t top = _population.topIndex();
+      if (_best.second < _population.rank(top)) {
+        _population.genome(top, _best.first);
+        _best.second = _population.rank(top);
+        _last_improvement = _generation;
+      }
+      // elitism: the best one passes directly, with its known rank
+      _population.push(_best.first, _best.second);
+    }
+
+    size_t generation() const {
+      return _generation;
+    }
+
+    /// calls to RankFunctor since init()
+    size_t evaluations() const {
+      return _evaluations;
+    }
+
+    const Hypothesis &best() const {
+      return _best;
+    }
+
+    const population_t &population() const {
+      return _population;
+    }
+
+  private:
+    const SolverOptions _options;
+    const InitializerFunctor &_init_func;
+    const SelectionFunctor &_select_func;
+    const CrossOverFunctor &_cross_over_func;
+    const MutationFunctor &_mutate_func;
+    ThreadPool _pool;
+    /// reused parents and child
+    Genome _a, _b, _child;
+    population_t _population;
+    population_t _next;
+    Hypothesis _best;
+    std::vector<IndexCouple> _couples;
+    size_t _generation;
+    size_t _last_improvement;
+    size_t _evaluations;
+    std::chrono::steady_clock::time_point _start;
+  }; // class PackedGeneticSolver
+
+  /**
+   * As evolve(), running a PackedGeneticSolver
+   *
+   * @code
+   * SolverResult<Chromosome, float> result =
+   *   evolve_packed(options, true, RandomInitializer(N, rng(), 0.5f),
+   *                 FloatTournamentSelection(2u, rng()),
+   *                 RandomSplitCrossOver(N, rng()),
+   *                 RandomMutate(rng(), 0.01f), MyRank());
+   * @endcode
+   */
+  template<typename T=float,
+           typename InitializerFunctor,
+           typename SelectionFunctor,
+           typename CrossOverFunctor,
+           typename MutationFunctor,
+           typename RankFunctor>
+  SolverResult<typename genome_of<InitializerFunctor>::type, T>
+  evolve_packed(const SolverOptions &options,
+                const bool deduplicate,
+                const InitializerFunctor &init_func,
+                const SelectionFunctor &select_func,
+                const CrossOverFunctor &cross_over_func,
+                const MutationFunctor &mutate_func,
+                const RankFunctor &rank_func) {
+    PackedGeneticSolver<T, InitializerFunctor, SelectionFunctor,
+                        CrossOverFunctor, MutationFunctor,
+                        RankFunctor> solver(options, deduplicate, init_func,
+                                            select_func, cross_over_func,
+                                            mutate_func, rank_func);
+    return solver.run();
+  }
+
+} // namespace GeneticAlgorithms
+
+#endif // PACKED_POPULATION_H
@@ -0,0 +1,198 @@
+/*
+ * This file is part of GeneticAlgorithms toolkit
+ *
+ * Copyright 2017, Francisco Zamora-Martinez
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef PERMUTATION_H
+#define PERMUTATION_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "chromosome.h"
+#include "fitness_cache.h"
+
+namespace GeneticAlgorithms {
+
+  /**
+   * A genome which is an ordering of the integers [0,N), as needed by
+   * scheduling or routing problems
+   *
+   * Values are stored in a contiguous std::vector<uint32_t>, so rank
+   * functors and genetic operators read data() directly, without any
+   * decoding. Genetic operators for permutations (see
+   * RandomPermutationInitializer, OrderCrossOver,
+   * PartiallyMappedCrossOver, SwapMutate and InversionMutate) only
+   * produce valid permutations, so no repair is needed.
+   *
+   * The storage is padded to a whole number of words, the padding
+   * value being zero, and words() exposes it for the parts of the
+   * library which copy genomes as raw memory (checkpoints, rank_batch
+   * matrices). Words shouldn't be read as integers, use data().
+   *
+   * Permutation can be the Genome argument of Population and of the
+   * solvers, which take it from the initializer.
+   */
+  class Permutation {
+  public:
+    typedef std::pair<Permutation, Permutation > Couple;
+    typedef uint32_t value_type;
+
+    /// Builds the identity permutation of N values
+    explicit Permutation(const size_t N) :
+      _values(paddedSize(N), 0u),
+      _size(N) {
+      for (size_t i=0; i<N; ++i) _values[i] = static_cast<uint32_t>(i);
+    }
+
+    /// Builds a permutation from the given values, which should be one
+    Permutation(const std::vector<uint32_t> &values) :
+      _values(values),
+      _size(values.size()) {
+      _values.resize(paddedSize(_size), 0u);
+    }
+
+    Permutation() :
+      _size(0u) {
+    }
+
+    uint32_t operator[](const size_t i) const {
+      return _values[i];
+    }
+
+    size_t size() const {
+      return _size;
+    }
+
+    const uint32_t *data() const {
+      return _values.data();
+    }
+
+    uint32_t *data() {
+      return _values.data();
+    }
+
+    /// returns a copy of the values
+    std::vector<uint32_t> values() const {
+      return std::vector<uint32_t>(_values.begin(), _values.begin() + _size);
+    }
+
+    size_t numWords() const {
+      return _values.size() / 2u;
+    }
+
+    const word_type *words() const {
+      return reinterpret_cast<const word_type*>(_values.data());
+    }
+
+    word_type *words() {
+      return reinterpret_cast<word_type*>(_values.data());
+    }
+
+    /// swaps the values at positions i and j
+    void swap(const size_t i, const size_t j) {
+      std::swap(_values[i], _values[j]);
+    }
+
+    /**
+     * Changes the number of values, resetting to the identity when it
+     * changes
+     *
+     * Memory is only allocated when the permutation grows over its
+     * previous capacity, so genetic operators use this method to
+     * write into reused permutations.
+     */
+    void resize(const size_t N) {
+      if (N == _size) return;
+      _values.resize(paddedSize(N));
+      for (size_t i=0; i<N; ++i) _values[i] = static_cast<uint32_t>(i);
+      if (N % 2u != 0u) _values.back() = 0u;
+      _size = N;
+    }
+
+    /// true when every value of [0,size()) appears once
+    bool valid() const {
+      std::vector<bool> seen(_size, false);
+      for (size_t i=0; i<_size; ++i) {
+        if (_values[i] >= _size || seen[_values[i]]) return false;
+        seen[_values[i]] = true;
+      }
+      return true;
+    }
+
+  private:
+    std::vector<uint32_t> _values;
+    size_t _size;
+
+    static size_t paddedSize(const size_t N) {
+      return 2u * ((N + 1u) / 2u);
+    }
+  }; // class Permutation
+
+  /// genome_hash() of a Permutation, which reads its values as such
+  inline uint64_t genome_hash(const Permutation &x) {
+    uint64_t h = mix_hash(x.size() ^ 0x9e3779b97f4a7c15ULL);
+    const uint32_t *values = x.data();
+    for (size_t i=0; i+1u<x.size(); i+=2u) {
+      const uint64_t w = values[i] | (uint64_t(values[i + 1u]) << 32);
+      h = mix_hash(h ^ w) + 0x9e3779b97f4a7c15ULL;
+    }
+    if (x.size() % 2u != 0u) {
+      h = mix_hash(h ^ values[x.size() - 1u]) + 0x9e3779b97f4a7c15ULL;
+    }
+    return h;
+  }
+
+  namespace detail {
+
+    /**
+     * Scratch memory of the permutation operators, one per thread, so
+     * they allocate only until it reaches the permutation size and the
+     * overloads receiving a random generator stay reentrant
+     */
+    inline std::vector<uint32_t> &permutation_scratch(const size_t n) {
+      static thread_local std::vector<uint32_t> scratch;
+      if (scratch.size() < n) scratch.resize(n);
+      return scratch;
+    }
+
+    /// Draws a random segment [first,last] of positions in [0,n), n > 0
+    template<typename URNG>
+    void draw_segment(const size_t n, URNG &rng, size_t &first, size_t &last) {
+      std::uniform_int_distribution<size_t> dist(0u, n - 1u);
+      first = dist(rng);
+      last = dist(rng);
+      if (last < first) std::swap(first, last);
+    }
+
+  } // namespace detail
+
+} // namespace GeneticAlgorithms
+
+#endif // PERMUTATION_H
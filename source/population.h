@@ -28,12 +28,21 @@
 #ifndef POPULATION_H
 #define POPULATION_H
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
 #include <numeric>
 #include <queue>
+#include <utility>
 #include <vector>
 
+#include "bit_kernels.h"
 #include "chromosome.h"
+#include "fitness_cache.h"
+#include "indexed_heap.h"
+#include "operator_traits.h"
+#include "random.h"
+#include "thread_pool.h"
 
 namespace GeneticAlgorithms {
 
@@ -43,33 +52,191 @@ namespace GeneticAlgorithms {
    * This class is responsible of the association of Chromosome
    * with their rank and of the selection of couples. Both operations
    * are delegated on two functors.
+   *
+   * Batches of Chromosome can be ranked in parallel by giving a
+   * ThreadPool, in which case RankFunctor::operator() should be safe
+   * to call concurrently (a const method without side effects is
+   * enough). The result doesn't depend on the number of threads.
+   *
+   * The Genome template argument is the chromosome type, Chromosome
+   * or StaticChromosome.
+   *
+   * Chromosomes and ranks are stored in two separate arrays, and the
+   * population keeps two of these arenas: the current generation,
+   * accessed by push(), genome(), rank() and top(), and the next
+   * generation, written in place by using beginGeneration(), child()
+   * and endGeneration(). Slots are never freed, so when both arenas
+   * reach their size, new generations reuse the memory of the
+   * Chromosomes discarded two generations ago and no allocation is
+   * needed.
+   *
+   * An optional FitnessCache can be enabled, so duplicated
+   * Chromosomes are ranked only once while they stay in the cache.
+   * Cache queries are done sequentially and only misses are ranked in
+   * parallel, so results stay deterministic.
+   *
+   * When RankFunctor implements rank_delta (see has_rank_delta), a
+   * child which is a copy of a parent of the current generation with
+   * a few flipped gens can be declared with setChildParent() and
+   * childFlips(), and it is ranked incrementally from its parent.
+   *
+   * When RankFunctor implements rank_batch (see has_batch_rank), the
+   * Chromosomes of every batch (init(), endGeneration()) which must
+   * be ranked from scratch are gathered into a contiguous matrix of
+   * words and ranked by a few rank_batch() calls, one per thread of
+   * the pool. All Chromosomes should have the same number of words.
+   *
+   * @code
+   * pop.beginGeneration(n);
+   * for (size_t i=0; i<n; ++i) write_child_into(pop.child(i));
+   * pop.endGeneration(pool); // ranks children, they become current
+   * @endcode
    */
-  template<typename RankFunctor, typename T = float>
+  template<typename RankFunctor, typename T = float,
+           typename Genome = Chromosome>
   class Population {
   public:
     /// a Hypothesis is the combination of gens and their rank
-    typedef std::pair<Chromosome, T> Hypothesis;
+    typedef std::pair<Genome, T> Hypothesis;
+
+    /// true when RankFunctor implements rank_delta
+    static const bool SUPPORTS_DELTA =
+      has_rank_delta<RankFunctor, Genome, T>::value;
+
+    /// true when RankFunctor implements rank_batch
+    static const bool BATCH_RANK = has_batch_rank<RankFunctor, T>::value;
+
+    /// value of setChildParent() for children ranked from scratch
+    static const size_t NO_PARENT = ~size_t(0u);
     
     Population(const RankFunctor &rank_func) :
       _rank_func(rank_func),
-      _top(Chromosome(), std::numeric_limits<T>::min()) {
+      _size(0u),
+      _top(0u),
+      _best_built(false),
+      _next_size(0u),
+      _cache(0u),
+      _evaluations(0u) {
     }
 
     size_t size() const {
-      return _queue.size();
+      return _size;
     }
 
     /// push and rank the given Chromosome
-    void push(const Chromosome &x) {
-      _queue.push_back(Hypothesis(x, _rank_func(x)));
-      if (_top.second < _queue.back().second) _top = _queue.back();
+    void push(const Genome &x) {
+      const size_t i = appendSlot();
+      _genomes[i] = x;
+      _ranks[i] = rankSlot(i);
+      if (i == 0u || _ranks[_top] < _ranks[i]) _top = i;
+    }
+
+    /// push and rank the given Chromosome, moving it into its slot
+    void push(Genome &&x) {
+      const size_t i = appendSlot();
+      _genomes[i] = std::move(x);
+      _ranks[i] = rankSlot(i);
+      if (i == 0u || _ranks[_top] < _ranks[i]) _top = i;
+    }
+
+    /// push the given Chromosome with an already known rank
+    void push(const Genome &x, const T rank) {
+      const size_t i = appendSlot();
+      _genomes[i] = x;
+      _ranks[i] = rank;
+      if (i == 0u || _ranks[_top] < rank) _top = i;
+    }
+
+    /// As the previous one, moving x into its slot
+    void push(Genome &&x, const T rank) {
+      const size_t i = appendSlot();
+      _genomes[i] = std::move(x);
+      _ranks[i] = rank;
+      if (i == 0u || _ranks[_top] < rank) _top = i;
+    }
+
+    /**
+     * push and rank a Chromosome built in place from the given
+     * arguments, as Genome(args...)
+     *
+     * The Chromosome is built as a temporary and moved into its slot,
+     * so the memory of a slot discarded by reset() is released. push()
+     * copies into that memory instead, reusing it.
+     */
+    template<typename... Args>
+    void emplace(Args&&... args) {
+      const size_t i = appendSlot();
+      _genomes[i] = Genome(std::forward<Args>(args)...);
+      _ranks[i] = rankSlot(i);
+      if (i == 0u || _ranks[_top] < _ranks[i]) _top = i;
+    }
+
+    /**
+     * push and rank all Chromosome in range [first,last)
+     *
+     * Ranks are computed in parallel using the given pool, and the
+     * best Hypothesis is updated following the range order, so the
+     * result is the same as pushing one by one.
+     */
+    template<typename Iterator>
+    void push(Iterator first, Iterator last, ThreadPool &pool) {
+      const size_t offset = _size;
+      for (; first != last; ++first) {
+        _genomes[appendSlot()] = *first;
+      }
+      rankAll(_genomes.data() + offset, _ranks.data() + offset, 0,
+              _size - offset, pool);
+      for (size_t i=offset; i<_size; ++i) {
+        if (i == 0u || _ranks[_top] < _ranks[i]) _top = i;
+      }
+    }
+
+    /// returns the Chromosome at position i
+    const Genome &genome(const size_t i) const {
+      return _genomes[i];
     }
 
-    /// returns the best Hypothesis in the population set
-    const Hypothesis &top() const {
+    /// returns the rank of the Chromosome at position i
+    T rank(const size_t i) const {
+      return _ranks[i];
+    }
+
+    /// returns all ranks, in the same order as the Chromosomes
+    const std::vector<T> &ranks() const {
+      return _ranks;
+    }
+
+    /// returns a copy of the best Hypothesis in the population set
+    Hypothesis top() const {
+      if (_size == 0u) {
+        return Hypothesis(Genome(), std::numeric_limits<T>::min());
+      }
+      return Hypothesis(_genomes[_top], _ranks[_top]);
+    }
+
+    /// returns the position of the best Hypothesis, size() must be > 0
+    size_t topIndex() const {
       return _top;
     }
 
+    /// returns the position of the worst Hypothesis, size() must be > 0
+    size_t bottomIndex() const {
+      return static_cast<size_t>(std::min_element(_ranks.begin(), _ranks.end()) -
+                                 _ranks.begin());
+    }
+
+    /// replaces the Chromosome at position i, which gets the given rank
+    void replace(const size_t i, const Genome &x, const T rank) {
+      _genomes[i] = x;
+      updateRank(i, rank);
+    }
+
+    /// As the previous one, moving x into the slot
+    void replace(const size_t i, Genome &&x, const T rank) {
+      _genomes[i] = std::move(x);
+      updateRank(i, rank);
+    }
+
     /**
      * Initializes by using the given functor
      *
@@ -77,13 +244,96 @@ namespace GeneticAlgorithms {
      * clearing the vector.
      */
     template<typename InitializerFunctor>
-    void init(const InitializerFunctor init_func,
+    void init(const InitializerFunctor &init_func,
               const size_t size) {
       for (size_t i=0; i<size; ++i) {
         push(init_func());
-        // std::cout << "    " << x.rank() << " " << x.gens() << std::endl;
       }
-      // std::cout << "\n" << std::endl;
+    }
+
+    /**
+     * Initializes by using the given functor, ranking in parallel
+     *
+     * Chromosomes are generated sequentially, so the population is
+     * the same for any number of threads.
+     */
+    template<typename InitializerFunctor>
+    void init(const InitializerFunctor &init_func,
+              const size_t size,
+              ThreadPool &pool) {
+      const size_t offset = _size;
+      for (size_t i=0; i<size; ++i) {
+        _genomes[appendSlot()] = init_func();
+      }
+      rankAll(_genomes.data() + offset, _ranks.data() + offset, 0,
+              size, pool);
+      for (size_t i=offset; i<_size; ++i) {
+        if (i == 0u || _ranks[_top] < _ranks[i]) _top = i;
+      }
+    }
+
+    /**
+     * Initializes by using the given functor, generating and ranking
+     * in parallel
+     *
+     * Chromosome i is drawn from the Philox4x32 stream i of the given
+     * seed (see make_stream()), so the population is the same for any
+     * number of threads. InitializerFunctor must accept a random
+     * generator (see initializes_with_rng), and each Chromosome is
+     * ranked by the task which generated it, unless a FitnessCache or
+     * rank_batch is used.
+     */
+    template<typename InitializerFunctor>
+    void init(const InitializerFunctor &init_func,
+              const size_t size,
+              ThreadPool &pool,
+              const uint64_t seed) {
+      const size_t offset = _size;
+      for (size_t i=0; i<size; ++i) appendSlot();
+      Genome *genomes = _genomes.data() + offset;
+      T *ranks = _ranks.data() + offset;
+      const bool fused = _cache.capacity() == 0u && !BATCH_RANK;
+      const Population *self = this;
+      pool.parallelFor(size, [self, &init_func, genomes, ranks, fused,
+                              seed](size_t i) {
+          Philox4x32 rng = make_stream<Philox4x32>(seed, i);
+          genomes[i] = init_func(rng);
+          if (fused) ranks[i] = self->rankOne(genomes, 0, i);
+        });
+      if (fused) _evaluations += size;
+      else rankAll(genomes, ranks, 0, size, pool);
+      for (size_t i=offset; i<_size; ++i) {
+        if (i == 0u || _ranks[_top] < _ranks[i]) _top = i;
+      }
+    }
+
+    /**
+     * Appends n Chromosomes of num_gens gens with known ranks, copied
+     * from a matrix of words with one row per Chromosome
+     *
+     * It resumes a population saved by a checkpoint (see
+     * checkpoint.h) without ranking it again, evaluations being the
+     * value of evaluations() when it was saved. The copy runs in
+     * parallel using the given pool.
+     */
+    void restore(const word_type *words, const size_t num_gens,
+                 const T *ranks, const size_t n, const size_t evaluations,
+                 ThreadPool &pool) {
+      const size_t offset = _size;
+      for (size_t i=0; i<n; ++i) {
+        const size_t slot = appendSlot();
+        _genomes[slot].resize(num_gens);
+        _ranks[slot] = ranks[i];
+      }
+      Genome *genomes = _genomes.data() + offset;
+      pool.parallelFor(n, [genomes, words](size_t i) {
+          const size_t stride = genomes[i].numWords();
+          kernels::copy_words(genomes[i].words(), words + i * stride, stride);
+        });
+      for (size_t i=offset; i<_size; ++i) {
+        if (i == 0u || _ranks[_top] < _ranks[i]) _top = i;
+      }
+      _evaluations = evaluations;
     }
 
     /**
@@ -93,26 +343,384 @@ namespace GeneticAlgorithms {
      * with the given size.
      */
     template<typename SelectionFunctor>
-    std::vector<typename Chromosome::Couple >
+    std::vector<typename Genome::Couple >
     select(const SelectionFunctor &select_func, size_t result_size=0uL) {
-      if (result_size == 0uL) result_size = _queue.size();
-      return select_func(_queue, result_size);
+      if (result_size == 0uL) result_size = _size;
+      std::vector<Hypothesis> hypotheses;
+      hypotheses.reserve(_size);
+      for (size_t i=0; i<_size; ++i) {
+        hypotheses.push_back(Hypothesis(_genomes[i], _ranks[i]));
+      }
+      return select_func(hypotheses, result_size);
     }
 
-    /// Clears the vector
+    /**
+     * Given a selection functor, fills result with couples of positions
+     *
+     * The number of couples is given by result.size(), and the
+     * SelectionFunctor only receives the ranks of the population.
+     */
+    template<typename SelectionFunctor>
+    void select(const SelectionFunctor &select_func,
+                std::vector<IndexCouple> &result) const {
+      select_func(_ranks, result);
+    }
+
+    /// Clears the vector, the memory of the Chromosomes is kept
     void reset() {
-      _queue.clear();
-      _top = Hypothesis(Chromosome(), std::numeric_limits<T>::min());
+      _size = 0u;
+      _ranks.clear();
+      _top = 0u;
+      _best_built = false;
+    }
+
+    /**
+     * Starts writing a new generation of n Chromosomes
+     *
+     * The current generation remains accessible until
+     * endGeneration() is called.
+     */
+    void beginGeneration(const size_t n) {
+      if (_next_genomes.size() < n) _next_genomes.resize(n);
+      _next_ranks.resize(n);
+      _next_ranked.assign(n, 0u);
+      if (SUPPORTS_DELTA) {
+        _next_parents.assign(n, NO_PARENT);
+        if (_next_flips.size() < n) _next_flips.resize(n);
+      }
+      _next_size = n;
+    }
+
+    /// returns the slot i of the next generation, to be written in place
+    Genome &child(const size_t i) {
+      return _next_genomes[i];
+    }
+
+    /// sets the rank of child i, so it won't be ranked again
+    void setChildRank(const size_t i, const T rank) {
+      _next_ranks[i] = rank;
+      _next_ranked[i] = 1u;
+    }
+
+    /**
+     * Declares child i as parent of the current generation with the
+     * gens at childFlips(i) flipped
+     *
+     * It is ignored unless SUPPORTS_DELTA, otherwise the child is
+     * ranked by calling RankFunctor::rank_delta().
+     */
+    void setChildParent(const size_t i, const size_t parent) {
+      if (SUPPORTS_DELTA) _next_parents[i] = parent;
+    }
+
+    /// positions flipped in child i with respect to its parent
+    std::vector<size_t> &childFlips(const size_t i) {
+      return _next_flips[i];
+    }
+
+    /**
+     * Runs beginGeneration(n) and then producer(i) for every child i
+     * in parallel, ranking each child in the task which produced it
+     *
+     * producer(i) must only write child(i) and the state of its slot
+     * (setChildRank(), setChildParent(), childFlips()), and it can
+     * read the current generation. Children are ranked straight away
+     * unless a FitnessCache or rank_batch is used, in which case they
+     * are left to endGeneration(), which must be called afterwards in
+     * any case.
+     */
+    template<typename Producer>
+    void produceGeneration(const size_t n, ThreadPool &pool,
+                           const Producer &producer) {
+      beginGeneration(n);
+      const bool fused = _cache.capacity() == 0u && !BATCH_RANK;
+      Population *self = this;
+      const size_t *parents = SUPPORTS_DELTA ? _next_parents.data() : 0;
+      pool.parallelFor(n, [self, &producer, fused, parents](size_t i) {
+          producer(i);
+          if (fused && !self->_next_ranked[i]) {
+            self->_next_ranks[i] = self->rankOne(self->_next_genomes.data(),
+                                                 parents, i);
+            self->_next_ranked[i] = RANKED_HERE;
+          }
+        });
+      if (fused) {
+        for (size_t i=0; i<n; ++i) _evaluations += (_next_ranked[i] == RANKED_HERE);
+      }
+    }
+
+    /**
+     * Ranks all children in parallel and makes them the current
+     * generation
+     *
+     * The former current generation becomes the storage for the
+     * next call to beginGeneration().
+     */
+    void endGeneration(ThreadPool &pool) {
+      rankGeneration(pool);
+      _genomes.swap(_next_genomes);
+      _ranks.swap(_next_ranks);
+      _size = _next_size;
+      _next_size = 0u;
+      _top = 0u;
+      _best_built = false;
+      for (size_t i=1u; i<_size; ++i) {
+        if (_ranks[_top] < _ranks[i]) _top = i;
+      }
+    }
+
+    /**
+     * Ranks in parallel the children without a known rank, through
+     * the FitnessCache and rank_delta when available, leaving them in
+     * the next generation
+     *
+     * Their ranks are given by childRank(), so children can be
+     * taken one by one instead of calling endGeneration().
+     */
+    void rankGeneration(ThreadPool &pool) {
+      rankAll(_next_genomes.data(), _next_ranks.data(),
+              _next_ranked.data(), _next_size, pool,
+              SUPPORTS_DELTA ? _next_parents.data() : 0);
+      _next_ranked.assign(_next_size, 1u);
+    }
+
+    /// returns the rank of child i, after rankGeneration()
+    T childRank(const size_t i) const {
+      return _next_ranks[i];
+    }
+
+    /**
+     * Enables a FitnessCache with the given number of entries
+     *
+     * A capacity of zero disables the cache. Counters are reset.
+     */
+    void enableCache(const size_t capacity) {
+      _cache = FitnessCache<Genome, T>(capacity);
+    }
+
+    /**
+     * number of calls to RankFunctor (incremental ones included) since
+     * construction
+     */
+    size_t evaluations() const {
+      return _evaluations;
+    }
+
+    /// number of Chromosomes whose rank was found in the cache
+    size_t cacheHits() const {
+      return _cache.hits();
+    }
+
+    /// number of Chromosomes ranked after looking for them in the cache
+    size_t cacheMisses() const {
+      return _cache.misses();
     }
 
   private:
     RankFunctor _rank_func;
-    /// The population set is stored here
-    std::vector<Hypothesis> _queue;
-    /// The best hypothesis in the set
-    Hypothesis _top;
+    /// The population set is stored here, slots [0,_size) are in use
+    std::vector<Genome> _genomes;
+    /// The rank of every Chromosome in the population set
+    std::vector<T> _ranks;
+    size_t _size;
+    /// The position of the best hypothesis in the set
+    size_t _top;
+    /// Max-heap of _ranks for replace(), valid while _best_built
+    IndexedHeap<T, std::greater<T> > _best;
+    bool _best_built;
+    /// The arena for the next generation
+    std::vector<Genome> _next_genomes;
+    std::vector<T> _next_ranks;
+    /// Children with a known rank, they are not ranked again
+    std::vector<unsigned char> _next_ranked;
+    /// value of _next_ranked for children ranked by produceGeneration()
+    static const unsigned char RANKED_HERE = 2u;
+    size_t _next_size;
+    /// Disabled when its capacity is zero
+    FitnessCache<Genome, T> _cache;
+    /// Hashes of the Chromosomes being ranked
+    std::vector<uint64_t> _hashes;
+    /// Positions of the Chromosomes not found in the cache
+    std::vector<size_t> _pending;
+    /// Parents of the next generation, only used if SUPPORTS_DELTA
+    std::vector<size_t> _next_parents;
+    std::vector<std::vector<size_t> > _next_flips;
+    size_t _evaluations;
+    /// Staging matrix of words and ranks for rank_batch
+    std::vector<word_type> _batch_words;
+    std::vector<T> _batch_ranks;
+    /// Positions of the Chromosomes gathered into the matrix
+    std::vector<size_t> _batch_rows;
+
+    /**
+     * sets the rank of the Chromosome at position i, updating the top
+     *
+     * The top keeps i on ties, and when it gets worse the new one is
+     * taken from _best, which is built by the first replacement after
+     * any other change of the population, so it is never searched.
+     */
+    void updateRank(const size_t i, const T rank) {
+      const bool top = !(rank < _ranks[_top]);
+      _ranks[i] = rank;
+      if (_best_built) {
+        _best.update(i, rank);
+      }
+      else {
+        _best.build(_ranks.data(), _size);
+        _best_built = true;
+      }
+      if (top) _top = i;
+      else if (i == _top) _top = _best.top();
+    }
+
+    /// ranks the Chromosome at slot i, looking for it in the cache
+    T rankSlot(const size_t i) {
+      const Genome &x = _genomes[i];
+      if (_cache.capacity() == 0u) {
+        ++_evaluations;
+        return rank_genome<T>(_rank_func, x);
+      }
+      const uint64_t h = genome_hash(x);
+      T rank;
+      if (!_cache.find(x, h, rank)) {
+        ++_evaluations;
+        rank = rank_genome<T>(_rank_func, x);
+        _cache.insert(x, h, rank);
+      }
+      return rank;
+    }
+
+    /// returns a new slot at the end of the population set
+    size_t appendSlot() {
+      if (_genomes.size() == _size) _genomes.push_back(Genome());
+      _ranks.push_back(T());
+      _best_built = false;
+      return _size++;
+    }
+
+    /// ranks the Chromosome i of an array, maybe from its parent
+    T rankOne(const Genome *genomes, const size_t *parents,
+              const size_t i) const {
+      if (parents && parents[i] != NO_PARENT) {
+        const size_t p = parents[i];
+        typedef std::integral_constant<bool, SUPPORTS_DELTA> delta_t;
+        return detail::rank_delta(_rank_func, _ranks[p], _genomes[p],
+                                  _next_flips[i], delta_t());
+      }
+      return rank_genome<T>(_rank_func, genomes[i]);
+    }
+
+    /**
+     * ranks in parallel all Chromosomes but those with ranked[i] != 0
+     *
+     * parents is null unless the array is the next generation.
+     */
+    void rankAll(const Genome *genomes, T *ranks,
+                 const unsigned char *ranked, const size_t n,
+                 ThreadPool &pool, const size_t *parents = 0) {
+      const Population *self = this;
+      if (_cache.capacity() == 0u && !BATCH_RANK) {
+        pool.parallelFor(n, [self, genomes, ranks, ranked, parents](size_t i) {
+            if (!ranked || !ranked[i]) ranks[i] = self->rankOne(genomes, parents, i);
+          });
+        if (!ranked) _evaluations += n;
+        else for (size_t i=0; i<n; ++i) _evaluations += !ranked[i];
+        return;
+      }
+      _pending.clear();
+      if (_cache.capacity() == 0u) {
+        for (size_t i=0; i<n; ++i) {
+          if (!ranked || !ranked[i]) _pending.push_back(i);
+        }
+      }
+      else {
+        _hashes.resize(n);
+        uint64_t *hashes = _hashes.data();
+        pool.parallelFor(n, [genomes, hashes](size_t i) {
+            hashes[i] = genome_hash(genomes[i]);
+          });
+        for (size_t i=0; i<n; ++i) {
+          if (ranked && ranked[i]) continue;
+          if (!_cache.find(genomes[i], _hashes[i], ranks[i])) _pending.push_back(i);
+        }
+      }
+      if (BATCH_RANK) rankBatch(genomes, ranks, pool, parents);
+      else {
+        const size_t *pending = _pending.data();
+        pool.parallelFor(_pending.size(),
+                         [self, genomes, ranks, pending, parents](size_t j) {
+                           ranks[pending[j]] = self->rankOne(genomes, parents, pending[j]);
+                         });
+      }
+      if (_cache.capacity() > 0u) {
+        for (const size_t i : _pending) {
+          _cache.insert(genomes[i], _hashes[i], ranks[i]);
+        }
+      }
+      _evaluations += _pending.size();
+    }
+
+    /**
+     * ranks the _pending Chromosomes, gathering those without parent
+     * into the staging matrix
+     *
+     * Children with a parent are still ranked incrementally, one by
+     * one, and the matrix is split into one block of rows per thread.
+     */
+    void rankBatch(const Genome *genomes, T *ranks, ThreadPool &pool,
+                   const size_t *parents) {
+      const Population *self = this;
+      _batch_rows.clear();
+      size_t num_delta = 0u;
+      for (const size_t i : _pending) {
+        if (parents && parents[i] != NO_PARENT) _pending[num_delta++] = i;
+        else _batch_rows.push_back(i);
+      }
+      const size_t *delta = _pending.data();
+      pool.parallelFor(num_delta, [self, genomes, ranks, delta, parents](size_t j) {
+          ranks[delta[j]] = self->rankOne(genomes, parents, delta[j]);
+        });
+      // _pending keeps all ranked positions, for the cache
+      _pending.resize(num_delta);
+      _pending.insert(_pending.end(), _batch_rows.begin(), _batch_rows.end());
+      const size_t rows = _batch_rows.size();
+      if (rows == 0u) return;
+      const size_t stride = genomes[_batch_rows[0]].numWords();
+      _batch_words.resize(rows * stride);
+      _batch_ranks.resize(rows);
+      word_type *matrix = _batch_words.data();
+      const size_t *batch = _batch_rows.data();
+      pool.parallelFor(rows, [genomes, matrix, batch, stride](size_t r) {
+          kernels::copy_words(matrix + r * stride, genomes[batch[r]].words(),
+                              stride);
+        });
+      const size_t blocks = std::min(pool.size(), rows);
+      T *batch_ranks = _batch_ranks.data();
+      const RankFunctor *rank_func = &_rank_func;
+      pool.parallelFor(blocks, [rank_func, matrix, batch_ranks, stride,
+                                rows, blocks](size_t b) {
+          const size_t first = rows * b / blocks;
+          const size_t last = rows * (b + 1u) / blocks;
+          detail::rank_batch(*rank_func, matrix + first * stride, stride,
+                             last - first, batch_ranks + first,
+                             std::integral_constant<bool, BATCH_RANK>());
+        });
+      for (size_t r=0; r<rows; ++r) ranks[batch[r]] = batch_ranks[r];
+    }
   }; // class Population
 
+  template<typename RankFunctor, typename T, typename Genome>
+  const bool Population<RankFunctor, T, Genome>::SUPPORTS_DELTA;
+
+  template<typename RankFunctor, typename T, typename Genome>
+  const bool Population<RankFunctor, T, Genome>::BATCH_RANK;
+
+  template<typename RankFunctor, typename T, typename Genome>
+  const size_t Population<RankFunctor, T, Genome>::NO_PARENT;
+
+  template<typename RankFunctor, typename T, typename Genome>
+  const unsigned char Population<RankFunctor, T, Genome>::RANKED_HERE;
+
 } // GeneticAlgorithms
 
 #endif // POPULATION_H
@@ -0,0 +1,314 @@
+/*
+ * This file is part of GeneticAlgorithms toolkit
+ *
+ * Copyright 2017, Francisco Zamora-Martinez
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+
+namespace GeneticAlgorithms {
+
+  /**
+   * SplitMix64 mixing function, a bijection of 64 bits integers
+   *
+   * Close inputs produce unrelated outputs, so it is used to derive
+   * seeds and initial states from small integers.
+   */
+  inline uint64_t mix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  /**
+   * Identifier of the random stream of an individual at a given
+   * generation, unique while both of them are below 2^32
+   */
+  inline uint64_t stream_id(const uint64_t generation,
+                            const uint64_t individual) {
+    return (generation << 32) ^ individual;
+  }
+
+  /**
+   * SplitMix64 generator, 8 bytes of state
+   *
+   * It follows the UniformRandomBitGenerator concept, so it works with
+   * the distributions of <random>. The state is a counter, so
+   * discard() costs O(1).
+   */
+  class SplitMix64 {
+  public:
+    typedef uint64_t result_type;
+
+    explicit SplitMix64(const uint64_t seed = 0u) : _state(seed) {
+    }
+
+    void seed(const uint64_t seed) {
+      _state = seed;
+    }
+
+    static constexpr result_type min() { return 0u; }
+    static constexpr result_type max() { return ~result_type(0u); }
+
+    result_type operator()() {
+      _state += GOLDEN_GAMMA;
+      return mix64(_state);
+    }
+
+    void discard(const unsigned long long n) {
+      _state += GOLDEN_GAMMA * n;
+    }
+
+    /// Writes the state as text, as the engines of <random> do
+    friend std::ostream &operator<<(std::ostream &os, const SplitMix64 &g) {
+      return os << g._state;
+    }
+
+    friend std::istream &operator>>(std::istream &is, SplitMix64 &g) {
+      return is >> g._state;
+    }
+
+  private:
+    static const uint64_t GOLDEN_GAMMA = 0x9e3779b97f4a7c15ULL;
+    uint64_t _state;
+  }; // class SplitMix64
+
+  /**
+   * xoshiro256** generator, 32 bytes of state and period 2^256 - 1
+   *
+   * The state is initialized from the seed by using SplitMix64.
+   * jump() advances the generator 2^128 steps, so consecutive jumps
+   * give non-overlapping sequences for up to 2^128 parallel streams.
+   */
+  class Xoshiro256 {
+  public:
+    typedef uint64_t result_type;
+
+    explicit Xoshiro256(const uint64_t seed = 0u) {
+      this->seed(seed);
+    }
+
+    void seed(const uint64_t seed) {
+      SplitMix64 sm(seed);
+      for (int i=0; i<4; ++i) _s[i] = sm();
+    }
+
+    static constexpr result_type min() { return 0u; }
+    static constexpr result_type max() { return ~result_type(0u); }
+
+    result_type operator()() {
+      const uint64_t result = rotl(_s[1] * 5u, 7) * 9u;
+      const uint64_t t = _s[1] << 17;
+      _s[2] ^= _s[0];
+      _s[3] ^= _s[1];
+      _s[1] ^= _s[2];
+      _s[0] ^= _s[3];
+      _s[2] ^= t;
+      _s[3] = rotl(_s[3], 45);
+      return result;
+    }
+
+    void discard(unsigned long long n) {
+      for (; n > 0u; --n) (*this)();
+    }
+
+    /// Advances the generator 2^128 steps
+    void jump() {
+      static const uint64_t JUMP[] = {
+        0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+        0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL
+      };
+      uint64_t s[4] = {0u, 0u, 0u, 0u};
+      for (int i=0; i<4; ++i) {
+        for (int b=0; b<64; ++b) {
+          if (JUMP[i] & (uint64_t(1u) << b)) {
+            for (int j=0; j<4; ++j) s[j] ^= _s[j];
+          }
+          (*this)();
+        }
+      }
+      for (int j=0; j<4; ++j) _s[j] = s[j];
+    }
+
+    /// Writes the state as text, as the engines of <random> do
+    friend std::ostream &operator<<(std::ostream &os, const Xoshiro256 &g) {
+      return os << g._s[0] << ' ' << g._s[1] << ' ' << g._s[2] << ' ' << g._s[3];
+    }
+
+    friend std::istream &operator>>(std::istream &is, Xoshiro256 &g) {
+      return is >> g._s[0] >> g._s[1] >> g._s[2] >> g._s[3];
+    }
+
+  private:
+    uint64_t _s[4];
+
+    static uint64_t rotl(const uint64_t x, const int k) {
+      return (x << k) | (x >> (64 - k));
+    }
+  }; // class Xoshiro256
+
+  /**
+   * Philox4x32-10 counter-based generator
+   *
+   * Every output block is a pure function of a 64 bits key (the
+   * seed) and a 128 bits counter, split here into a 64 bits stream
+   * and a 64 bits position. So any (seed, stream) pair is an
+   * independent sequence of 2^64 blocks, built in O(1) without
+   * jumping, and the generator can be placed anywhere with
+   * discard(). Each block gives two 64 bits words.
+   *
+   * It takes 48 bytes, the buffer of one block included.
+   */
+  class Philox4x32 {
+  public:
+    typedef uint64_t result_type;
+
+    explicit Philox4x32(const uint64_t seed = 0u,
+                        const uint64_t stream = 0u) :
+      _key(seed), _stream(stream), _position(0u), _buffer(), _buffered(0u) {
+    }
+
+    /// Restarts stream 0 of the given seed
+    void seed(const uint64_t seed) {
+      _key = seed;
+      _stream = 0u;
+      _position = 0u;
+      _buffer[0] = _buffer[1] = 0u;
+      _buffered = 0u;
+    }
+
+    static constexpr result_type min() { return 0u; }
+    static constexpr result_type max() { return ~result_type(0u); }
+
+    result_type operator()() {
+      if (_buffered == 0u) {
+        block(_key, _stream, _position++, _buffer);
+        _buffered = 2u;
+      }
+      return _buffer[2u - _buffered--];
+    }
+
+    void discard(unsigned long long n) {
+      const unsigned long long used = (n < _buffered) ? n : _buffered;
+      _buffered -= static_cast<unsigned>(used);
+      n -= used;
+      _position += n / 2u;
+      if (n % 2u) {
+        block(_key, _stream, _position++, _buffer);
+        _buffered = 1u;
+      }
+    }
+
+    /**
+     * Computes the two words of the block at the given stream and
+     * position for the given key
+     */
+    static void block(const uint64_t key, const uint64_t stream,
+                      const uint64_t position, uint64_t out[2]) {
+      uint32_t c[4] = {
+        static_cast<uint32_t>(position), static_cast<uint32_t>(position >> 32),
+        static_cast<uint32_t>(stream), static_cast<uint32_t>(stream >> 32)
+      };
+      uint32_t k0 = static_cast<uint32_t>(key);
+      uint32_t k1 = static_cast<uint32_t>(key >> 32);
+      for (int r=0; r<10; ++r) {
+        const uint64_t p0 = uint64_t(0xD2511F53u) * c[0];
+        const uint64_t p1 = uint64_t(0xCD9E8D57u) * c[2];
+        const uint32_t n0 = static_cast<uint32_t>(p1 >> 32) ^ c[1] ^ k0;
+        const uint32_t n2 = static_cast<uint32_t>(p0 >> 32) ^ c[3] ^ k1;
+        c[0] = n0;
+        c[1] = static_cast<uint32_t>(p1);
+        c[2] = n2;
+        c[3] = static_cast<uint32_t>(p0);
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+      }
+      out[0] = uint64_t(c[0]) | (uint64_t(c[1]) << 32);
+      out[1] = uint64_t(c[2]) | (uint64_t(c[3]) << 32);
+    }
+
+    /// Writes the state as text, as the engines of <random> do
+    friend std::ostream &operator<<(std::ostream &os, const Philox4x32 &g) {
+      return os << g._key << ' ' << g._stream << ' ' << g._position << ' '
+                << g._buffer[0] << ' ' << g._buffer[1] << ' ' << g._buffered;
+    }
+
+    friend std::istream &operator>>(std::istream &is, Philox4x32 &g) {
+      return is >> g._key >> g._stream >> g._position
+                >> g._buffer[0] >> g._buffer[1] >> g._buffered;
+    }
+
+  private:
+    uint64_t _key;
+    uint64_t _stream;
+    uint64_t _position;
+    uint64_t _buffer[2];
+    unsigned _buffered;
+  }; // class Philox4x32
+
+  /**
+   * Builds independent generators for parallel streams, the RNG
+   * policy used by the parallel parts of the library
+   *
+   * The generic version seeds the generator from a mix of seed and
+   * stream, Philox4x32 uses the stream as part of its counter.
+   */
+  template<typename RNG>
+  struct rng_streams {
+    static RNG make(const uint64_t seed, const uint64_t stream) {
+      return RNG(static_cast<typename RNG::result_type>
+                 (mix64(seed ^ mix64(stream + 0x9e3779b97f4a7c15ULL))));
+    }
+  };
+
+  template<>
+  struct rng_streams<Philox4x32> {
+    static Philox4x32 make(const uint64_t seed, const uint64_t stream) {
+      return Philox4x32(seed, stream);
+    }
+  };
+
+  /**
+   * Generator for the given stream of a seed, see rng_streams
+   *
+   * @code
+   * // reproducible and independent of the thread which runs it
+   * Philox4x32 rng = make_stream<Philox4x32>(seed, stream_id(gen, i));
+   * mutate(child, child, rng);
+   * @endcode
+   */
+  template<typename RNG>
+  RNG make_stream(const uint64_t seed, const uint64_t stream) {
+    return rng_streams<RNG>::make(seed, stream);
+  }
+
+} // namespace GeneticAlgorithms
+
+#endif // RANDOM_H
@@ -0,0 +1,255 @@
+/*
+ * This file is part of GeneticAlgorithms toolkit
+ *
+ * Copyright 2017, Francisco Zamora-Martinez
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef REAL_KERNELS_H
+#define REAL_KERNELS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+
+namespace GeneticAlgorithms {
+
+  /**
+   * Kernels of the genetic operators of real vectors
+   *
+   * Every kernel works over blocks of REAL_BLOCK lanes: the random
+   * numbers of a block are drawn first into arrays held on the stack,
+   * and then a loop without branches nor calls to the generator
+   * computes the lanes, so the compiler vectorizes it (8 floats with
+   * AVX2, 16 with AVX-512, when targeting them as -march=native
+   * does). std::pow, std::log and friends are vectorized as well when
+   * the compiler has a vector math library (as glibc's libmvec with
+   * -ffast-math), otherwise they are called lane by lane.
+   *
+   * Random numbers are drawn from a 64 bits generator (as
+   * std::mt19937_64 or Philox4x32), two floats or one double per
+   * word, and they are never 0 nor 1.
+   */
+  namespace kernels {
+
+    /// Number of lanes of every block of the real kernels
+    static const size_t REAL_BLOCK = 16u;
+
+    /// Fills u with n uniform floats in (0,1), 24 random bits each
+    template<typename RNG>
+    void uniform_reals(float *u, const size_t n, RNG &rng) {
+      const float scale = 1.0f / 16777216.0f;
+      size_t i = 0u;
+      for (; i + 2u <= n; i += 2u) {
+        const uint64_t w = static_cast<uint64_t>(rng());
+        u[i] = (static_cast<float>(w >> 40) + 0.5f) * scale;
+        u[i + 1u] = (static_cast<float>((w >> 8) & 0xFFFFFFu) + 0.5f) * scale;
+      }
+      if (i < n) {
+        const uint64_t w = static_cast<uint64_t>(rng());
+        u[i] = (static_cast<float>(w >> 40) + 0.5f) * scale;
+      }
+    }
+
+    /// Fills u with n uniform doubles in (0,1), 53 random bits each
+    template<typename RNG>
+    void uniform_reals(double *u, const size_t n, RNG &rng) {
+      const double scale = 1.0 / 9007199254740992.0;
+      for (size_t i=0; i<n; ++i) {
+        const uint64_t w = static_cast<uint64_t>(rng());
+        u[i] = (static_cast<double>(w >> 11) + 0.5) * scale;
+      }
+    }
+
+    /// Fills x with n uniform values in (lower,upper)
+    template<typename T, typename RNG>
+    void uniform_fill(T *x, const size_t n, const T lower, const T upper,
+                      RNG &rng) {
+      uniform_reals(x, n, rng);
+      const T range = upper - lower;
+      for (size_t i=0; i<n; ++i) x[i] = lower + x[i] * range;
+    }
+
+    /**
+     * Simulated binary cross over (SBX) of n values of a and b, with
+     * distribution index eta, written into dest
+     *
+     * Every value is crossed with 0.5 probability, and the child takes
+     * any of both SBX offspring with 0.5 probability, so a single child
+     * follows the distribution of the pair. Values are clamped to
+     * [lower,upper]. dest may be equal to a or b.
+     */
+    template<typename T, typename RNG>
+    void sbx(T *dest, const T *a, const T *b, const size_t n, const T eta,
+             const T lower, const T upper, RNG &rng) {
+      const T exponent = T(1) / (eta + T(1));
+      T u[REAL_BLOCK];
+      for (size_t i=0; i<n; i+=REAL_BLOCK) {
+        const size_t len = std::min(REAL_BLOCK, n - i);
+        uniform_reals(u, len, rng);
+        // bit j decides crossing lane j, bit j+32 the offspring taken
+        const uint64_t bits = static_cast<uint64_t>(rng());
+        for (size_t j=0; j<len; ++j) {
+          const T base = (u[j] <= T(0.5)) ?
+            T(2) * u[j] : T(1) / (T(2) - T(2) * u[j]);
+          const T spread = std::pow(base, exponent);
+          const T beta = ((bits >> j) & 1u) ? spread : T(1);
+          const T sign = ((bits >> (j + 32u)) & 1u) ? T(1) : T(-1);
+          const T x = a[i + j], y = b[i + j];
+          // (1+beta)/2 x + (1-beta)/2 y, or the symmetric one
+          const T c = T(0.5) * ((x + y) + sign * beta * (x - y));
+          dest[i + j] = std::min(std::max(c, lower), upper);
+        }
+      }
+    }
+
+    /**
+     * Blend cross over (BLX-alpha) of n values of a and b written into
+     * dest
+     *
+     * Every value is drawn uniformly from the interval between both
+     * parents extended by alpha times its length at both sides, and
+     * clamped to [lower,upper]. dest may be equal to a or b.
+     */
+    template<typename T, typename RNG>
+    void blend(T *dest, const T *a, const T *b, const size_t n,
+               const T alpha, const T lower, const T upper, RNG &rng) {
+      T u[REAL_BLOCK];
+      for (size_t i=0; i<n; i+=REAL_BLOCK) {
+        const size_t len = std::min(REAL_BLOCK, n - i);
+        uniform_reals(u, len, rng);
+        for (size_t j=0; j<len; ++j) {
+          const T x = a[i + j], y = b[i + j];
+          const T lo = std::min(x, y), d = std::max(x, y) - lo;
+          const T c = lo + (u[j] * (T(1) + T(2) * alpha) - alpha) * d;
+          dest[i + j] = std::min(std::max(c, lower), upper);
+        }
+      }
+    }
+
+    /// The step of polynomial mutation for a uniform u in (0,1)
+    template<typename T>
+    inline T polynomial_delta(const T u, const T exponent) {
+      return (u < T(0.5)) ?
+        std::pow(T(2) * u, exponent) - T(1) :
+        T(1) - std::pow(T(2) - T(2) * u, exponent);
+    }
+
+    /// The value of a standard normal from two uniforms in (0,1)
+    template<typename T>
+    inline T box_muller(const T u, const T v) {
+      return std::sqrt(T(-2) * std::log(u)) *
+        std::cos(T(6.283185307179586) * v);
+    }
+
+    /**
+     * Polynomial mutation of n values of x, with distribution index
+     * eta, every value mutated with probability prob
+     *
+     * Steps are scaled by upper - lower and values are clamped to
+     * [lower,upper]. Below 0.05 probability, the gap between mutated
+     * values is drawn from a geometric distribution, so the cost is
+     * proportional to the number of mutations; otherwise whole blocks
+     * are computed and masked.
+     */
+    template<typename T, typename RNG>
+    void polynomial_mutate(T *x, const size_t n, const float prob, const T eta,
+                           const T lower, const T upper, RNG &rng) {
+      if (prob <= 0.0f || n == 0u) return;
+      const T exponent = T(1) / (eta + T(1));
+      const T range = upper - lower;
+      if (prob > 0.05f) {
+        const T p = static_cast<T>(prob);
+        T u[REAL_BLOCK], m[REAL_BLOCK];
+        for (size_t i=0; i<n; i+=REAL_BLOCK) {
+          const size_t len = std::min(REAL_BLOCK, n - i);
+          uniform_reals(u, len, rng);
+          uniform_reals(m, len, rng);
+          for (size_t j=0; j<len; ++j) {
+            const T step = (m[j] < p) ? polynomial_delta(u[j], exponent) : T(0);
+            x[i + j] = std::min(std::max(x[i + j] + step * range, lower), upper);
+          }
+        }
+      }
+      else {
+        std::geometric_distribution<size_t> geo_dist(std::max(prob, 1e-12f));
+        size_t pos = geo_dist(rng);
+        while (pos < n) {
+          T u;
+          uniform_reals(&u, 1u, rng);
+          x[pos] = std::min(std::max(x[pos] + polynomial_delta(u, exponent) * range,
+                                     lower), upper);
+          const size_t gap = geo_dist(rng);
+          if (gap >= n - pos) break; // avoids overflow for huge gaps
+          pos += gap + 1u;
+        }
+      }
+    }
+
+    /**
+     * Gaussian mutation of n values of x, adding a normal step of
+     * standard deviation sigma to every value with probability prob
+     *
+     * Values are clamped to [lower,upper]. As polynomial_mutate(),
+     * low probabilities skip the values which don't mutate.
+     */
+    template<typename T, typename RNG>
+    void gaussian_mutate(T *x, const size_t n, const float prob, const T sigma,
+                         const T lower, const T upper, RNG &rng) {
+      if (prob <= 0.0f || n == 0u) return;
+      if (prob > 0.05f) {
+        const T p = static_cast<T>(prob);
+        T u[REAL_BLOCK], v[REAL_BLOCK], m[REAL_BLOCK];
+        for (size_t i=0; i<n; i+=REAL_BLOCK) {
+          const size_t len = std::min(REAL_BLOCK, n - i);
+          uniform_reals(u, len, rng);
+          uniform_reals(v, len, rng);
+          uniform_reals(m, len, rng);
+          for (size_t j=0; j<len; ++j) {
+            const T step = (m[j] < p) ? sigma * box_muller(u[j], v[j]) : T(0);
+            x[i + j] = std::min(std::max(x[i + j] + step, lower), upper);
+          }
+        }
+      }
+      else {
+        std::geometric_distribution<size_t> geo_dist(std::max(prob, 1e-12f));
+        size_t pos = geo_dist(rng);
+        while (pos < n) {
+          T uv[2];
+          uniform_reals(uv, 2u, rng);
+          x[pos] = std::min(std::max(x[pos] + sigma * box_muller(uv[0], uv[1]),
+                                     lower), upper);
+          const size_t gap = geo_dist(rng);
+          if (gap >= n - pos) break; // avoids overflow for huge gaps
+          pos += gap + 1u;
+        }
+      }
+    }
+
+  } // namespace kernels
+
+} // namespace GeneticAlgorithms
+
+#endif // REAL_KERNELS_H
@@ -0,0 +1,214 @@
+/*
+ * This file is part of GeneticAlgorithms toolkit
+ *
+ * Copyright 2017, Francisco Zamora-Martinez
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef REAL_VECTOR_H
+#define REAL_VECTOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "chromosome.h"
+#include "fitness_cache.h"
+
+namespace GeneticAlgorithms {
+
+  namespace detail {
+
+    /// A std::allocator replacement which aligns memory to cache lines
+    template<typename T>
+    struct AlignedAllocator {
+      typedef T value_type;
+      static const size_t ALIGNMENT = 64u;
+
+      template<typename U>
+      struct rebind {
+        typedef AlignedAllocator<U> other;
+      };
+
+      AlignedAllocator() {
+      }
+
+      template<typename U>
+      AlignedAllocator(const AlignedAllocator<U> &) {
+      }
+
+      T *allocate(const size_t n) {
+        void *p = 0;
+        if (posix_memalign(&p, ALIGNMENT, n * sizeof(T)) != 0) {
+          throw std::bad_alloc();
+        }
+        return static_cast<T*>(p);
+      }
+
+      void deallocate(T *p, size_t) {
+        std::free(p);
+      }
+    };
+
+    template<typename T, typename U>
+    bool operator==(const AlignedAllocator<T> &, const AlignedAllocator<U> &) {
+      return true;
+    }
+
+    template<typename T, typename U>
+    bool operator!=(const AlignedAllocator<T> &, const AlignedAllocator<U> &) {
+      return false;
+    }
+
+  } // namespace detail
+
+  /**
+   * A genome of N real values, float or double
+   *
+   * Values are stored in contiguous memory aligned to cache lines and
+   * padded with zeros to a whole number of lanes (64 bytes, 16 floats
+   * or 8 doubles), so rank functors read data() directly without
+   * decoding and the kernels of real_kernels.h work over full vector
+   * registers. Real operators (see BasicUniformRealInitializer,
+   * SimulatedBinaryCrossOver, BlendCrossOver, PolynomialMutate and
+   * GaussianMutate) keep the padding at zero.
+   *
+   * words() exposes the storage for the parts of the library which
+   * copy genomes as raw memory (checkpoints, rank_batch matrices).
+   * Words shouldn't be read as integers, use data().
+   *
+   * FloatVector and DoubleVector can be the Genome argument of
+   * Population and of the solvers, which take it from the
+   * initializer.
+   */
+  template<typename T>
+  class BasicRealVector {
+  public:
+    typedef std::pair<BasicRealVector, BasicRealVector > Couple;
+    typedef T value_type;
+
+    /// Number of values of every cache line
+    static const size_t LANES = 64u / sizeof(T);
+
+    /// Builds a vector of N zeros
+    explicit BasicRealVector(const size_t N) :
+      _values(paddedSize(N), T(0)),
+      _size(N) {
+    }
+
+    BasicRealVector(const std::vector<T> &values) :
+      _values(values.begin(), values.end()),
+      _size(values.size()) {
+      _values.resize(paddedSize(_size), T(0));
+    }
+
+    BasicRealVector() :
+      _size(0u) {
+    }
+
+    T operator[](const size_t i) const {
+      return _values[i];
+    }
+
+    size_t size() const {
+      return _size;
+    }
+
+    const T *data() const {
+      return _values.data();
+    }
+
+    T *data() {
+      return _values.data();
+    }
+
+    /// returns a copy of the values
+    std::vector<T> values() const {
+      return std::vector<T>(_values.begin(), _values.begin() + _size);
+    }
+
+    size_t numWords() const {
+      return _values.size() * sizeof(T) / sizeof(word_type);
+    }
+
+    const word_type *words() const {
+      return reinterpret_cast<const word_type*>(_values.data());
+    }
+
+    word_type *words() {
+      return reinterpret_cast<word_type*>(_values.data());
+    }
+
+    void set(const size_t i, const T value) {
+      _values[i] = value;
+    }
+
+    /**
+     * Changes the number of values, new values are set to zero
+     *
+     * Memory is only allocated when the vector grows over its
+     * previous capacity, so genetic operators use this method to
+     * write into reused vectors.
+     */
+    void resize(const size_t N) {
+      _values.resize(paddedSize(N), T(0));
+      // values left in the last lanes become padding
+      for (size_t i=N; i<_values.size(); ++i) _values[i] = T(0);
+      _size = N;
+    }
+
+  private:
+    std::vector<T, detail::AlignedAllocator<T> > _values;
+    size_t _size;
+
+    static size_t paddedSize(const size_t N) {
+      return LANES * ((N + LANES - 1u) / LANES);
+    }
+  }; // class BasicRealVector
+
+  template<typename T>
+  const size_t BasicRealVector<T>::LANES;
+
+  typedef BasicRealVector<float> FloatVector;
+  typedef BasicRealVector<double> DoubleVector;
+
+  /// genome_hash() of a real vector, its words are copied out of the values
+  template<typename T>
+  uint64_t genome_hash(const BasicRealVector<T> &x) {
+    uint64_t h = mix_hash(x.size() ^ 0x9e3779b97f4a7c15ULL);
+    const char *bytes = reinterpret_cast<const char*>(x.data());
+    for (size_t i=0; i<x.numWords(); ++i) {
+      word_type w;
+      std::memcpy(&w, bytes + i * sizeof(word_type), sizeof(word_type));
+      h = mix_hash(h ^ w) + 0x9e3779b97f4a7c15ULL;
+    }
+    return h;
+  }
+
+} // namespace GeneticAlgorithms
+
+#endif // REAL_VECTOR_H
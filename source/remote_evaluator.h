@@ -0,0 +1,583 @@
+/*
+ * This file is part of GeneticAlgorithms toolkit
+ *
+ * Copyright 2017, Francisco Zamora-Martinez
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef REMOTE_EVALUATOR_H
+#define REMOTE_EVALUATOR_H
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "chromosome.h"
+#include "operator_traits.h"
+#include "thread_pool.h"
+
+namespace GeneticAlgorithms {
+
+  /**
+   * Master-worker protocol of RemoteEvaluator and RankServer
+   *
+   * Messages go over TCP using the byte order of the hosts, which
+   * should be the same for all of them:
+   *
+   * - Request: header {uint32 magic, uint32 count, uint64 num_words}
+   *   followed by count rows {uint64 id, word_type words[num_words]},
+   *   the raw words of every Chromosome. count = 0 closes the
+   *   session.
+   *
+   * - Response: header {uint32 magic, uint32 count} followed by count
+   *   rows {uint64 id, double rank}.
+   */
+  namespace wire {
+
+    static const uint32_t REQUEST_MAGIC = 0x47415251u;  // "GARQ"
+    static const uint32_t RESPONSE_MAGIC = 0x47415253u; // "GARS"
+    static const size_t REQUEST_HEADER_BYTES = 16u;
+    static const size_t RESPONSE_HEADER_BYTES = 8u;
+    static const size_t RESPONSE_ROW_BYTES = 16u;
+
+    /// Writes all bytes, throws std::runtime_error on failure
+    inline void write_all(const int fd, const void *data, size_t n) {
+      const char *p = static_cast<const char*>(data);
+      while (n > 0u) {
+        const ssize_t k = ::send(fd, p, n, MSG_NOSIGNAL);
+        if (k < 0 && errno == EINTR) continue;
+        if (k <= 0) throw std::runtime_error(std::string("send: ") +
+                                             std::strerror(errno));
+        p += k;
+        n -= static_cast<size_t>(k);
+      }
+    }
+
+    /**
+     * Reads all bytes, returns false if the peer closed the connection
+     * before the first byte, throws std::runtime_error otherwise
+     */
+    inline bool read_all(const int fd, void *data, size_t n) {
+      char *p = static_cast<char*>(data);
+      bool first = true;
+      while (n > 0u) {
+        const ssize_t k = ::recv(fd, p, n, 0);
+        if (k < 0 && errno == EINTR) continue;
+        if (k == 0 && first) return false;
+        if (k <= 0) throw std::runtime_error("recv: connection lost");
+        first = false;
+        p += k;
+        n -= static_cast<size_t>(k);
+      }
+      return true;
+    }
+
+    template<typename X>
+    void put(std::vector<char> &buffer, const X &x) {
+      const char *p = reinterpret_cast<const char*>(&x);
+      buffer.insert(buffer.end(), p, p + sizeof(X));
+    }
+
+    template<typename X>
+    X get(const char *p) {
+      X x;
+      std::memcpy(&x, p, sizeof(X));
+      return x;
+    }
+
+    inline void set_no_delay(const int fd) {
+      int one = 1;
+      ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    /// Connects to host:port, throws std::runtime_error on failure
+    inline int connect_to(const std::string &host, const uint16_t port) {
+      addrinfo hints;
+      std::memset(&hints, 0, sizeof(hints));
+      hints.ai_family = AF_UNSPEC;
+      hints.ai_socktype = SOCK_STREAM;
+      addrinfo *list = 0;
+      const std::string service = std::to_string(port);
+      const int err = ::getaddrinfo(host.c_str(), service.c_str(), &hints, &list);
+      if (err != 0) {
+        throw std::runtime_error("getaddrinfo " + host + ": " + gai_strerror(err));
+      }
+      int fd = -1;
+      for (addrinfo *a = list; a && fd < 0; a = a->ai_next) {
+        fd = ::socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd < 0) continue;
+        if (::connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+          ::close(fd);
+          fd = -1;
+        }
+      }
+      ::freeaddrinfo(list);
+      if (fd < 0) {
+        throw std::runtime_error("cannot connect to " + host + ":" + service);
+      }
+      set_no_delay(fd);
+      return fd;
+    }
+
+  } // namespace wire
+
+  /// host and port of a RankServer
+  struct WorkerAddress {
+    std::string host;
+    uint16_t port;
+
+    WorkerAddress(const std::string &host, const uint16_t port) :
+      host(host), port(port) {
+    }
+  };
+
+  /**
+   * An asynchronous evaluator which ranks Chromosomes on remote
+   * RankServer workers
+   *
+   * submit() queues the raw words of the Chromosome and returns a
+   * future of its rank. Every worker connection has a sender thread,
+   * which takes up to batch_size queued Chromosomes per message while
+   * less than window of them are pending at that worker, and a
+   * receiver thread, which fulfills the futures. So faster workers
+   * take more work, and up to window Chromosomes per worker are in
+   * flight to hide the network latency.
+   *
+   * When a worker connection fails, its pending Chromosomes are
+   * queued again for the rest of workers. When no worker is left,
+   * futures receive a std::runtime_error. The destructor closes all
+   * sessions without waiting for pending ranks.
+   *
+   * @code
+   * std::vector<WorkerAddress> workers;
+   * workers.push_back(WorkerAddress("node01", 7000u));
+   * workers.push_back(WorkerAddress("node02", 7000u));
+   * RemoteEvaluator<> evaluator(workers, 16u, 4u);
+   * std::future<float> rank = evaluator.submit(x);
+   * @endcode
+   */
+  template<typename Genome = Chromosome, typename T = float>
+  class RemoteEvaluator {
+  public:
+    RemoteEvaluator(const std::vector<WorkerAddress> &workers,
+                    const size_t window=16u,
+                    const size_t batch_size=4u) :
+      _window(std::max(window, size_t(1u))),
+      _batch_size(std::max(batch_size, size_t(1u))),
+      _next_id(0u),
+      _alive(0u),
+      _stop(false) {
+      try {
+        for (const WorkerAddress &w : workers) {
+          std::unique_ptr<Connection> c(new Connection());
+          c->fd = wire::connect_to(w.host, w.port);
+          _connections.push_back(std::move(c));
+        }
+      }
+      catch (...) {
+        // the destructor won't run, so the open connections are closed here
+        for (auto &c : _connections) ::close(c->fd);
+        throw;
+      }
+      _alive = _connections.size();
+      for (auto &c : _connections) {
+        Connection *conn = c.get();
+        conn->sender = std::thread([this, conn]{ sendLoop(*conn); });
+        conn->receiver = std::thread([this, conn]{ receiveLoop(*conn); });
+      }
+    }
+
+    ~RemoteEvaluator() {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+      }
+      _cv.notify_all();
+      for (auto &c : _connections) c->sender.join();
+      for (auto &c : _connections) {
+        ::shutdown(c->fd, SHUT_RDWR);
+        c->receiver.join();
+        ::close(c->fd);
+      }
+    }
+
+    RemoteEvaluator(const RemoteEvaluator &) = delete;
+    RemoteEvaluator &operator=(const RemoteEvaluator &) = delete;
+
+    /// Queues the words of x and returns the future of its rank
+    std::future<T> submit(const Genome &x) {
+      Job job;
+      job.words.assign(x.words(), x.words() + x.numWords());
+      std::future<T> future = job.promise.get_future();
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        job.id = _next_id++;
+        if (_alive == 0u) {
+          job.promise.set_exception(std::make_exception_ptr
+                                    (std::runtime_error("no worker left")));
+          return future;
+        }
+        _pending.push_back(std::move(job));
+      }
+      _cv.notify_all();
+      return future;
+    }
+
+    /// Number of live worker connections
+    size_t workers() const {
+      std::lock_guard<std::mutex> lock(_mutex);
+      return _alive;
+    }
+
+  private:
+    struct Job {
+      uint64_t id;
+      std::vector<word_type> words;
+      std::promise<T> promise;
+    };
+
+    struct Connection {
+      int fd;
+      bool alive;
+      /// jobs sent to this worker, by id
+      std::unordered_map<uint64_t, Job> in_flight;
+      std::thread sender;
+      std::thread receiver;
+
+      Connection() : fd(-1), alive(true) {
+      }
+    };
+
+    const size_t _window;
+    const size_t _batch_size;
+    uint64_t _next_id;
+    size_t _alive;
+    bool _stop;
+    mutable std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<Job> _pending;
+    std::vector<std::unique_ptr<Connection> > _connections;
+
+    void sendLoop(Connection &c) {
+      std::vector<char> buffer;
+      for (;;) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [this, &c]{
+            return _stop || !c.alive ||
+              (!_pending.empty() && c.in_flight.size() < _window);
+          });
+        if (_stop || !c.alive) break;
+        // a message holds rows of the same number of words
+        const uint64_t num_words = _pending.front().words.size();
+        const size_t max_rows = std::min(_batch_size, _window - c.in_flight.size());
+        buffer.clear();
+        wire::put(buffer, wire::REQUEST_MAGIC);
+        wire::put(buffer, uint32_t(0u));
+        wire::put(buffer, num_words);
+        uint32_t count = 0u;
+        while (count < max_rows && !_pending.empty() &&
+               _pending.front().words.size() == num_words) {
+          Job &job = _pending.front();
+          wire::put(buffer, job.id);
+          const char *w = reinterpret_cast<const char*>(job.words.data());
+          buffer.insert(buffer.end(), w, w + num_words * sizeof(word_type));
+          const uint64_t id = job.id;
+          c.in_flight.insert(std::make_pair(id, std::move(job)));
+          _pending.pop_front();
+          ++count;
+        }
+        std::memcpy(&buffer[4], &count, sizeof(count));
+        lock.unlock();
+        try {
+          wire::write_all(c.fd, buffer.data(), buffer.size());
+        }
+        catch (const std::exception &) {
+          // the receiver finds the broken connection
+          ::shutdown(c.fd, SHUT_RDWR);
+          return;
+        }
+      }
+      // closes the session, the worker waits for another master
+      buffer.clear();
+      wire::put(buffer, wire::REQUEST_MAGIC);
+      wire::put(buffer, uint32_t(0u));
+      wire::put(buffer, uint64_t(0u));
+      try {
+        wire::write_all(c.fd, buffer.data(), buffer.size());
+      }
+      catch (const std::exception &) {
+      }
+    }
+
+    void receiveLoop(Connection &c) {
+      std::vector<char> rows;
+      try {
+        char header[wire::RESPONSE_HEADER_BYTES];
+        while (wire::read_all(c.fd, header, sizeof(header))) {
+          if (wire::get<uint32_t>(header) != wire::RESPONSE_MAGIC) {
+            throw std::runtime_error("bad response from worker");
+          }
+          const uint32_t count = wire::get<uint32_t>(header + 4);
+          {
+            // a worker can't answer more Chromosomes than it was sent,
+            // which also bounds the buffer
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (count > c.in_flight.size()) {
+              throw std::runtime_error("bad response from worker");
+            }
+          }
+          rows.resize(count * wire::RESPONSE_ROW_BYTES);
+          if (count > 0u && !wire::read_all(c.fd, rows.data(), rows.size())) {
+            throw std::runtime_error("recv: connection lost");
+          }
+          std::lock_guard<std::mutex> lock(_mutex);
+          for (uint32_t r=0; r<count; ++r) {
+            const char *row = rows.data() + r * wire::RESPONSE_ROW_BYTES;
+            auto it = c.in_flight.find(wire::get<uint64_t>(row));
+            if (it == c.in_flight.end()) continue;
+            it->second.promise.set_value(static_cast<T>(wire::get<double>(row + 8)));
+            c.in_flight.erase(it);
+          }
+          _cv.notify_all();
+        }
+      }
+      catch (const std::exception &) {
+      }
+      std::lock_guard<std::mutex> lock(_mutex);
+      c.alive = false;
+      --_alive;
+      // pending jobs go back to the queue, unless nobody can take them
+      for (auto &kv : c.in_flight) _pending.push_front(std::move(kv.second));
+      c.in_flight.clear();
+      if (_alive == 0u || _stop) {
+        for (Job &job : _pending) {
+          job.promise.set_exception(std::make_exception_ptr
+                                    (std::runtime_error("no worker left")));
+        }
+        _pending.clear();
+      }
+      _cv.notify_all();
+    }
+  }; // class RemoteEvaluator
+
+  /**
+   * The worker side of RemoteEvaluator, it ranks Chromosomes received
+   * from masters
+   *
+   * The server listens on the given port (zero picks a free one, see
+   * port()) and serve() handles one master session after another.
+   * Every message is ranked as a whole: by RankFunctor::rank_batch
+   * directly over the received words when it has one (see
+   * has_batch_rank), otherwise rebuilding Chromosomes of num_gens gens
+   * which are ranked in parallel by num_threads threads.
+   *
+   * Requests are checked before any memory is allocated for them: a
+   * request whose rows don't have the words of num_gens gens, or with
+   * more than max_rows rows, closes the session.
+   *
+   * @code
+   * // worker program, runs on every node
+   * RankServer server(7000u);
+   * server.serve(MyRank(), N, ThreadPool::defaultSize());
+   * @endcode
+   */
+  class RankServer {
+  public:
+    /// default maximum number of rows of a request
+    static const size_t MAX_ROWS = 1u << 16;
+
+    explicit RankServer(const uint16_t port, const size_t max_rows=MAX_ROWS) :
+      _max_rows(max_rows) {
+      _fd = ::socket(AF_INET, SOCK_STREAM, 0);
+      if (_fd < 0) throw std::runtime_error("socket: cannot create");
+      int one = 1;
+      ::setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+      sockaddr_in addr;
+      std::memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl(INADDR_ANY);
+      addr.sin_port = htons(port);
+      if (::bind(_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+          ::listen(_fd, 16) != 0) {
+        ::close(_fd);
+        throw std::runtime_error("cannot listen on port " + std::to_string(port));
+      }
+    }
+
+    ~RankServer() {
+      ::close(_fd);
+    }
+
+    RankServer(const RankServer &) = delete;
+    RankServer &operator=(const RankServer &) = delete;
+
+    /// The port the server listens on
+    uint16_t port() const {
+      sockaddr_in addr;
+      socklen_t len = sizeof(addr);
+      ::getsockname(_fd, reinterpret_cast<sockaddr*>(&addr), &len);
+      return ntohs(addr.sin_port);
+    }
+
+    /**
+     * Serves max_sessions master sessions (zero means forever),
+     * returning the number of ranked Chromosomes
+     *
+     * A session which fails is closed, and the server waits for the
+     * next one.
+     */
+    template<typename Genome = Chromosome, typename T = float,
+             typename RankFunctor>
+    size_t serve(const RankFunctor &rank_func, const size_t num_gens,
+                 const size_t num_threads=1u, const size_t max_sessions=0u) {
+      ThreadPool pool(num_threads);
+      size_t ranked = 0u;
+      for (size_t s=0; max_sessions == 0u || s < max_sessions; ++s) {
+        const int fd = ::accept(_fd, 0, 0);
+        if (fd < 0) {
+          if (errno == EINTR) { --s; continue; }
+          throw std::runtime_error("accept: failed");
+        }
+        wire::set_no_delay(fd);
+        try {
+          ranked += session<Genome, T>(fd, rank_func, num_gens, pool);
+        }
+        catch (const std::exception &) {
+        }
+        ::close(fd);
+      }
+      return ranked;
+    }
+
+  private:
+    int _fd;
+    const size_t _max_rows;
+
+    template<typename Genome, typename T, typename RankFunctor>
+    size_t session(const int fd, const RankFunctor &rank_func,
+                   const size_t num_gens, ThreadPool &pool) {
+      typedef std::integral_constant<bool, has_batch_rank<RankFunctor, T>::value> batch_t;
+      std::vector<char> rows, reply;
+      std::vector<word_type> matrix;
+      std::vector<uint64_t> ids;
+      std::vector<T> ranks;
+      std::vector<Genome> genomes;
+      // any genome type, not only bitsets, gives its own row size
+      const size_t expected_words = Genome(num_gens).numWords();
+      size_t ranked = 0u;
+      char header[wire::REQUEST_HEADER_BYTES];
+      while (wire::read_all(fd, header, sizeof(header))) {
+        if (wire::get<uint32_t>(header) != wire::REQUEST_MAGIC) {
+          throw std::runtime_error("bad request from master");
+        }
+        const uint32_t count = wire::get<uint32_t>(header + 4);
+        const uint64_t num_words = wire::get<uint64_t>(header + 8);
+        if (count == 0u) break;
+        // rows are 8 + num_words * sizeof(word_type) bytes, check its
+        // product by count can't overflow before resizing
+        const size_t max_size = std::numeric_limits<size_t>::max();
+        if (num_words != expected_words || count > _max_rows ||
+            num_words > (max_size / count - 8u) / sizeof(word_type)) {
+          throw std::runtime_error("bad request header from master");
+        }
+        const size_t row_bytes = 8u + num_words * sizeof(word_type);
+        rows.resize(count * row_bytes);
+        if (!wire::read_all(fd, rows.data(), rows.size())) {
+          throw std::runtime_error("recv: connection lost");
+        }
+        ids.resize(count);
+        matrix.resize(count * num_words);
+        for (uint32_t r=0; r<count; ++r) {
+          const char *row = rows.data() + r * row_bytes;
+          ids[r] = wire::get<uint64_t>(row);
+          std::memcpy(matrix.data() + r * num_words, row + 8,
+                      num_words * sizeof(word_type));
+        }
+        ranks.resize(count);
+        rankRows<Genome>(rank_func, matrix, num_words, count, num_gens, pool,
+                         genomes, ranks, batch_t());
+        reply.clear();
+        wire::put(reply, wire::RESPONSE_MAGIC);
+        wire::put(reply, count);
+        for (uint32_t r=0; r<count; ++r) {
+          wire::put(reply, ids[r]);
+          wire::put(reply, static_cast<double>(ranks[r]));
+        }
+        wire::write_all(fd, reply.data(), reply.size());
+        ranked += count;
+      }
+      return ranked;
+    }
+
+    template<typename Genome, typename RankFunctor, typename T>
+    void rankRows(const RankFunctor &rank_func,
+                  const std::vector<word_type> &matrix,
+                  const size_t num_words, const size_t count,
+                  const size_t, ThreadPool &,
+                  std::vector<Genome> &, std::vector<T> &ranks,
+                  std::true_type) {
+      rank_func.rank_batch(matrix.data(), num_words, count, ranks.data());
+    }
+
+    template<typename Genome, typename RankFunctor, typename T>
+    void rankRows(const RankFunctor &rank_func,
+                  const std::vector<word_type> &matrix,
+                  const size_t num_words, const size_t count,
+                  const size_t num_gens, ThreadPool &pool,
+                  std::vector<Genome> &genomes, std::vector<T> &ranks,
+                  std::false_type) {
+      if (genomes.size() < count) genomes.resize(count, Genome(num_gens));
+      const word_type *words = matrix.data();
+      Genome *g = genomes.data();
+      T *out = ranks.data();
+      pool.parallelFor(count, [&rank_func, words, num_words, g, out](size_t r) {
+          const size_t n = std::min(num_words, g[r].numWords());
+          std::memcpy(g[r].words(), words + r * num_words, n * sizeof(word_type));
+          out[r] = rank_genome<T>(rank_func, g[r]);
+        });
+    }
+  }; // class RankServer
+
+} // namespace GeneticAlgorithms
+
+#endif // REMOTE_EVALUATOR_H
@@ -29,8 +29,11 @@
 #define SELECTIONS_H
 
 #include <algorithm>
+#include <cmath>
 #include <functional>
+#include <istream>
 #include <numeric>
+#include <ostream>
 #include <random>
 #include <vector>
 
@@ -38,17 +41,133 @@
 
 namespace GeneticAlgorithms {
 
+  /**
+   * Walker/Vose alias table for sampling from a discrete distribution
+   *
+   * The table is built in O(n) from non-negative weights, and every
+   * sample costs O(1): one uniform integer and one uniform real. The
+   * internal vectors are reused, so rebuilding the table with the
+   * same number of weights doesn't allocate memory. When all weights
+   * are zero the distribution is uniform.
+   */
+  class AliasTable {
+  public:
+    AliasTable() {
+    }
+
+    /// Builds the table for weights in range [first, first+n)
+    template<typename T>
+    void build(const T *weights, const size_t n) {
+      _prob.resize(n);
+      _alias.resize(n);
+      _small.clear();
+      _large.clear();
+      // both lists can take the n positions, whatever their split
+      _small.reserve(n);
+      _large.reserve(n);
+      if (n == 0u) return;
+      double sum = 0.0;
+      for (size_t i=0; i<n; ++i) sum += static_cast<double>(weights[i]);
+      if (!(sum > 0.0)) {
+        std::fill(_prob.begin(), _prob.end(), 1.0);
+        for (size_t i=0; i<n; ++i) _alias[i] = i;
+        return;
+      }
+      const double scale = static_cast<double>(n) / sum;
+      for (size_t i=0; i<n; ++i) {
+        _prob[i] = static_cast<double>(weights[i]) * scale;
+        if (_prob[i] < 1.0) _small.push_back(i);
+        else _large.push_back(i);
+      }
+      while (!_small.empty() && !_large.empty()) {
+        const size_t s = _small.back(); _small.pop_back();
+        const size_t l = _large.back();
+        _alias[s] = l;
+        _prob[l] = (_prob[l] + _prob[s]) - 1.0;
+        if (_prob[l] < 1.0) {
+          _large.pop_back();
+          _small.push_back(l);
+        }
+      }
+      // remaining ones have probability 1 up to rounding errors
+      for (size_t i : _large) { _prob[i] = 1.0; _alias[i] = i; }
+      for (size_t i : _small) { _prob[i] = 1.0; _alias[i] = i; }
+    }
+
+    size_t size() const {
+      return _prob.size();
+    }
+
+    /// Draws one position using the given random generator
+    template<typename RNG>
+    size_t operator()(RNG &rng) const {
+      std::uniform_int_distribution<size_t> column(0u, _prob.size() - 1u);
+      std::uniform_real_distribution<double> coin(0.0, 1.0);
+      const size_t i = column(rng);
+      return (coin(rng) < _prob[i]) ? i : _alias[i];
+    }
+
+  private:
+    std::vector<double> _prob;
+    std::vector<size_t> _alias;
+    std::vector<size_t> _small;
+    std::vector<size_t> _large;
+  }; // class AliasTable
+
+  namespace detail {
+
+    /**
+     * Implements the legacy selection interface, which receives a
+     * population and returns copies of the selected couples, on top
+     * of the one which fills a vector of IndexCouple
+     */
+    template<typename SelectionFunctor, typename Genome, typename T>
+    std::vector<typename Genome::Couple>
+    select_couples(const SelectionFunctor &select_func,
+                   const std::vector<std::pair<Genome, T> > &pop,
+                   const size_t result_size) {
+      std::vector<T> ranks(pop.size());
+      // extract all ranks from pop vector
+      std::transform(pop.begin(), pop.end(), ranks.begin(),
+                     [](const std::pair<Genome, T> &x){ return x.second; });
+      std::vector<IndexCouple> indices(result_size);
+      select_func(ranks, indices);
+      // generate a vector of couples by copying the selected ones
+      std::vector<typename Genome::Couple> result;
+      result.reserve(result_size);
+      for (const IndexCouple &c : indices) {
+        result.push_back(std::make_pair(pop[c.first].first,
+                                        pop[c.second].first));
+      }
+      return result;
+    }
+
+  } // namespace detail
+
   /**
    * A class which selects population subjects based on their rank
    *
    * A multinomial distribution is build by normalizing subjects
-   * rank, and this distribution is sampled for couple selection.
+   * rank, and this distribution is sampled for couple selection. When
+   * some rank is negative, all of them are translated by the minimum.
+   *
+   * The distribution is stored in an AliasTable built once per
+   * selection, so sampling every parent costs O(1). The preferred
+   * interface receives only the ranks and produces IndexCouple
+   * (positions of parents in the population), so no Chromosome is
+   * copied. The table can also be prepared once and sampled with
+   * external random generators by using prepare() and sample().
+   *
+   * The RNG template argument is the internal random generator (see
+   * random.h). Once prepared, sample() only reads the table, so
+   * different threads can sample concurrently with their own
+   * generators.
    *
    * ATTENTION: this class is not thread safe, if you need to use it
    * on different threads, be sure each thread receives a different
    * instance.
    */
-  template<typename T>
+  template<typename T, typename RNG = std::mt19937_64>
   class RouletteWheelSelection {
   public:
 
@@ -57,41 +176,281 @@ namespace GeneticAlgorithms {
       _rng(seed) {
     }
 
-    /// This functor receives a population and returns selected couples
-    std::vector<typename Chromosome::Couple>
-    operator()(const std::vector<std::pair<Chromosome, T> > pop,
-               size_t result_size) const {
-      std::vector<float> ranks(pop.size());
-      // extract all ranks from pop vector
-      std::transform(pop.begin(), pop.end(), ranks.begin(),
-                     [](const std::pair<Chromosome, T> &x){ return x.second; });
+    /// Restarts the random generator with the given seed
+    void seed(unsigned seed) {
+      _rng.seed(seed);
+    }
+
+    /// Writes the state of the random generator, see save_state()
+    void saveState(std::ostream &os) const {
+      os << _rng << ' ';
+    }
+
+    /// Restores a state written by saveState()
+    void loadState(std::istream &is) const {
+      is >> _rng;
+    }
+
+    /// Builds the distribution for the given n ranks
+    void prepare(const T *ranks, const size_t n) const {
+      _weights.assign(ranks, ranks + n);
       // the minimum would be used to check if all ranks are positive
-      float min = *std::min_element(ranks.begin(), ranks.end());
-      if (min < 0.0f) {
+      const T min = (n > 0u) ? *std::min_element(ranks, ranks + n) : T();
+      if (min < T()) {
         // if non positive ranks, translate them using -min
-	std::transform(ranks.begin(), ranks.end(), ranks.begin(),
-		       [min](float x){ return x - min; });
+        for (T &w : _weights) w -= min;
       }
+      _table.build(_weights.data(), n);
+    }
 
-      // the multinomial distribution is computed here
-      std::discrete_distribution<int> distribution(ranks.begin(), ranks.end());
+    /// Samples the position of one parent from the prepared distribution
+    template<typename URNG>
+    size_t sample(URNG &rng) const {
+      return _table(rng);
+    }
+
+    /**
+     * Fills result with couples sampled from the given ranks
+     *
+     * The number of couples is given by result.size().
+     */
+    void operator()(const std::vector<T> &ranks,
+                    std::vector<IndexCouple> &result) const {
+      (*this)(ranks, result, _rng);
+    }
 
-      // generate a vector of couples by sampling from distribution
-      std::vector<typename Chromosome::Couple> result(result_size);
+    /// As the previous one, drawing random numbers from rng
+    template<typename URNG>
+    void operator()(const std::vector<T> &ranks,
+                    std::vector<IndexCouple> &result, URNG &rng) const {
+      prepare(ranks.data(), ranks.size());
       for (auto it = result.begin(); it != result.end(); ++it) {
-        size_t x_pos = distribution(_rng);
-        size_t y_pos = distribution(_rng);
-        *it = std::make_pair(pop[x_pos].first, pop[y_pos].first);
+        it->first = sample(rng);
+        it->second = sample(rng);
       }
+    }
 
-      return result;
+    /// This functor receives a population and returns selected couples
+    template<typename Genome>
+    std::vector<typename Genome::Couple>
+    operator()(const std::vector<std::pair<Genome, T> > &pop,
+               size_t result_size) const {
+      return detail::select_couples(*this, pop, result_size);
     }
+
   private:
-    mutable std::mt19937_64 _rng;
+    mutable RNG _rng;
+    mutable std::vector<T> _weights;
+    mutable AliasTable _table;
   };
 
   typedef RouletteWheelSelection<float> FloatRouletteWheelSelection;
   typedef RouletteWheelSelection<double> DoubleRouletteWheelSelection;
+
+  /**
+   * A class which selects every parent as the best of k subjects
+   * drawn uniformly at random (with replacement)
+   *
+   * Only the order of ranks matters, so they don't need to be
+   * positive nor normalized, and populations where all ranks are
+   * equal are sampled uniformly. Every parent costs k random numbers
+   * and k reads of the ranks, prepare() is O(1) and doesn't scan the
+   * population. Greater values of k increase the selection pressure,
+   * k=1 is a uniform selection. Ties are won by the first drawn
+   * subject.
+   *
+   * prepare() keeps a pointer to the ranks, which must stay valid
+   * while sample() is used. sample() only reads the prepared state,
+   * so different threads can sample concurrently with their own
+   * random generators.
+   *
+   * ATTENTION: this class is not thread safe, if you need to use it
+   * on different threads, be sure each thread receives a different
+   * instance.
+   */
+  template<typename T, typename RNG = std::mt19937_64>
+  class TournamentSelection {
+  public:
+
+    /// Initializes the algorithm with the tournament size and a seed
+    TournamentSelection(const size_t k, unsigned seed) :
+      _k(std::max(k, size_t(1u))), _rng(seed), _ranks(0), _n(0u) {
+    }
+
+    /// Restarts the random generator with the given seed
+    void seed(unsigned seed) {
+      _rng.seed(seed);
+    }
+
+    /// Writes the state of the random generator, see save_state()
+    void saveState(std::ostream &os) const {
+      os << _rng << ' ';
+    }
+
+    /// Restores a state written by saveState()
+    void loadState(std::istream &is) const {
+      is >> _rng;
+    }
+
+    /// Prepares the selection for the given n ranks
+    void prepare(const T *ranks, const size_t n) const {
+      _ranks = ranks;
+      _n = n;
+    }
+
+    /// Samples the position of one parent among the prepared ranks
+    template<typename URNG>
+    size_t sample(URNG &rng) const {
+      std::uniform_int_distribution<size_t> subject(0u, _n - 1u);
+      size_t best = subject(rng);
+      for (size_t j=1u; j<_k; ++j) {
+        const size_t i = subject(rng);
+        if (_ranks[best] < _ranks[i]) best = i;
+      }
+      return best;
+    }
+
+    /**
+     * Fills result with couples sampled from the given ranks
+     *
+     * The number of couples is given by result.size().
+     */
+    void operator()(const std::vector<T> &ranks,
+                    std::vector<IndexCouple> &result) const {
+      (*this)(ranks, result, _rng);
+    }
+
+    /// As the previous one, drawing random numbers from rng
+    template<typename URNG>
+    void operator()(const std::vector<T> &ranks,
+                    std::vector<IndexCouple> &result, URNG &rng) const {
+      prepare(ranks.data(), ranks.size());
+      for (auto it = result.begin(); it != result.end(); ++it) {
+        it->first = sample(rng);
+        it->second = sample(rng);
+      }
+    }
+
+    /// This functor receives a population and returns selected couples
+    template<typename Genome>
+    std::vector<typename Genome::Couple>
+    operator()(const std::vector<std::pair<Genome, T> > &pop,
+               size_t result_size) const {
+      return detail::select_couples(*this, pop, result_size);
+    }
+
+  private:
+    const size_t _k;
+    mutable RNG _rng;
+    mutable const T *_ranks;
+    mutable size_t _n;
+  };
+
+  typedef TournamentSelection<float> FloatTournamentSelection;
+  typedef TournamentSelection<double> DoubleTournamentSelection;
+
+  /**
+   * A class which selects parents uniformly among the best fraction
+   * of the population
+   *
+   * prepare() finds the best ceil(fraction * n) subjects by using
+   * std::nth_element, in O(n) and without sorting, and every parent
+   * costs one random number. As for TournamentSelection only the
+   * order of ranks matters. Ties at the threshold are broken in an
+   * unspecified but deterministic way.
+   *
+   * ATTENTION: this class is not thread safe, if you need to use it
+   * on different threads, be sure each thread receives a different
+   * instance.
+   */
+  template<typename T, typename RNG = std::mt19937_64>
+  class TruncationSelection {
+  public:
+
+    /**
+     * Initializes the algorithm with the fraction of selectable
+     * subjects, in (0,1], and a seed
+     */
+    TruncationSelection(const double fraction, unsigned seed) :
+      _fraction(std::min(std::max(fraction, 0.0), 1.0)), _rng(seed),
+      _m(0u) {
+    }
+
+    /// Restarts the random generator with the given seed
+    void seed(unsigned seed) {
+      _rng.seed(seed);
+    }
+
+    /// Writes the state of the random generator, see save_state()
+    void saveState(std::ostream &os) const {
+      os << _rng << ' ';
+    }
+
+    /// Restores a state written by saveState()
+    void loadState(std::istream &is) const {
+      is >> _rng;
+    }
+
+    /// Finds the best subjects among the given n ranks
+    void prepare(const T *ranks, const size_t n) const {
+      _order.resize(n);
+      std::iota(_order.begin(), _order.end(), size_t(0u));
+      const double m = std::ceil(_fraction * static_cast<double>(n));
+      _m = std::min(std::max(static_cast<size_t>(m), size_t(1u)), n);
+      if (_m < n) {
+        std::nth_element(_order.begin(), _order.begin() + (_m - 1u),
+                         _order.end(), [ranks](size_t a, size_t b) {
+                           return ranks[b] < ranks[a];
+                         });
+      }
+    }
+
+    /// Samples the position of one parent among the best subjects
+    template<typename URNG>
+    size_t sample(URNG &rng) const {
+      std::uniform_int_distribution<size_t> subject(0u, _m - 1u);
+      return _order[subject(rng)];
+    }
+
+    /**
+     * Fills result with couples sampled from the given ranks
+     *
+     * The number of couples is given by result.size().
+     */
+    void operator()(const std::vector<T> &ranks,
+                    std::vector<IndexCouple> &result) const {
+      (*this)(ranks, result, _rng);
+    }
+
+    /// As the previous one, drawing random numbers from rng
+    template<typename URNG>
+    void operator()(const std::vector<T> &ranks,
+                    std::vector<IndexCouple> &result, URNG &rng) const {
+      prepare(ranks.data(), ranks.size());
+      for (auto it = result.begin(); it != result.end(); ++it) {
+        it->first = sample(rng);
+        it->second = sample(rng);
+      }
+    }
+
+    /// This functor receives a population and returns selected couples
+    template<typename Genome>
+    std::vector<typename Genome::Couple>
+    operator()(const std::vector<std::pair<Genome, T> > &pop,
+               size_t result_size) const {
+      return detail::select_couples(*this, pop, result_size);
+    }
+
+  private:
+    const double _fraction;
+    mutable RNG _rng;
+    /// positions of the population, the best _m first
+    mutable std::vector<size_t> _order;
+    mutable size_t _m;
+  };
+
+  typedef TruncationSelection<float> FloatTruncationSelection;
+  typedef TruncationSelection<double> DoubleTruncationSelection;
   
 } // namespace GeneticAlgorithms
 
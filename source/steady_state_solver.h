@@ -0,0 +1,372 @@
+/*
+ * This file is part of GeneticAlgorithms toolkit
+ *
+ * Copyright 2017, Francisco Zamora-Martinez
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef STEADY_STATE_SOLVER_H
+#define STEADY_STATE_SOLVER_H
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "chromosome.h"
+#include "genetic_solver.h"
+#include "indexed_heap.h"
+#include "instrumentation.h"
+#include "operator_traits.h"
+#include "population.h"
+#include "thread_pool.h"
+
+namespace GeneticAlgorithms {
+
+  /**
+   * Configuration of the steady state mode implemented by
+   * SteadyStateSolver, completing SolverOptions
+   */
+  struct SteadyStateOptions {
+    /// Chromosome which leaves the population for every child
+    enum Replacement {
+      /// the worst one of the population
+      REPLACE_WORST,
+      /// the worst one of tournament_size random ones
+      REPLACE_TOURNAMENT_LOSER
+    };
+
+    /// children produced, ranked and inserted at every step
+    size_t children_per_step;
+    Replacement replacement;
+    /// subjects of REPLACE_TOURNAMENT_LOSER tournaments
+    size_t tournament_size;
+
+    SteadyStateOptions() :
+      children_per_step(2u),
+      replacement(REPLACE_WORST),
+      tournament_size(2u) {
+    }
+  };
+
+  namespace detail {
+    /**
+     * The position of population which the next child replaces, given
+     * the IndexedHeap of its ranks, which finds the worst one
+     */
+    template<typename PopulationType, typename Heap>
+    size_t choose_victim(const SteadyStateOptions &options,
+                         const PopulationType &population,
+                         const Heap &worst, std::mt19937_64 &rng) {
+      if (options.replacement == SteadyStateOptions::REPLACE_WORST) {
+        return worst.top();
+      }
+      std::uniform_int_distribution<size_t> subject(0u, population.size() - 1u);
+      size_t victim = subject(rng);
+      for (size_t j=1u; j<options.tournament_size; ++j) {
+        const size_t i = subject(rng);
+        if (population.rank(i) < population.rank(victim)) victim = i;
+      }
+      return victim;
+    }
+  } // namespace detail
+
+  /**
+   * A steady state genetic algorithm: every step produces a few
+   * children which replace Chromosomes of the population in place
+   *
+   * The genetic operators are the ones described at solve(). At every
+   * step SteadyStateOptions::children_per_step couples are selected,
+   * crossed and mutated sequentially, and their children are ranked
+   * in parallel (by SolverOptions::num_threads), through the
+   * FitnessCache and rank_delta as in GeneticSolver. Then every child
+   * replaces the chosen victim, the worst Chromosome or a tournament
+   * loser, unless the child has a lower rank, so the best Chromosome
+   * is never lost. Improvements take part in the very next selection.
+   *
+   * Children take children_per_step slots of the back buffer of the
+   * population, instead of a whole generation, and the worst one is
+   * tracked by an IndexedHeap, so a replacement costs O(log n). As
+   * selection runs at every step, SelectionFunctor should prepare in
+   * O(1): TournamentSelection does, RouletteWheelSelection scans the
+   * ranks.
+   *
+   * The criteria of SolverOptions apply to steps instead of
+   * generations, num_iterations being the number of steps.
+   *
+   * @code
+   * SolverOptions options;
+   * options.num_iterations = 100000u;
+   * SteadyStateOptions steady;
+   * SteadyStateSolver<float, I, S, C, M, R> solver(options, steady,
+   *                                                 i, s, c, m, r);
+   * NullObserver observer;
+   * SolverResult<Chromosome, float> result = solver.run(observer);
+   * @endcode
+   */
+  template<typename T,
+           typename InitializerFunctor,
+           typename SelectionFunctor,
+           typename CrossOverFunctor,
+           typename MutationFunctor,
+           typename RankFunctor>
+  class SteadyStateSolver {
+  public:
+    typedef typename genome_of<InitializerFunctor>::type Genome;
+    typedef Population<RankFunctor, T, Genome> population_t;
+    typedef typename population_t::Hypothesis Hypothesis;
+
+    SteadyStateSolver(const SolverOptions &options,
+                      const SteadyStateOptions &steady_options,
+                      const InitializerFunctor &init_func,
+                      const SelectionFunctor &select_func,
+                      const CrossOverFunctor &cross_over_func,
+                      const MutationFunctor &mutate_func,
+                      const RankFunctor &rank_func) :
+      _options(options),
+      _steady_options(steady_options),
+      _init_func(init_func),
+      _select_func(select_func),
+      _cross_over_func(cross_over_func),
+      _mutate_func(mutate_func),
+      _pool(options.num_threads),
+      _population(rank_func),
+      _rng(options.seed),
+      _generation(0u),
+      _last_improvement(0u),
+      _evaluations(0u) {
+      _population.enableCache(options.cache_capacity);
+    }
+
+    /// Generates and ranks the initial population
+    void init() {
+      _population.reset();
+      _population.init(_init_func, _options.population_size, _pool);
+      _worst.build(_population.ranks().data(), _population.size());
+      _best = _population.top();
+      _generation = 0u;
+      _last_improvement = 0u;
+      _evaluations = _population.evaluations();
+      _start = std::chrono::steady_clock::now();
+    }
+
+    /**
+     * Runs init() and step() until a stopping criterion of
+     * SolverOptions is met
+     */
+    template<typename Observer>
+    SolverResult<Genome, T> run(Observer &observer) {
+      SolverResult<Genome, T> result;
+      init();
+      while (!stopped(result.reason)) {
+        step(observer);
+      }
+      result.best = _best.first;
+      result.rank = _best.second;
+      result.generations = _generation;
+      result.evaluations = _evaluations;
+      result.seconds = detail::seconds_since(_start);
+      return result;
+    }
+
+    /// Checks the stopping criteria, writing the reason when true
+    bool stopped(StopReason &reason) const {
+      return detail::check_stop(_options, _generation, _last_improvement,
+                                static_cast<double>(_best.second),
+                                _evaluations, _start, reason);
+    }
+
+    /// Produces, ranks and inserts the children of one step
+    void step() {
+      NullObserver observer;
+      step(observer);
+    }
+
+    /**
+     * As the previous one, giving the GenerationStats of the
+     * population to the observer
+     */
+    template<typename Observer>
+    void step(Observer &observer) {
+      PhaseTimer timer;
+      const size_t n = _steady_options.children_per_step;
+      _couples.resize(n);
+      _population.select(_select_func, _couples);
+      _stats.select_ns = timer.lap();
+      // children are written into the back buffer of the population,
+      // which ranks them as GeneticSolver does, before any replacement
+      _population.beginGeneration(n);
+      for (size_t j=0; j<n; ++j) {
+        detail::cross_child(_population, j, _couples[j],
+                            _cross_over_func, delta_t());
+      }
+      _stats.crossover_ns = timer.lap();
+      for (size_t j=0; j<n; ++j) {
+        detail::mutate_child(_population, j, _mutate_func, delta_t());
+      }
+      _stats.mutate_ns = timer.lap();
+      _population.rankGeneration(_pool);
+      _evaluations = _population.evaluations();
+      _stats.rank_ns = timer.lap();
+      for (size_t j=0; j<n; ++j) {
+        const T rank = _population.childRank(j);
+        const size_t victim = detail::choose_victim(_steady_options, _population,
+                                                    _worst, _rng);
+        if (rank < _population.rank(victim)) continue;
+        _population.replace(victim, _population.child(j), rank);
+        _worst.update(victim, rank);
+      }
+      ++_generation;
+      updateBest();
+      if (is_active_observer<Observer>::value) {
+        _stats.generation = _generation;
+        rank_statistics(_population, _stats);
+        _stats.diversity = detail::bit_diversity
+          (_population, _column_counter, _gen_counts,
+           std::integral_constant<bool, is_bit_genome<Genome>::value>());
+        _stats.cache_hits = _population.cacheHits();
+        _stats.cache_misses = _population.cacheMisses();
+        observer(static_cast<const GenerationStats<T>&>(_stats));
+      }
+    }
+
+    /// Number of steps since init()
+    size_t generation() const {
+      return _generation;
+    }
+
+    /// Number of calls to RankFunctor since init()
+    size_t evaluations() const {
+      return _evaluations;
+    }
+
+    /// The best Hypothesis found since init()
+    const Hypothesis &best() const {
+      return _best;
+    }
+
+    const population_t &population() const {
+      return _population;
+    }
+
+  private:
+    // incremental ranking needs the help of both functors
+    typedef std::integral_constant<bool,
+      population_t::SUPPORTS_DELTA &&
+      reports_flips<MutationFunctor, Genome>::value> delta_t;
+
+    const SolverOptions _options;
+    const SteadyStateOptions _steady_options;
+    const InitializerFunctor &_init_func;
+    const SelectionFunctor &_select_func;
+    const CrossOverFunctor &_cross_over_func;
+    const MutationFunctor &_mutate_func;
+    ThreadPool _pool;
+    population_t _population;
+    /// min-heap over the ranks of the population
+    IndexedHeap<T> _worst;
+    Hypothesis _best;
+    std::vector<IndexCouple> _couples;
+    std::mt19937_64 _rng;
+    size_t _generation;
+    size_t _last_improvement;
+    size_t _evaluations;
+    GenerationStats<T> _stats;
+    std::chrono::steady_clock::time_point _start;
+    /// buffers of population_diversity()
+    kernels::ColumnCounter _column_counter;
+    std::vector<size_t> _gen_counts;
+
+    void updateBest() {
+      const size_t top = _population.topIndex();
+      if (_best.second < _population.rank(top)) {
+        _best.first = _population.genome(top);
+        _best.second = _population.rank(top);
+        _last_improvement = _generation;
+      }
+    }
+  }; // class SteadyStateSolver
+
+  /**
+   * As evolve(), running a SteadyStateSolver
+   *
+   * @code
+   * SolverOptions options;
+   * options.num_iterations = 100000u;
+   * options.max_evaluations = 50000u;
+   * SteadyStateOptions steady;
+   * steady.replacement = SteadyStateOptions::REPLACE_TOURNAMENT_LOSER;
+   * SolverResult<Chromosome, float> result =
+   *   evolve_steady_state(options, steady, RandomInitializer(N, rng(), 0.5f),
+   *                       FloatTournamentSelection(2u, rng()),
+   *                       RandomSplitCrossOver(N, rng()),
+   *                       RandomMutate(rng(), 0.01f), MyRank());
+   * @endcode
+   */
+  template<typename T=float,
+           typename InitializerFunctor,
+           typename SelectionFunctor,
+           typename CrossOverFunctor,
+           typename MutationFunctor,
+           typename RankFunctor,
+           typename Observer>
+  SolverResult<typename genome_of<InitializerFunctor>::type, T>
+  evolve_steady_state(const SolverOptions &options,
+                      const SteadyStateOptions &steady_options,
+                      const InitializerFunctor &init_func,
+                      const SelectionFunctor &select_func,
+                      const CrossOverFunctor &cross_over_func,
+                      const MutationFunctor &mutate_func,
+                      const RankFunctor &rank_func,
+                      Observer &observer) {
+    SteadyStateSolver<T, InitializerFunctor, SelectionFunctor,
+                      CrossOverFunctor, MutationFunctor,
+                      RankFunctor> solver(options, steady_options, init_func,
+                                          select_func, cross_over_func,
+                                          mutate_func, rank_func);
+    return solver.run(observer);
+  }
+
+  /// As the previous one, without observer
+  template<typename T=float,
+           typename InitializerFunctor,
+           typename SelectionFunctor,
+           typename CrossOverFunctor,
+           typename MutationFunctor,
+           typename RankFunctor>
+  SolverResult<typename genome_of<InitializerFunctor>::type, T>
+  evolve_steady_state(const SolverOptions &options,
+                      const SteadyStateOptions &steady_options,
+                      const InitializerFunctor &init_func,
+                      const SelectionFunctor &select_func,
+                      const CrossOverFunctor &cross_over_func,
+                      const MutationFunctor &mutate_func,
+                      const RankFunctor &rank_func) {
+    NullObserver observer;
+    return evolve_steady_state<T>(options, steady_options, init_func,
+                                  select_func, cross_over_func, mutate_func,
+                                  rank_func, observer);
+  }
+
+} // namespace GeneticAlgorithms
+
+#endif // STEADY_STATE_SOLVER_H
@@ -0,0 +1,204 @@
+/*
+ * This file is part of GeneticAlgorithms toolkit
+ *
+ * Copyright 2017, Francisco Zamora-Martinez
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace GeneticAlgorithms {
+
+  /**
+   * A fixed size pool of threads for data-parallel loops
+   *
+   * The pool is created once and reused for every parallel loop, so
+   * no thread is created or destroyed in the hot loop of the genetic
+   * algorithm. The calling thread takes part in every loop, so a pool
+   * of size 1 executes everything inline without any synchronization.
+   *
+   * Iterations are handled out in chunks from a shared atomic
+   * counter, which balances the load when iterations have very
+   * different costs. Chunks are guided: every claim takes a fraction
+   * of the remaining iterations, so first chunks are large and the
+   * last ones are small, and a thread stuck on expensive iterations
+   * leaves the rest of the loop to the others, as work stealing
+   * would do without per-thread queues. Every iteration is expected
+   * to write only its own output slot, so results don't depend on the
+   * scheduling nor on the number of threads.
+   *
+   * ATTENTION: parallelFor is not reentrant, it cannot be called from
+   * inside a loop running on the same pool.
+   *
+   * @code
+   * ThreadPool pool(4);
+   * std::vector<float> out(1000);
+   * pool.parallelFor(out.size(), [&](size_t i) { out[i] = f(i); });
+   * @endcode
+   */
+  class ThreadPool {
+  public:
+    /// Creates a pool with num_threads threads (the caller included)
+    explicit ThreadPool(size_t num_threads=1u) :
+      _invoke(0), _context(0), _n(0u), _chunk(1u), _next(0u),
+      _epoch(0u), _active(0u), _stop(false) {
+      if (num_threads == 0u) num_threads = defaultSize();
+      for (size_t i=1u; i<num_threads; ++i) {
+        _workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+      }
+    }
+
+    ~ThreadPool() {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+      }
+      _wake_cv.notify_all();
+      for (auto &worker : _workers) worker.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /// Number of threads executing loops, the caller included
+    size_t size() const {
+      return _workers.size() + 1u;
+    }
+
+    /// Number of hardware threads, or 1 if it is unknown
+    static size_t defaultSize() {
+      size_t n = std::thread::hardware_concurrency();
+      return (n > 0u) ? n : 1u;
+    }
+
+    /**
+     * Executes f(i) for every i in [0,n) and waits until all are done
+     *
+     * If any call throws, the first exception is rethrown here once
+     * all threads have finished.
+     */
+    template<typename Functor>
+    void parallelFor(const size_t n, const Functor &f) {
+      if (n == 0u) return;
+      if (_workers.empty() || n == 1u) {
+        for (size_t i=0; i<n; ++i) f(i);
+        return;
+      }
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _invoke = &invokeFunctor<Functor>;
+        _context = static_cast<const void*>(&f);
+        _n = n;
+        // minimum chunk, it keeps claims rare for cheap iterations
+        _chunk = std::max<size_t>(1u, n / (32u * size()));
+        _next.store(0u);
+        _error = std::exception_ptr();
+        _active = _workers.size();
+        ++_epoch;
+      }
+      _wake_cv.notify_all();
+      work();
+      std::unique_lock<std::mutex> lock(_mutex);
+      _done_cv.wait(lock, [this]{ return _active == 0u; });
+      _invoke = 0;
+      _context = 0;
+      if (_error) {
+        std::exception_ptr error = _error;
+        _error = std::exception_ptr();
+        std::rethrow_exception(error);
+      }
+    }
+
+  private:
+    typedef void (*invoke_t)(const void *, size_t);
+
+    std::vector<std::thread> _workers;
+    std::mutex _mutex;
+    std::condition_variable _wake_cv;
+    std::condition_variable _done_cv;
+    /// type-erased loop body, no heap allocation is needed
+    invoke_t _invoke;
+    const void *_context;
+    size_t _n;
+    size_t _chunk;
+    std::atomic<size_t> _next;
+    size_t _epoch;
+    size_t _active;
+    bool _stop;
+    std::exception_ptr _error;
+
+    template<typename Functor>
+    static void invokeFunctor(const void *context, size_t i) {
+      (*static_cast<const Functor*>(context))(i);
+    }
+
+    /// claims chunks of iterations until the loop is exhausted
+    void work() {
+      const size_t n = _n, min_chunk = _chunk, ways = 2u * size();
+      size_t first = _next.load();
+      while (first < n) {
+        const size_t chunk = std::max(min_chunk, (n - first) / ways);
+        if (!_next.compare_exchange_weak(first, first + chunk)) continue;
+        const size_t last = std::min(first + chunk, n);
+        try {
+          for (size_t i=first; i<last; ++i) _invoke(_context, i);
+        }
+        catch (...) {
+          std::lock_guard<std::mutex> lock(_mutex);
+          if (!_error) _error = std::current_exception();
+          // skip the remaining iterations
+          _next.store(n);
+        }
+        first = _next.load();
+      }
+    }
+
+    void workerLoop() {
+      size_t epoch = 0u;
+      for (;;) {
+        {
+          std::unique_lock<std::mutex> lock(_mutex);
+          _wake_cv.wait(lock, [&]{ return _stop || _epoch != epoch; });
+          if (_stop) return;
+          epoch = _epoch;
+        }
+        work();
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (--_active == 0u) _done_cv.notify_one();
+      }
+    }
+  }; // class ThreadPool
+
+} // namespace GeneticAlgorithms
+
+#endif // THREAD_POOL_H
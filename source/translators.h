@@ -29,8 +29,11 @@
 #define TRANSLATORS_H
 
 #include <boost/dynamic_bitset.hpp>
+#include <cmath>
 #include <iostream>
+#include <vector>
 
+#include "bit_kernels.h"
 #include "chromosome.h"
 
 namespace GeneticAlgorithms {
@@ -48,6 +51,10 @@ namespace GeneticAlgorithms {
    * @note This class doesn't check if the position counter is valid,
    * be careful, invalid positions can lead into memory problems.
    *
+   * @note The decoder doesn't copy the gens, it reads them from the
+   * given chromosome (Chromosome or StaticChromosome), which should
+   * outlive the decoder.
+   *
    * @code
    * // my_chromosome has 12 bits:
    * //    - 5 bits are a uint32_t
@@ -62,32 +69,27 @@ namespace GeneticAlgorithms {
    */
   class Decoder {
   public:
-    Decoder(const Chromosome &chromosome) :
-      _gens(chromosome.gens()), _pos(0u) {
+    template<typename Genome>
+    Decoder(const Genome &chromosome) :
+      _words(chromosome.words()), _pos(0u) {
     }
 
     bool decodeBool() {
-      return _gens[_pos++];
+      const bool x = (_words[_pos / WORD_BITS] >> (_pos % WORD_BITS)) & 1u;
+      ++_pos;
+      return x;
     }
 
+    /// n in [1,64], the first gen is the least significant bit
     uint64_t decodeUInt64(const size_t n) {
-      uint64_t x = 0u;
-      size_t i = _pos, j = _pos + n - 1;
-      for (size_t k=j+1u; k>i; --k) {
-        x = (x<<1uL) | static_cast<uint64_t>(_gens[k-1]);
-      }
+      const uint64_t x = kernels::extract_bits(_words, _pos, n);
       _pos += n;
       return x;
     }
-    
+
+    /// n in [1,32], the first gen is the least significant bit
     uint32_t decodeUInt32(const size_t n) {
-      uint32_t x = 0u;
-      size_t i = _pos, j = _pos + n - 1;
-      for (size_t k=j+1u; k>i; --k) {
-        x = (x<<1uL) | static_cast<uint32_t>(_gens[k-1]);
-      }
-      _pos += n;
-      return x;
+      return static_cast<uint32_t>(decodeUInt64(n));
     }
 
     double decodeDouble(const size_t n,
@@ -97,7 +99,7 @@ namespace GeneticAlgorithms {
       // assert(min < max);
       double length = max - min;
       double x_double = static_cast<double>
-        (double(x_uint)/double((1uL<<n) - 1uL)*length + min);
+        (double(x_uint)/double(kernels::low_mask(n))*length + min);
       return x_double;
     }
 
@@ -108,69 +110,289 @@ namespace GeneticAlgorithms {
       // assert(min < max);
       float length = max - min;
       float x_float = static_cast<float>
-        (double(x_uint)/double((1uL<<n) - 1uL)*length + min);
+        (double(x_uint)/double(kernels::low_mask(n))*length + min);
       return x_float;
     }
 
+    /// Moves the position pointer n gens forward
+    void skip(const size_t n) {
+      _pos += n;
+    }
+
+    /// Current position pointer
+    size_t position() const {
+      return _pos;
+    }
+
   private:
-    bitset _gens;
-    uint32_t _pos;
+    const word_type *_words;
+    size_t _pos;
   }; // class Decoder
 
-  // template <typename N>
-  // class EncoderBuilder {
-  // public:
-  //   class Encoder {
-  //     friend class EncoderBuilder;
-  //   private:
-  //     Encoder(EncoderBuilder *builder);
-  //   };
-    
-  //   void code_uint32(uint32_t val, const size_t i=0u, const size_t j=N-1) {
-  //     for (size_t k=j+1; k>i; --k) {
-  //       _gens[k-1] = val & 1u;
-  //       val >>= 1;
-  //     }
-  //   }
-
-  //   void code_float(float val, float min, float max,
-  //                   const size_t i=0, const size_t j=N-1) {
-  //     float length = max - min;
-  //     uint32_t x_uint = static_cast<uint32_t>(roundf((val - min) / length));
-  //     code_uint32(x_uint, i, j);
-  //   }
-
-  // private:
-  //   enum types_t {
-  //     UINT32,
-  //     FLOAT,
-  //   };
-  //   struct data_desc_t {
-  //     types_t type;
-  //     size_t num_bits;
-  //     float min, max;
-  //   };
-  //   vector<data_desc_t> description;
-
-    
-  //   uint32_t decode_uint32(const size_t i=0,
-  //                          const size_t j=N-1) const {
-  //     uint32_t x = 0u;
-  //     for (size_t k=j+1; k>i; --k) {
-  //       x = (x<<1) | static_cast<uint32_t>(_gens[k-1]);
-  //     }
-  //     return x;
-  //   }
-
-  //   float decode_float(float min,
-  //                      float max,
-  //                      const size_t i=0,
-  //                      const size_t j=N-1) const {
-  //     uint32_t x_uint = decode_uint32(i, j);
-  //     // assert(min < max);
-  //     float length = max - min;
-  //     return static_cast<float>(static_cast<double>(x_uint)*length + min);
-  //   }
+  /**
+   * Writes C++ types into Chromosome gens, the inverse of Decoder
+   *
+   * Values are written with the same bit order used by Decoder, so a
+   * chromosome encoded with the same sequence of calls decodes into
+   * the same values (reals being rounded to the nearest of the 2^n
+   * representable ones). It is useful to seed the population with
+   * known good solutions.
+   *
+   * ATTENTION: no thread safe object, it should be created for each
+   * thread in your program.
+   *
+   * @note The encoder doesn't check if the position counter is valid,
+   * the chromosome should have enough gens.
+   *
+   * @code
+   * Chromosome x(12u);
+   * Encoder encoder(x);
+   * encoder.encodeUInt32(5, 17u);
+   * encoder.encodeFloat(5, 0.25f, 0.0f, 1.0f);
+   * encoder.encodeBool(true);
+   * encoder.encodeBool(false);
+   * @endcode
+   */
+  class Encoder {
+  public:
+    template<typename Genome>
+    Encoder(Genome &chromosome) :
+      _words(chromosome.words()), _pos(0u) {
+    }
+
+    void encodeBool(const bool x) {
+      kernels::deposit_bits(_words, _pos, 1u, x ? 1u : 0u);
+      ++_pos;
+    }
+
+    /// n in [1,64], the first gen is the least significant bit
+    void encodeUInt64(const size_t n, const uint64_t x) {
+      kernels::deposit_bits(_words, _pos, n, x);
+      _pos += n;
+    }
+
+    /// n in [1,32], the first gen is the least significant bit
+    void encodeUInt32(const size_t n, const uint32_t x) {
+      encodeUInt64(n, x);
+    }
+
+    /// x is clamped to [min,max]
+    void encodeDouble(const size_t n, const double x,
+                      const double min=0.0,
+                      const double max=1.0) {
+      encodeUInt64(n, quantize(n, x, min, max));
+    }
+
+    /// x is clamped to [min,max]
+    void encodeFloat(const size_t n, const float x,
+                     const float min=0.0f,
+                     const float max=1.0f) {
+      encodeUInt64(n, quantize(n, x, min, max));
+    }
+
+    /// Moves the position pointer n gens forward
+    void skip(const size_t n) {
+      _pos += n;
+    }
+
+    /// Current position pointer
+    size_t position() const {
+      return _pos;
+    }
+
+    /**
+     * Nearest integer in [0, 2^n - 1] to the position of x in
+     * [min,max], the inverse of Decoder::decodeDouble()
+     */
+    static uint64_t quantize(const size_t n, const double x,
+                             const double min, const double max) {
+      const word_type mask = kernels::low_mask(n);
+      if (!(max > min) || !(x > min)) return 0u;
+      const double q = std::round((x - min) / (max - min) * double(mask));
+      return (q >= double(mask)) ? mask : static_cast<uint64_t>(q);
+    }
+
+  private:
+    word_type *_words;
+    size_t _pos;
+  }; // class Encoder
+
+  /**
+   * A precomputed schema of the fields of a Chromosome, used to
+   * decode and encode whole parameter vectors
+   *
+   * Every field is a fixed number of consecutive gens, which can be
+   * decoded as a real number in [min,max] (as Decoder::decodeDouble()
+   * does) or as an unsigned integer (addUIntField(), a bool being a
+   * one gen integer). Any field can use the reflected binary (Gray)
+   * code, so neighbour values differ in a single gen and mutations
+   * behave smoothly.
+   *
+   * Word indices, shifts, masks and scales are computed once, when
+   * the field is added, so decoding the whole vector of parameters is
+   * a single branchless loop over plain arrays, without allocations
+   * (when the output has the right size) and without any Decoder.
+   * Gray codes are converted with bit tricks, never looping over
+   * gens.
+   *
+   * The layout is read-only during decode() and encode(), so it can
+   * be shared by RankFunctor calls running concurrently.
+   *
+   * @code
+   * // 100 parameters of 12 bits in [-5,5] plus one of 20 bits in [0,1]
+   * DecoderLayout layout;
+   * layout.addFields(100u, 12u, -5.0, 5.0, DecoderLayout::GRAY)
+   *   .addField(20u, 0.0, 1.0);
+   * RandomInitializer init(layout.size(), seed, 0.5f);
+   * ...
+   * std::vector<float> params;
+   * layout.decode(chromosome, params);
+   * // warm start from known parameters
+   * Chromosome x = layout.encode<Chromosome>(params);
+   * @endcode
+   */
+  class DecoderLayout {
+  public:
+    /// How the integer value of a field is represented by its gens
+    enum Coding {
+      BINARY,
+      GRAY
+    };
+
+    DecoderLayout() : _size(0u) {
+    }
+
+    /// Appends a real field of n gens in [min,max], n in [1,64]
+    DecoderLayout &addField(const size_t n,
+                            const double min=0.0,
+                            const double max=1.0,
+                            const Coding coding=BINARY) {
+      const double scale = (max - min) / double(kernels::low_mask(n));
+      return append(n, min, scale, coding);
+    }
+
+    /// Appends count real fields of n gens with the same range
+    DecoderLayout &addFields(const size_t count, const size_t n,
+                             const double min=0.0,
+                             const double max=1.0,
+                             const Coding coding=BINARY) {
+      for (size_t i=0; i<count; ++i) addField(n, min, max, coding);
+      return *this;
+    }
+
+    /// Appends an unsigned integer field of n gens, n in [1,64]
+    DecoderLayout &addUIntField(const size_t n, const Coding coding=BINARY) {
+      return append(n, 0.0, 1.0, coding);
+    }
+
+    /// Number of gens covered by the layout
+    size_t size() const {
+      return _size;
+    }
+
+    size_t numFields() const {
+      return _min.size();
+    }
+
+    /**
+     * Decodes every field of x into out[0..numFields())
+     *
+     * x should have at least size() gens.
+     */
+    template<typename Genome, typename T>
+    void decode(const Genome &x, T *out) const {
+      const word_type *words = x.words();
+      const size_t n = numFields();
+      for (size_t i=0; i<n; ++i) {
+        // _hi_mask is zero when the field fits in one word, so the
+        // second read never changes the value (and _hi_word = _word)
+        word_type v = ((words[_word[i]] >> _shift[i]) |
+                       ((words[_hi_word[i]] << _hi_shift[i]) &
+                        _hi_mask[i])) & _mask[i];
+        v = _gray[i] ? kernels::gray_decode(v) : v;
+        out[i] = static_cast<T>(double(v) * _scale[i] + _min[i]);
+      }
+    }
+
+    /// As the previous one, resizing out to numFields()
+    template<typename Genome, typename T>
+    void decode(const Genome &x, std::vector<T> &out) const {
+      out.resize(numFields());
+      if (!out.empty()) decode(x, &out[0]);
+    }
+
+    /**
+     * Encodes values[0..numFields()) into the gens of x, values out
+     * of the range of their field are clamped
+     *
+     * x should have at least size() gens, the rest of them are not
+     * modified. Decoded values encode back into the same gens as long
+     * as T represents the 2^n values of every field exactly (n <= 24
+     * for float, n <= 53 for double).
+     */
+    template<typename Genome, typename T>
+    void encode(const T *values, Genome &x) const {
+      word_type *words = x.words();
+      const size_t n = numFields();
+      for (size_t i=0; i<n; ++i) {
+        const double q = (_scale[i] > 0.0) ?
+          std::round((double(values[i]) - _min[i]) / _scale[i]) : 0.0;
+        word_type v = !(q > 0.0) ? word_type(0u) :
+          (q >= double(_mask[i])) ? _mask[i] : static_cast<word_type>(q);
+        v = _gray[i] ? kernels::gray_encode(v) : v;
+        // same shifts used by decode(), at most two words are written
+        words[_word[i]] = (words[_word[i]] & ~(_mask[i] << _shift[i])) |
+          (v << _shift[i]);
+        words[_hi_word[i]] = (words[_hi_word[i]] &
+                              ~((_mask[i] >> _hi_shift[i]) & _hi_mask[i])) |
+          ((v >> _hi_shift[i]) & _hi_mask[i]);
+      }
+    }
+
+    /// As the previous one, values should have numFields() elements
+    template<typename Genome, typename T>
+    void encode(const std::vector<T> &values, Genome &x) const {
+      if (!values.empty()) encode(&values[0], x);
+    }
+
+    /// Returns a new Genome of size() gens with the given values
+    template<typename Genome, typename T>
+    Genome encode(const std::vector<T> &values) const {
+      Genome x(_size);
+      encode(values, x);
+      return x;
+    }
+
+  private:
+    size_t _size;
+    // one entry per field, structure of arrays
+    std::vector<size_t> _word;
+    std::vector<size_t> _hi_word;
+    std::vector<unsigned> _shift;
+    std::vector<unsigned> _hi_shift;
+    std::vector<word_type> _hi_mask;
+    std::vector<word_type> _mask;
+    std::vector<double> _scale;
+    std::vector<double> _min;
+    std::vector<unsigned char> _gray;
+
+    DecoderLayout &append(const size_t n, const double min,
+                          const double scale, const Coding coding) {
+      const size_t b = _size % WORD_BITS;
+      const bool crosses = b + n > WORD_BITS;
+      _word.push_back(_size / WORD_BITS);
+      _hi_word.push_back(_size / WORD_BITS + (crosses ? 1u : 0u));
+      _shift.push_back(static_cast<unsigned>(b));
+      _hi_shift.push_back(static_cast<unsigned>((WORD_BITS - b) % WORD_BITS));
+      _hi_mask.push_back(crosses ? ~word_type(0u) : word_type(0u));
+      _mask.push_back(kernels::low_mask(n));
+      _scale.push_back(scale);
+      _min.push_back(min);
+      _gray.push_back(coding == GRAY ? 1u : 0u);
+      _size += n;
+      return *this;
+    }
+  }; // class DecoderLayout
 
 } // namespace GeneticAlgorithms
 
@@ -0,0 +1,1283 @@
+// Unit tests of the toolkit, built with Google Test. Run as
+//   make check
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <iterator>
+#include <new>
+#include <sstream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "chromosome.h"
+#include "crossovers.h"
+#include "event_log.h"
+#include "fitness_cache.h"
+#include "genetic_solver.h"
+#include "initializers.h"
+#include "mutations.h"
+#include "nsga2.h"
+#include "packed_population.h"
+#include "remote_evaluator.h"
+#include "selections.h"
+#include "steady_state_solver.h"
+#include "translators.h"
+
+using namespace GeneticAlgorithms;
+
+// counts every heap allocation of the program; the replacements are
+// not inlined, so the compiler never pairs a counted new with free()
+static std::atomic<size_t> num_allocations(0u);
+
+static void *counted_malloc(size_t size) {
+  num_allocations.fetch_add(1u, std::memory_order_relaxed);
+  void *p = std::malloc(size == 0u ? 1u : size);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+__attribute__((noinline)) void *operator new(size_t size) {
+  return counted_malloc(size);
+}
+
+__attribute__((noinline)) void *operator new[](size_t size) {
+  return counted_malloc(size);
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void *p) noexcept {
+  std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept {
+  std::free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void *p, size_t) noexcept {
+  std::free(p);
+}
+
+#define N 50
+
+// example01, maximizes a float decoded from the chromosome
+struct DecodeRank {
+  float operator()(const Chromosome &x) const {
+    Decoder decoder(x);
+    return decoder.decodeFloat(N, -5.0f, 5.0f);
+  }
+};
+
+// number of ones, maximized by the all ones Chromosome
+struct OnesRank {
+  float operator()(const Chromosome &x) const {
+    float sum = 0.0f;
+    for (size_t i=0; i<x.size(); ++i) sum += x[i];
+    return sum;
+  }
+};
+
+// allocations of generations steps once the arenas are warm
+template<typename Rank, typename Init, typename Select, typename Cross,
+         typename Mutate>
+static size_t stepAllocations(SolverOptions options, const Init &init,
+                              const Select &select, const Cross &cross,
+                              const Mutate &mutate) {
+  GeneticSolver<float, Init, Select, Cross, Mutate, Rank>
+    solver(options, init, select, cross, mutate, Rank());
+  solver.init();
+  solver.step(); // warms up the buffers of both generations
+  solver.step();
+  const size_t before = num_allocations.load();
+  for (int i=0; i<200; ++i) solver.step();
+  return num_allocations.load() - before;
+}
+
+TEST(Population, StepDoesNotAllocate) {
+  for (size_t threads : {1u, 4u}) {
+    SolverOptions options;
+    options.population_size = 100u;
+    options.num_threads = threads;
+    EXPECT_EQ(0u, stepAllocations<DecodeRank>(options,
+                                              RandomInitializer(N, 1u, 0.5f),
+                                              FloatRouletteWheelSelection(2u),
+                                              RandomSplitCrossOver(N, 3u),
+                                              RandomMutate(4u, 0.5f)));
+    EXPECT_EQ(0u, stepAllocations<OnesRank>(options,
+                                            RandomInitializer(N, 1u, 0.1f),
+                                            FloatTournamentSelection(2u, 2u),
+                                            make_cross_over_on_prob(3u, 0.5f,
+                                                                    RandomMixCrossOver(4u)),
+                                            RandomMutate(5u, 0.001f)));
+    // the diversity is measured every step, and never low enough to
+    // restart
+    options.restart_diversity = 0.01;
+    EXPECT_EQ(0u, stepAllocations<DecodeRank>(options,
+                                              RandomInitializer(N, 1u, 0.5f),
+                                              FloatRouletteWheelSelection(2u),
+                                              RandomSplitCrossOver(N, 3u),
+                                              RandomMutate(4u, 0.5f)));
+  }
+}
+
+TEST(Population, ParallelStepDoesNotAllocate) {
+  SolverOptions options;
+  options.population_size = 100u;
+  options.num_threads = 4u;
+  options.parallel_offspring = true;
+  EXPECT_EQ(0u, stepAllocations<DecodeRank>(options,
+                                            RandomInitializer(N, 1u, 0.5f),
+                                            FloatRouletteWheelSelection(2u),
+                                            RandomSplitCrossOver(N, 3u),
+                                            RandomMutate(4u, 0.01f)));
+}
+
+TEST(Population, ReplaceKeepsTop) {
+  Population<OnesRank> pop((OnesRank()));
+  Philox4x32 rng(11u, 0u);
+  for (size_t i=0; i<50u; ++i) pop.push(Chromosome(8u), float(rng() % 8u));
+  for (int k=0; k<2000; ++k) {
+    const size_t i = rng() % pop.size();
+    const size_t top = pop.topIndex();
+    const float best = pop.rank(top), rank = float(rng() % 8u);
+    pop.replace(i, Chromosome(8u), rank);
+    const std::vector<float> &ranks = pop.ranks();
+    ASSERT_EQ(*std::max_element(ranks.begin(), ranks.end()),
+              pop.rank(pop.topIndex()));
+    // a tie keeps the replaced top
+    if (i == top && !(rank < best)) {
+      EXPECT_EQ(top, pop.topIndex());
+    }
+  }
+}
+
+TEST(Philox4x32, KnownAnswer) {
+  // Random123 known answer test of Philox4x32-10, zero key and counter
+  uint64_t out[2];
+  Philox4x32::block(0u, 0u, 0u, out);
+  EXPECT_EQ(0xe169c58d6627e8d5ULL, out[0]);
+  EXPECT_EQ(0x9b00dbd8bc57ac4cULL, out[1]);
+  Philox4x32 rng;
+  EXPECT_EQ(out[0], rng());
+  EXPECT_EQ(out[1], rng());
+}
+
+TEST(Philox4x32, DiscardMatchesDraws) {
+  Philox4x32 a(7u, 3u), b(7u, 3u);
+  for (int i=0; i<5; ++i) a();
+  b.discard(5u);
+  for (int i=0; i<10; ++i) EXPECT_EQ(a(), b());
+}
+
+// the population after some generations of parallel offspring
+static std::vector<float> parallelRun(const size_t threads) {
+  typedef GeneticSolver<float, RandomInitializer, FloatTournamentSelection,
+                        RandomSplitCrossOver, RandomMutate, OnesRank> solver_t;
+  SolverOptions options;
+  options.population_size = 64u;
+  options.num_threads = threads;
+  options.parallel_offspring = true;
+  options.seed = 12345u;
+  RandomInitializer init(200u, 1u, 0.3f);
+  FloatTournamentSelection select(2u, 2u);
+  RandomSplitCrossOver cross(200u, 3u);
+  RandomMutate mutate(4u, 0.01f);
+  solver_t solver(options, init, select, cross, mutate, OnesRank());
+  solver.init();
+  for (int i=0; i<30; ++i) solver.step();
+  std::vector<float> ranks(solver.population().ranks().begin(),
+                           solver.population().ranks().begin() +
+                           solver.population().size());
+  ranks.push_back(solver.best().second);
+  return ranks;
+}
+
+TEST(Philox4x32, SavesTheSameStateWhenUnused) {
+  Philox4x32 a(7u, 3u);
+  std::ostringstream text;
+  text << a;
+  EXPECT_EQ("7 3 0 0 0 0", text.str());
+  Philox4x32 b(7u, 9u);
+  b();
+  b.seed(7u);
+  std::ostringstream reseeded;
+  reseeded << b;
+  EXPECT_EQ("7 0 0 0 0 0", reseeded.str());
+}
+
+TEST(Philox4x32, ChildStreamsDontDependOnThreads) {
+  const std::vector<float> expected = parallelRun(1u);
+  EXPECT_EQ(expected, parallelRun(2u));
+  EXPECT_EQ(expected, parallelRun(4u));
+  EXPECT_EQ(expected, parallelRun(7u));
+}
+
+static bool sameGens(const Chromosome &a, const Chromosome &b) {
+  if (a.size() != b.size()) return false;
+  for (size_t i=0; i<a.size(); ++i) if (a[i] != b[i]) return false;
+  return true;
+}
+
+// runs example01 for the given generations, fresh operators each time
+static SolverResult<Chromosome, float> runExample01(SolverOptions options,
+                                                    const size_t generations) {
+  options.num_iterations = generations;
+  RandomInitializer init(N, 1u, 0.5f);
+  FloatTournamentSelection select(2u, 2u);
+  RandomSplitCrossOver cross(N, 3u);
+  RandomMutate mutate(4u, 0.01f);
+  GeneticSolver<float, RandomInitializer, FloatTournamentSelection,
+                RandomSplitCrossOver, RandomMutate, DecodeRank>
+    solver(options, init, select, cross, mutate, DecodeRank());
+  NullObserver observer;
+  return solver.run(observer);
+}
+
+TEST(GeneticSolver, ResumeReproducesUninterruptedRun) {
+  const char *path = "resume_test.snapshot";
+  for (int parallel=0; parallel<2; ++parallel) {
+    SolverOptions options;
+    options.population_size = 100u;
+    options.num_threads = 2u;
+    options.parallel_offspring = parallel != 0;
+    options.seed = 5u;
+    const SolverResult<Chromosome, float> whole = runExample01(options, 60u);
+    std::remove(path);
+    options.checkpoint_path = path;
+    options.checkpoint_interval = 10u;
+    runExample01(options, 35u);
+    ASSERT_TRUE(Snapshot::exists(path));
+    EXPECT_EQ(35u, Snapshot(path).header().generation);
+    const SolverResult<Chromosome, float> resumed = runExample01(options, 60u);
+    std::remove(path);
+    EXPECT_EQ(60u, resumed.generations);
+    EXPECT_EQ(whole.rank, resumed.rank);
+    EXPECT_TRUE(sameGens(whole.best, resumed.best));
+    EXPECT_EQ(whole.evaluations, resumed.evaluations);
+  }
+}
+
+TEST(Snapshot, RejectsOverflowingHeaders) {
+  const char *path = "corrupt_test.snapshot";
+  std::remove(path);
+  SolverOptions options;
+  options.population_size = 20u;
+  options.checkpoint_path = path;
+  runExample01(options, 3u);
+  std::vector<char> bytes;
+  {
+    std::ifstream in(path, std::ios::binary);
+    bytes.assign(std::istreambuf_iterator<char>(in),
+                 std::istreambuf_iterator<char>());
+  }
+  ASSERT_GE(bytes.size(), sizeof(SnapshotHeader));
+  SnapshotHeader h;
+  std::memcpy(&h, bytes.data(), sizeof(h));
+  // both sections wrap around to zero bytes
+  h.num_genomes = uint64_t(1u) << 62u;
+  std::memcpy(bytes.data(), &h, sizeof(h));
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), bytes.size());
+  }
+  EXPECT_THROW(Snapshot snapshot(path), std::runtime_error);
+  std::remove(path);
+}
+
+TEST(GeneticSolver, ResumeRejectsAnotherPopulationSize) {
+  const char *path = "size_test.snapshot";
+  std::remove(path);
+  SolverOptions options;
+  options.population_size = 20u;
+  options.checkpoint_path = path;
+  runExample01(options, 3u);
+  options.population_size = 30u;
+  EXPECT_THROW(runExample01(options, 6u), std::runtime_error);
+  std::remove(path);
+}
+
+TEST(GeneticSolver, ResumedLogKeepsOneHistory) {
+  const char *path = "log_test.snapshot", *old = "log_test.snapshot.30";
+  const char *log_path = "log_test.log";
+  SolverOptions options;
+  options.checkpoint_path = path;
+  options.checkpoint_interval = 10u;
+  options.log_path = log_path;
+  runExample01(options, 30u);
+  {
+    std::ifstream in(path, std::ios::binary);
+    std::ofstream out(old, std::ios::binary);
+    out << in.rdbuf();
+  }
+  // the run goes on up to 45, and it is killed before its snapshot
+  runExample01(options, 45u);
+  std::rename(old, path);
+  runExample01(options, 60u);
+  std::remove(path);
+  {
+    EventLog log(log_path);
+    ASSERT_EQ(61u, log.size());
+    EXPECT_EQ(61u, log.header().num_records);
+    for (size_t i=0; i<log.size(); ++i) {
+      EXPECT_EQ(i, log.record(i).generation);
+    }
+  }
+  std::remove(log_path);
+}
+
+TEST(RankServer, RanksRemoteChromosomes) {
+  RankServer server(0u);
+  size_t ranked = 0u;
+  std::thread worker([&server, &ranked]{
+      ranked = server.serve(OnesRank(), 70u, 2u, 1u);
+    });
+  {
+    std::vector<WorkerAddress> workers;
+    workers.push_back(WorkerAddress("127.0.0.1", server.port()));
+    RemoteEvaluator<> evaluator(workers, 8u, 3u);
+    std::vector<std::future<float> > ranks;
+    for (size_t k=0; k<20u; ++k) {
+      Chromosome x(70u);
+      for (size_t i=0; i<k; ++i) x.flip(3u*i);
+      ranks.push_back(evaluator.submit(x));
+    }
+    for (size_t k=0; k<20u; ++k) EXPECT_EQ(float(k), ranks[k].get());
+  }
+  worker.join();
+  EXPECT_EQ(20u, ranked);
+}
+
+TEST(RankServer, ClosesSessionsWithBadHeaders) {
+  RankServer server(0u, 64u);
+  size_t ranked = 1u;
+  std::thread worker([&server, &ranked]{
+      ranked = server.serve(OnesRank(), 70u, 1u, 3u);
+    });
+  // rows of a wrong number of words, a count over the maximum and a
+  // size which overflows
+  const uint64_t num_words[3] = {1u, 2u, 0x2000000000000001ULL};
+  const uint32_t count[3] = {8u, 65u, 8u};
+  for (int k=0; k<3; ++k) {
+    const int fd = wire::connect_to("127.0.0.1", server.port());
+    std::vector<char> request;
+    wire::put(request, wire::REQUEST_MAGIC);
+    wire::put(request, count[k]);
+    wire::put(request, num_words[k]);
+    wire::write_all(fd, request.data(), request.size());
+    char reply;
+    EXPECT_FALSE(wire::read_all(fd, &reply, 1u));
+    ::close(fd);
+  }
+  worker.join();
+  EXPECT_EQ(0u, ranked);
+}
+
+// sum of i*x[i], the rank of a Permutation
+struct PositionRank {
+  float operator()(const Permutation &x) const {
+    float sum = 0.0f;
+    for (size_t i=0; i<x.size(); ++i) sum += float(i * x[i]);
+    return sum;
+  }
+};
+
+TEST(RankServer, RanksRemotePermutations) {
+  RankServer server(0u);
+  size_t ranked = 0u;
+  // an odd size, so the rows have a padding value
+  const size_t n = 21u;
+  std::thread worker([&server, &ranked, n]{
+      ranked = server.serve<Permutation>(PositionRank(), n, 2u, 1u);
+    });
+  {
+    std::vector<WorkerAddress> workers;
+    workers.push_back(WorkerAddress("127.0.0.1", server.port()));
+    RemoteEvaluator<Permutation> evaluator(workers, 4u, 2u);
+    RandomPermutationInitializer init(n, 7u);
+    std::vector<Permutation> xs;
+    std::vector<std::future<float> > ranks;
+    for (size_t k=0; k<10u; ++k) {
+      xs.push_back(init());
+      ranks.push_back(evaluator.submit(xs.back()));
+    }
+    for (size_t k=0; k<10u; ++k) EXPECT_EQ(PositionRank()(xs[k]), ranks[k].get());
+  }
+  worker.join();
+  EXPECT_EQ(10u, ranked);
+}
+
+TEST(RemoteEvaluator, RejectsResponsesWithTooManyRows) {
+  const int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  ASSERT_EQ(0, ::bind(listener, reinterpret_cast<sockaddr*>(&addr), len));
+  ASSERT_EQ(0, ::listen(listener, 1));
+  ::getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len);
+  // a worker which answers every request with one row more
+  std::thread worker([listener]{
+      const int fd = ::accept(listener, 0, 0);
+      char header[wire::REQUEST_HEADER_BYTES];
+      if (wire::read_all(fd, header, sizeof(header))) {
+        const uint32_t count = wire::get<uint32_t>(header + 4);
+        const uint64_t num_words = wire::get<uint64_t>(header + 8);
+        std::vector<char> rows(count * (8u + num_words * sizeof(word_type)));
+        wire::read_all(fd, rows.data(), rows.size());
+        std::vector<char> reply;
+        wire::put(reply, wire::RESPONSE_MAGIC);
+        wire::put(reply, count + 1u);
+        for (uint32_t r=0; r<=count; ++r) {
+          wire::put(reply, wire::get<uint64_t>(rows.data()));
+          wire::put(reply, 1.0);
+        }
+        wire::write_all(fd, reply.data(), reply.size());
+        char end;
+        while (wire::read_all(fd, &end, 1u)) { }
+      }
+      ::close(fd);
+    });
+  {
+    std::vector<WorkerAddress> workers;
+    workers.push_back(WorkerAddress("127.0.0.1", ntohs(addr.sin_port)));
+    RemoteEvaluator<> evaluator(workers, 1u, 1u);
+    std::future<float> rank = evaluator.submit(Chromosome(70u));
+    EXPECT_THROW(rank.get(), std::runtime_error);
+  }
+  worker.join();
+  ::close(listener);
+}
+
+// number of open file descriptors of the process
+static size_t openFiles() {
+  size_t n = 0u;
+  DIR *dir = ::opendir("/proc/self/fd");
+  while (::readdir(dir)) ++n;
+  ::closedir(dir);
+  return n;
+}
+
+TEST(RemoteEvaluator, ClosesConnectionsWhenOneFails) {
+  RankServer server(0u);
+  // a port without anybody listening
+  uint16_t closed;
+  {
+    RankServer other(0u);
+    closed = other.port();
+  }
+  std::vector<WorkerAddress> workers;
+  workers.push_back(WorkerAddress("127.0.0.1", server.port()));
+  workers.push_back(WorkerAddress("127.0.0.1", server.port()));
+  workers.push_back(WorkerAddress("127.0.0.1", closed));
+  const size_t before = openFiles();
+  EXPECT_THROW(RemoteEvaluator<> evaluator(workers), std::runtime_error);
+  EXPECT_EQ(before, openFiles());
+}
+
+// fronts by peeling the non-dominated vectors again and again, O(m n^2)
+// per front, objectives being maximized
+static std::vector<uint32_t> naiveFronts(const std::vector<float> &objectives,
+                                         const size_t n, const size_t m) {
+  std::vector<uint32_t> front(n, ~uint32_t(0u));
+  size_t left = n;
+  for (uint32_t k=0; left > 0u; ++k) {
+    std::vector<size_t> members;
+    for (size_t i=0; i<n; ++i) {
+      if (front[i] != ~uint32_t(0u)) continue;
+      bool dominated = false;
+      for (size_t j=0; j<n && !dominated; ++j) {
+        if (front[j] != ~uint32_t(0u) || j == i) continue;
+        bool all = true, one = false;
+        for (size_t t=0; t<m; ++t) {
+          all = all && !(objectives[j*m + t] < objectives[i*m + t]);
+          one = one || objectives[i*m + t] < objectives[j*m + t];
+        }
+        dominated = all && one;
+      }
+      if (!dominated) members.push_back(i);
+    }
+    for (const size_t i : members) front[i] = k;
+    left -= members.size();
+  }
+  return front;
+}
+
+TEST(NonDominatedSorter, MatchesNaiveSort) {
+  NonDominatedSorter<float> sorter;
+  Philox4x32 rng(3u, 0u);
+  for (size_t m=1u; m<=5u; ++m) {
+    for (int trial=0; trial<20; ++trial) {
+      const size_t n = 1u + rng() % 150u;
+      // few distinct values, so many ties and equal vectors
+      const uint64_t values = 2u + trial % 6;
+      std::vector<float> objectives(n * m);
+      for (size_t i=0; i<n; ++i) {
+        if (i > 0u && rng() % 4u == 0u) {
+          const size_t j = rng() % i;
+          std::copy(objectives.begin() + j*m, objectives.begin() + (j+1u)*m,
+                    objectives.begin() + i*m);
+          continue;
+        }
+        for (size_t t=0; t<m; ++t) objectives[i*m + t] = float(rng() % values);
+      }
+      const std::vector<uint32_t> expected = naiveFronts(objectives, n, m);
+      std::vector<uint32_t> front(n);
+      const size_t num_fronts = sorter(objectives.data(), n, m, front.data());
+      EXPECT_EQ(size_t(*std::max_element(expected.begin(), expected.end())) + 1u,
+                num_fronts);
+      ASSERT_EQ(expected, front) << "m " << m << " n " << n;
+    }
+  }
+}
+
+// children of random parents of every size up to 40, written into
+// reused memory and returned by value
+template<typename CrossOver>
+static void checkPermutationChildren(const CrossOver &cross) {
+  Permutation child;
+  Philox4x32 rng(9u, 0u);
+  for (size_t n=1u; n<=40u; ++n) {
+    RandomPermutationInitializer init(n, unsigned(n));
+    for (int k=0; k<200; ++k) {
+      const Permutation a = init(), b = k % 5 == 0 ? a : init();
+      if (k % 2 == 0) cross(a, b, child);
+      else cross(a, b, child, rng);
+      ASSERT_EQ(n, child.size());
+      ASSERT_TRUE(child.valid()) << "n " << n;
+      ASSERT_TRUE(cross(a, b).valid()) << "n " << n;
+    }
+  }
+}
+
+TEST(Permutation, OrderCrossOverGivesPermutations) {
+  checkPermutationChildren(OrderCrossOver(1u));
+}
+
+TEST(Permutation, PartiallyMappedCrossOverGivesPermutations) {
+  checkPermutationChildren(PartiallyMappedCrossOver(2u));
+}
+
+// values in their own position
+struct FixedPoints {
+  float operator()(const Permutation &x) const {
+    float sum = 0.0f;
+    for (size_t i=0; i<x.size(); ++i) sum += x[i] == i;
+    return sum;
+  }
+};
+
+TEST(GeneticSolver, PermutationsDontRestart) {
+  SolverOptions options;
+  options.population_size = 100u;
+  options.restart_diversity = 0.2;
+  RandomPermutationInitializer init(100u, 1u);
+  FloatTournamentSelection select(2u, 2u);
+  OrderCrossOver cross(3u);
+  SwapMutate mutate(4u, 0.01f);
+  GeneticSolver<float, RandomPermutationInitializer, FloatTournamentSelection,
+                OrderCrossOver, SwapMutate, FixedPoints>
+    solver(options, init, select, cross, mutate, FixedPoints());
+  solver.init();
+  for (int i=0; i<40; ++i) solver.step();
+  EXPECT_EQ(0u, solver.restarts());
+}
+
+TEST(GeneticSolver, ClonesRestart) {
+  SolverOptions options;
+  options.population_size = 100u;
+  options.restart_diversity = 0.2;
+  // zero probability of ones, so all Chromosomes are equal
+  RandomInitializer init(N, 1u, 0.0f);
+  FloatTournamentSelection select(2u, 2u);
+  RandomSplitCrossOver cross(N, 3u);
+  RandomMutate mutate(4u, 0.0f);
+  GeneticSolver<float, RandomInitializer, FloatTournamentSelection,
+                RandomSplitCrossOver, RandomMutate, OnesRank>
+    solver(options, init, select, cross, mutate, OnesRank());
+  solver.init();
+  solver.step();
+  EXPECT_EQ(1u, solver.restarts());
+}
+
+// true when the bits of the last word beyond the gens are zero
+template<typename Genome>
+static bool paddingIsZero(const Genome &x) {
+  const size_t r = x.size() % WORD_BITS;
+  return r == 0u || (x.words()[x.numWords() - 1u] >> r) == 0u;
+}
+
+TEST(Kernels, SplitWordsMatchesBits) {
+  const size_t sizes[] = {1u, 63u, 64u, 65u, 127u, 128u, 130u, 1000u};
+  for (const size_t n : sizes) {
+    RandomInitializer init(n, unsigned(n), 0.5f);
+    const Chromosome a = init(), b = init();
+    const size_t positions[] = {0u, 1u, 63u, 64u, 65u, 127u, 128u, n - 1u, n};
+    for (const size_t pos : positions) {
+      if (pos > n) continue;
+      Chromosome x(n), first = a, second = b;
+      kernels::split_words(x.words(), a.words(), b.words(), pos, x.numWords());
+      // dest equal to one of the parents
+      kernels::split_words(first.words(), first.words(), b.words(), pos,
+                           first.numWords());
+      kernels::split_words(second.words(), a.words(), second.words(), pos,
+                           second.numWords());
+      for (size_t i=0; i<n; ++i) {
+        const bool expected = i < pos ? a[i] : b[i];
+        ASSERT_EQ(expected, x[i]) << "n " << n << " pos " << pos << " gen " << i;
+        ASSERT_EQ(expected, first[i]) << "n " << n << " pos " << pos;
+        ASSERT_EQ(expected, second[i]) << "n " << n << " pos " << pos;
+      }
+      EXPECT_TRUE(paddingIsZero(x));
+    }
+  }
+}
+
+TEST(Kernels, MixTakesHalfOfTheGensFromEachParent) {
+  const size_t sizes[] = {1u, 63u, 64u, 65u, 130u, 1000u};
+  RandomMixCrossOver mix(7u);
+  for (const size_t n : sizes) {
+    RandomInitializer init(n, unsigned(n), 0.5f);
+    const Chromosome a = init(), b = init();
+    size_t from_a = 0u, differ = 0u;
+    for (int k=0; k<200; ++k) {
+      const Chromosome c = mix(a, b);
+      ASSERT_EQ(n, c.size());
+      ASSERT_TRUE(paddingIsZero(c));
+      for (size_t i=0; i<n; ++i) {
+        ASSERT_TRUE(c[i] == a[i] || c[i] == b[i]);
+        if (a[i] != b[i]) { ++differ; from_a += (c[i] == a[i]); }
+      }
+    }
+    if (differ >= 1000u) {
+      const double ratio = double(from_a) / double(differ);
+      EXPECT_NEAR(0.5, ratio, 0.05) << "n " << n;
+    }
+  }
+}
+
+TEST(RandomMutate, FlipRateMatchesProbability) {
+  // both sides of the 0.05 threshold between geometric skips and masks
+  const float probs[] = {0.002f, 0.02f, 0.05f, 0.06f, 0.3f, 0.8f};
+  const size_t n = 1000u; // the last word has 40 gens
+  for (const float p : probs) {
+    RandomMutate mutate(13u, p);
+    Chromosome x(n);
+    std::vector<size_t> flipped;
+    size_t flips = 0u;
+    const int trials = 400;
+    for (int k=0; k<trials; ++k) {
+      Chromosome y(n);
+      mutate(x, y, flipped);
+      ASSERT_TRUE(paddingIsZero(y)) << "p " << p;
+      size_t ones = 0u;
+      for (size_t i=0; i<n; ++i) ones += y[i];
+      ASSERT_EQ(ones, flipped.size());
+      for (size_t j=0; j<flipped.size(); ++j) {
+        ASSERT_TRUE(y[flipped[j]]);
+        if (j > 0u) {
+          ASSERT_LT(flipped[j-1u], flipped[j]);
+        }
+      }
+      flips += ones;
+    }
+    const double draws = double(trials) * double(n);
+    const double sigma = std::sqrt(draws * p * (1.0 - p));
+    EXPECT_NEAR(draws * p, double(flips), 5.0 * sigma) << "p " << p;
+  }
+}
+
+TEST(RandomMutate, KeepsPaddingOfFullChromosomes) {
+  const float probs[] = {0.01f, 0.5f};
+  for (const float p : probs) {
+    RandomMutate mutate(17u, p);
+    Chromosome x(70u);
+    for (size_t i=0; i<x.size(); ++i) x.set(i);
+    for (int k=0; k<100; ++k) {
+      mutate(x, x);
+      ASSERT_TRUE(paddingIsZero(x)) << "p " << p;
+    }
+  }
+}
+
+// a Chromosome of 64 gens holding the bits of k
+static Chromosome keyChromosome(const uint64_t k) {
+  Chromosome x(64u);
+  x.words()[0] = k;
+  return x;
+}
+
+TEST(RandomInitializer, DensityMatchesProbability) {
+  const float probs[] = {0.01f, 0.1f, 0.3f, 0.5f, 0.7f, 0.95f};
+  const size_t n = 1000u;
+  for (const float p : probs) {
+    RandomInitializer init(n, 17u, p);
+    size_t ones = 0u;
+    const int trials = 200;
+    for (int k=0; k<trials; ++k) {
+      const Chromosome x = init();
+      for (size_t i=0; i<n; ++i) ones += x[i];
+    }
+    const double draws = double(trials) * double(n);
+    const double sigma = std::sqrt(draws * p * (1.0 - p));
+    EXPECT_NEAR(draws * p, double(ones), 5.0 * sigma) << "p " << p;
+  }
+}
+
+TEST(RandomInitializer, KeepsPaddingZero) {
+  const size_t sizes[] = {1u, 63u, 64u, 65u, 130u, 1000u};
+  for (const size_t n : sizes) {
+    RandomInitializer init(n, unsigned(n), 0.9f);
+    Philox4x32 rng(3u);
+    for (int k=0; k<20; ++k) {
+      ASSERT_TRUE(paddingIsZero(init())) << "N " << n;
+      ASSERT_TRUE(paddingIsZero(init(rng))) << "N " << n;
+    }
+  }
+}
+
+TEST(Population, ParallelInitDoesntDependOnThreads) {
+  RandomInitializer init(N, 1u, 0.3f);
+  for (size_t capacity=0u; capacity<=64u; capacity+=64u) {
+    ThreadPool one(1u);
+    Population<OnesRank> expected((OnesRank()));
+    expected.enableCache(capacity);
+    expected.init(init, 50u, one, 11u);
+    const size_t threads[] = {2u, 4u};
+    for (const size_t t : threads) {
+      ThreadPool pool(t);
+      Population<OnesRank> pop((OnesRank()));
+      pop.enableCache(capacity);
+      pop.init(init, 50u, pool, 11u);
+      ASSERT_EQ(expected.size(), pop.size());
+      for (size_t i=0; i<pop.size(); ++i) {
+        ASSERT_TRUE(sameGens(expected.genome(i), pop.genome(i)))
+          << "threads " << t << " chromosome " << i;
+        ASSERT_EQ(expected.rank(i), pop.rank(i));
+      }
+      EXPECT_EQ(expected.topIndex(), pop.topIndex());
+    }
+  }
+}
+
+// values of x lie in [lower,upper] and its padding lanes are zero
+template<typename Vector>
+static bool realsWithin(const Vector &x, const double lower,
+                        const double upper) {
+  // the bounds as the operators round them
+  typedef typename Vector::value_type value_type;
+  for (size_t i=0; i<x.size(); ++i) {
+    if (x[i] < value_type(lower) || x[i] > value_type(upper)) return false;
+  }
+  const size_t padded = x.numWords() * sizeof(word_type) / sizeof(x[0]);
+  for (size_t i=x.size(); i<padded; ++i) if (x[i] != 0) return false;
+  return true;
+}
+
+template<typename Vector>
+static void checkRealCrossOvers() {
+  typedef typename Vector::value_type value_type;
+  const size_t sizes[] = {1u, 15u, 17u, 40u};
+  SimulatedBinaryCrossOver sbx(3u, 2.0, -0.8, 0.8);
+  BlendCrossOver blend(4u, 0.5, -0.8, 0.8);
+  for (const size_t n : sizes) {
+    BasicUniformRealInitializer<Vector> init(n, unsigned(n), -1.0, 1.0);
+    for (int k=0; k<50; ++k) {
+      const Vector a = init(), b = init();
+      // a reused child, whose former values become padding
+      Vector child(std::vector<value_type>(64u, value_type(7)));
+      sbx(a, b, child);
+      ASSERT_EQ(n, child.size());
+      ASSERT_TRUE(realsWithin(child, -0.8, 0.8)) << "sbx N " << n;
+      child = Vector(std::vector<value_type>(64u, value_type(7)));
+      blend(a, b, child);
+      ASSERT_EQ(n, child.size());
+      ASSERT_TRUE(realsWithin(child, -0.8, 0.8)) << "blend N " << n;
+    }
+  }
+}
+
+TEST(RealKernels, CrossOversClampAndKeepPaddingZero) {
+  checkRealCrossOvers<FloatVector>();
+  checkRealCrossOvers<DoubleVector>();
+}
+
+template<typename Vector, typename Mutate>
+static void checkRealMutationRate(const Mutate &mutate, const float p) {
+  const size_t n = 1000u; // not a whole number of lanes
+  const Vector x(n);
+  Vector y;
+  size_t mutated = 0u;
+  const int trials = 200;
+  for (int k=0; k<trials; ++k) {
+    mutate(x, y);
+    ASSERT_TRUE(realsWithin(y, -1.0, 1.0)) << "p " << p;
+    for (size_t i=0; i<n; ++i) mutated += (y[i] != 0);
+  }
+  const double draws = double(trials) * double(n);
+  const double sigma = std::sqrt(draws * p * (1.0 - p));
+  EXPECT_NEAR(draws * p, double(mutated), 5.0 * sigma) << "p " << p;
+}
+
+TEST(RealKernels, MutationRateMatchesProbability) {
+  // both sides of the 0.05 threshold between geometric skips and masks
+  const float probs[] = {0.005f, 0.03f, 0.05f, 0.06f, 0.3f, 0.9f};
+  for (const float p : probs) {
+    // steps which often leave [-1,1], so values are clamped
+    PolynomialMutate polynomial(5u, p, 1.0, -1.0, 1.0);
+    GaussianMutate gaussian(6u, p, 2.0, -1.0, 1.0);
+    checkRealMutationRate<FloatVector>(polynomial, p);
+    checkRealMutationRate<DoubleVector>(polynomial, p);
+    checkRealMutationRate<FloatVector>(gaussian, p);
+    checkRealMutationRate<DoubleVector>(gaussian, p);
+  }
+}
+
+TEST(FitnessCache, CountsHitsAndMisses) {
+  FitnessCache<Chromosome, float> cache(8u);
+  for (uint64_t k=0; k<5u; ++k) {
+    const Chromosome x = keyChromosome(k);
+    cache.insert(x, genome_hash(x), float(k));
+  }
+  // a second insert keeps the first rank
+  cache.insert(keyChromosome(2u), genome_hash(keyChromosome(2u)), 100.0f);
+  EXPECT_EQ(5u, cache.size());
+  float rank = -1.0f;
+  for (uint64_t k=0; k<5u; ++k) {
+    const Chromosome x = keyChromosome(k);
+    ASSERT_TRUE(cache.find(x, genome_hash(x), rank));
+    EXPECT_EQ(float(k), rank);
+  }
+  EXPECT_FALSE(cache.find(keyChromosome(9u), genome_hash(keyChromosome(9u)), rank));
+  // the same hash with other gens is a miss
+  EXPECT_FALSE(cache.find(keyChromosome(9u), genome_hash(keyChromosome(1u)), rank));
+  EXPECT_EQ(5u, cache.hits());
+  EXPECT_EQ(2u, cache.misses());
+}
+
+TEST(FitnessCache, ClockEvictsUnreferencedEntries) {
+  FitnessCache<Chromosome, float> cache(4u);
+  float rank;
+  for (uint64_t k=0; k<4u; ++k) {
+    cache.insert(keyChromosome(k), genome_hash(keyChromosome(k)), float(k));
+  }
+  ASSERT_TRUE(cache.find(keyChromosome(0u), genome_hash(keyChromosome(0u)), rank));
+  ASSERT_TRUE(cache.find(keyChromosome(2u), genome_hash(keyChromosome(2u)), rank));
+  // 0 gets a second chance, 1 leaves; then 2 gets it and 3 leaves
+  cache.insert(keyChromosome(4u), genome_hash(keyChromosome(4u)), 4.0f);
+  cache.insert(keyChromosome(5u), genome_hash(keyChromosome(5u)), 5.0f);
+  EXPECT_EQ(4u, cache.size());
+  const bool present[6] = {true, false, true, false, true, true};
+  for (uint64_t k=0; k<6u; ++k) {
+    EXPECT_EQ(present[k], cache.find(keyChromosome(k),
+                                     genome_hash(keyChromosome(k)), rank))
+      << "key " << k;
+  }
+}
+
+TEST(FitnessCache, EvictionKeepsCollidingKeysFindable) {
+  const size_t capacity = 16u;
+  FitnessCache<Chromosome, float> cache(capacity);
+  Philox4x32 rng(21u, 0u);
+  float rank;
+  for (uint64_t k=0; k<500u; ++k) {
+    // hashes of a few table positions, so probing sequences overlap
+    const uint64_t h = rng() % 6u;
+    cache.insert(keyChromosome(k), h, float(k));
+    if (rng() % 3u == 0u) cache.find(keyChromosome(rng() % (k + 1u)), h, rank);
+    ASSERT_EQ(std::min<size_t>(k + 1u, capacity), cache.size());
+    // every entry left in the cache must still be found
+    size_t found = 0u;
+    for (uint64_t j=0; j<=k; ++j) {
+      for (uint64_t g=0; g<6u; ++g) {
+        if (cache.find(keyChromosome(j), g, rank)) {
+          EXPECT_EQ(float(j), rank);
+          ++found;
+        }
+      }
+    }
+    ASSERT_EQ(cache.size(), found) << "after key " << k;
+  }
+}
+
+// additive rank with integer weights, so float sums are exact
+// a PackedPopulation holds xs, with one row per different Chromosome
+static void checkPacked(const PackedPopulation<OnesRank> &pop,
+                        const std::vector<Chromosome> &xs) {
+  ASSERT_EQ(xs.size(), pop.size());
+  std::vector<size_t> refs(pop.size(), 0u);
+  size_t rows = 0u;
+  for (size_t i=0; i<xs.size(); ++i) {
+    ASSERT_TRUE(sameGens(xs[i], pop.genome(i))) << "chromosome " << i;
+    ASSERT_EQ(OnesRank()(xs[i]), pop.rank(i)) << "chromosome " << i;
+    ASSERT_FALSE(pop.rank(pop.topIndex()) < pop.rank(i));
+    // freed rows are reused, so rows never outnumber Chromosomes
+    ASSERT_LT(size_t(pop.row(i)), pop.size());
+    if (refs[pop.row(i)]++ == 0u) ++rows;
+    for (size_t j=0; j<i; ++j) {
+      ASSERT_EQ(sameGens(xs[i], xs[j]), pop.row(i) == pop.row(j));
+    }
+  }
+  for (size_t i=0; i<xs.size(); ++i) {
+    ASSERT_EQ(refs[pop.row(i)], pop.refCount(pop.row(i)));
+  }
+  ASSERT_EQ(rows, pop.uniqueRows());
+}
+
+TEST(PackedPopulation, DeduplicationKeepsRowsConsistent) {
+  RandomInitializer init(N, 21u, 0.5f);
+  std::vector<Chromosome> pool;
+  for (int j=0; j<12; ++j) pool.push_back(init());
+  ThreadPool threads(2u);
+  PackedPopulation<OnesRank> pop(OnesRank(), N, true);
+  std::vector<Chromosome> xs;
+  for (int k=0; k<2; ++k) {
+    for (const Chromosome &x : pool) {
+      pop.push(x);
+      xs.push_back(x);
+    }
+  }
+  EXPECT_EQ(pool.size(), pop.uniqueRows());
+  EXPECT_EQ(pool.size(), pop.rankPending(threads));
+  ASSERT_NO_FATAL_FAILURE(checkPacked(pop, xs));
+  // a copy of a ranked row takes its rank
+  pop.push(pool[3]);
+  xs.push_back(pool[3]);
+  EXPECT_EQ(0u, pop.rankPending(threads));
+  ASSERT_NO_FATAL_FAILURE(checkPacked(pop, xs));
+  // replacements release rows, which are erased from the table and
+  // reused, while copies must still be found
+  std::mt19937 rng(5u);
+  for (int k=0; k<500; ++k) {
+    const size_t i = rng() % xs.size();
+    const Chromosome x = k % 3 == 0 ? init() : pool[rng() % pool.size()];
+    pop.replace(i, x, OnesRank()(x));
+    xs[i] = x;
+    ASSERT_NO_FATAL_FAILURE(checkPacked(pop, xs)) << "replacement " << k;
+  }
+  for (const Chromosome &x : pool) {
+    pop.push(x);
+    xs.push_back(x);
+  }
+  pop.rankPending(threads);
+  ASSERT_NO_FATAL_FAILURE(checkPacked(pop, xs));
+}
+
+struct WeightedOnes {
+  std::atomic<size_t> *deltas;
+
+  float operator()(const Chromosome &x) const {
+    float sum = 0.0f;
+    for (size_t i=0; i<x.size(); ++i) if (x[i]) sum += weight(i);
+    return sum;
+  }
+
+  float rank_delta(float parent_rank, const Chromosome &parent,
+                   const std::vector<size_t> &flipped) const {
+    deltas->fetch_add(1u);
+    for (const size_t i : flipped) {
+      parent_rank += parent[i] ? -weight(i) : weight(i);
+    }
+    return parent_rank;
+  }
+
+  static float weight(const size_t i) {
+    return float(1u + i % 7u);
+  }
+};
+
+TEST(Population, DeltaRanksMatchFullRanks) {
+  static_assert(has_rank_delta<WeightedOnes, Chromosome, float>::value,
+                "WeightedOnes should rank incrementally");
+  for (int parallel=0; parallel<2; ++parallel) {
+    std::atomic<size_t> deltas(0u);
+    WeightedOnes rank = {&deltas};
+    SolverOptions options;
+    options.population_size = 60u;
+    options.num_threads = 2u;
+    options.parallel_offspring = parallel != 0;
+    RandomInitializer init(N, 1u, 0.5f);
+    FloatTournamentSelection select(2u, 2u);
+    // half of the children are copies of a parent, ranked from it
+    auto cross = make_cross_over_on_prob(3u, 0.5f, RandomSplitCrossOver(N, 4u));
+    RandomMutate mutate(5u, 0.02f);
+    GeneticSolver<float, RandomInitializer, FloatTournamentSelection,
+                  decltype(cross), RandomMutate, WeightedOnes>
+      solver(options, init, select, cross, mutate, rank);
+    solver.init();
+    for (int k=0; k<30; ++k) {
+      solver.step();
+      const auto &pop = solver.population();
+      for (size_t i=0; i<pop.size(); ++i) {
+        ASSERT_EQ(rank(pop.genome(i)), pop.rank(i)) << "generation " << k;
+      }
+    }
+    EXPECT_GT(deltas.load(), 0u);
+  }
+}
+
+TEST(SteadyStateSolver, RanksChildrenThroughCacheAndDelta) {
+  for (size_t capacity=0u; capacity<=256u; capacity+=256u) {
+    std::atomic<size_t> deltas(0u);
+    WeightedOnes rank = {&deltas};
+    SolverOptions options;
+    options.population_size = 40u;
+    options.num_threads = 2u;
+    options.cache_capacity = capacity;
+    SteadyStateOptions steady;
+    steady.children_per_step = 4u;
+    RandomInitializer init(N, 1u, 0.5f);
+    FloatTournamentSelection select(2u, 2u);
+    auto cross = make_cross_over_on_prob(3u, 0.5f, RandomSplitCrossOver(N, 4u));
+    // a low rate gives repeated children, found in the cache
+    RandomMutate mutate(5u, 0.002f);
+    SteadyStateSolver<float, RandomInitializer, FloatTournamentSelection,
+                      decltype(cross), RandomMutate, WeightedOnes>
+      solver(options, steady, init, select, cross, mutate, rank);
+    solver.init();
+    for (int k=0; k<200; ++k) solver.step();
+    const auto &pop = solver.population();
+    for (size_t i=0; i<pop.size(); ++i) {
+      ASSERT_EQ(rank(pop.genome(i)), pop.rank(i)) << "capacity " << capacity;
+    }
+    EXPECT_EQ(pop.evaluations(), solver.evaluations());
+    if (capacity == 0u) {
+      EXPECT_GT(deltas.load(), 0u);
+      EXPECT_EQ(0u, pop.cacheHits() + pop.cacheMisses());
+    }
+    else {
+      EXPECT_GT(pop.cacheHits(), 0u);
+      EXPECT_EQ(options.population_size + 200u * steady.children_per_step,
+                pop.cacheHits() + pop.cacheMisses());
+    }
+  }
+}
+
+// the baseline decoding, one gen at a time, gen pos being the least
+// significant bit
+static uint64_t bitwiseUInt(const Chromosome &x, const size_t pos,
+                            const size_t n) {
+  uint64_t v = 0u;
+  for (size_t k=pos+n; k>pos; --k) v = (v << 1u) | uint64_t(x[k-1u]);
+  return v;
+}
+
+TEST(Decoder, MatchesBitwiseDecoding) {
+  RandomInitializer init(2000u, 3u, 0.5f);
+  Philox4x32 rng(1u, 0u);
+  for (int trial=0; trial<20; ++trial) {
+    const Chromosome x = init();
+    Decoder decoder(x);
+    DecoderLayout layout;
+    std::vector<size_t> sizes;
+    // fields of 1 to 64 gens, many of them crossing word boundaries
+    for (size_t pos=0; ; ) {
+      const size_t n = 1u + rng() % 64u;
+      if (pos + n > x.size()) break;
+      sizes.push_back(n);
+      if (sizes.size() % 2u == 0u) layout.addUIntField(n);
+      else layout.addField(n, -2.0, 3.0);
+      pos += n;
+    }
+    std::vector<double> values;
+    layout.decode(x, values);
+    ASSERT_EQ(sizes.size(), values.size());
+    size_t pos = 0u;
+    for (size_t f=0; f<sizes.size(); ++f) {
+      const size_t n = sizes[f];
+      const uint64_t expected = bitwiseUInt(x, pos, n);
+      ASSERT_EQ(pos, decoder.position());
+      if (f % 3u == 0u) {
+        ASSERT_EQ(expected, decoder.decodeUInt64(n)) << "pos " << pos << " n " << n;
+      }
+      else if (f % 3u == 1u && n <= 32u) {
+        ASSERT_EQ(uint32_t(expected), decoder.decodeUInt32(n));
+      }
+      else {
+        ASSERT_DOUBLE_EQ(double(expected) / double(kernels::low_mask(n)) * 5.0 - 2.0,
+                         decoder.decodeDouble(n, -2.0, 3.0));
+      }
+      if (f % 2u == 1u) {
+        ASSERT_EQ(double(expected), values[f]) << "pos " << pos << " n " << n;
+      }
+      else {
+        ASSERT_NEAR(double(expected) / double(kernels::low_mask(n)) * 5.0 - 2.0,
+                    values[f], 1e-9) << "pos " << pos << " n " << n;
+      }
+      pos += n;
+    }
+  }
+}
+
+TEST(Encoder, DecoderReadsWhatItWrites) {
+  RandomInitializer init(700u, 5u, 0.5f);
+  Philox4x32 rng(2u, 0u);
+  for (int trial=0; trial<20; ++trial) {
+    Chromosome x = init();
+    const Chromosome before = x;
+    Encoder encoder(x);
+    encoder.skip(3u);
+    std::vector<size_t> sizes;
+    std::vector<uint64_t> ints;
+    std::vector<double> reals;
+    // every iteration writes up to 129 gens, the last 5 are kept
+    while (encoder.position() + 129u <= x.size() - 5u) {
+      const size_t n = 1u + rng() % 64u;
+      const uint64_t v = rng() & kernels::low_mask(n);
+      const double r = -1.0 + 3.0 * double(rng() % 100001u) / 100000.0;
+      sizes.push_back(n);
+      ints.push_back(v);
+      reals.push_back(r);
+      encoder.encodeUInt64(n, v);
+      encoder.encodeDouble(n, r, -1.0, 2.0);
+      encoder.encodeBool(v & 1u);
+    }
+    const size_t end = encoder.position();
+    Decoder decoder(x);
+    decoder.skip(3u);
+    for (size_t f=0; f<sizes.size(); ++f) {
+      const size_t n = sizes[f];
+      ASSERT_EQ(ints[f], decoder.decodeUInt64(n)) << "n " << n;
+      // reals come back to the nearest of the 2^n representable ones
+      const double step = 3.0 / double(kernels::low_mask(n));
+      ASSERT_NEAR(reals[f], decoder.decodeDouble(n, -1.0, 2.0),
+                  std::min(0.5 * step, 3.0) + 1e-9) << "n " << n;
+      ASSERT_EQ(bool(ints[f] & 1u), decoder.decodeBool());
+    }
+    // gens out of the written fields are kept
+    for (size_t i=0; i<x.size(); ++i) {
+      if (i < 3u || i >= end) {
+        ASSERT_EQ(before[i], x[i]) << "gen " << i;
+      }
+    }
+    EXPECT_TRUE(paddingIsZero(x));
+  }
+}
+
+TEST(Encoder, ClampsReals) {
+  Chromosome x(16u);
+  Encoder encoder(x);
+  encoder.encodeFloat(8u, -3.0f, 0.0f, 1.0f);
+  encoder.encodeFloat(8u, 7.0f, 0.0f, 1.0f);
+  Decoder decoder(x);
+  EXPECT_EQ(0u, decoder.decodeUInt32(8u));
+  EXPECT_EQ(255u, decoder.decodeUInt32(8u));
+}
+
+TEST(Gray, EncodesAndDecodes) {
+  const uint64_t table[8] = {0u, 1u, 3u, 2u, 6u, 7u, 5u, 4u};
+  for (uint64_t v=0; v<8u; ++v) {
+    EXPECT_EQ(table[v], kernels::gray_encode(v));
+    EXPECT_EQ(v, kernels::gray_decode(table[v]));
+  }
+  Philox4x32 rng(4u, 0u);
+  for (int k=0; k<10000; ++k) {
+    const uint64_t v = k == 0 ? ~uint64_t(0u) : rng();
+    ASSERT_EQ(v, kernels::gray_decode(kernels::gray_encode(v)));
+    // neighbour values differ in a single gen
+    const uint64_t d = kernels::gray_encode(v) ^ kernels::gray_encode(v + 1u);
+    ASSERT_EQ(1, __builtin_popcountll(d)) << v;
+  }
+}
+
+TEST(DecoderLayout, EncodeDecodeRoundTrip) {
+  DecoderLayout layout;
+  layout.addFields(10u, 12u, -5.0, 5.0, DecoderLayout::GRAY)
+    .addUIntField(37u, DecoderLayout::GRAY)
+    .addField(20u, 0.0, 1.0)
+    .addUIntField(64u)
+    .addUIntField(1u);
+  std::vector<double> values(layout.numFields());
+  Philox4x32 rng(6u, 0u);
+  for (int trial=0; trial<50; ++trial) {
+    for (size_t f=0; f<10u; ++f) values[f] = -5.0 + 10.0 * double(rng() % 4096u) / 4095.0;
+    values[10] = double(rng() & kernels::low_mask(37u));
+    values[11] = double(rng() % 1000001u) / 1000000.0;
+    values[12] = double(rng() >> 11u); // exact as a double
+    values[13] = double(rng() & 1u);
+    const Chromosome x = layout.encode<Chromosome>(values);
+    ASSERT_EQ(layout.size(), x.size());
+    std::vector<double> decoded;
+    layout.decode(x, decoded);
+    for (size_t f=0; f<10u; ++f) ASSERT_NEAR(values[f], decoded[f], 1e-9);
+    ASSERT_EQ(values[10], decoded[10]);
+    ASSERT_NEAR(values[11], decoded[11], 0.5 / double(kernels::low_mask(20u)) + 1e-12);
+    ASSERT_EQ(values[12], decoded[12]);
+    ASSERT_EQ(values[13], decoded[13]);
+    // the Gray field holds the Gray code of its integer
+    Decoder decoder(x);
+    decoder.skip(120u);
+    ASSERT_EQ(kernels::gray_encode(uint64_t(values[10])), decoder.decodeUInt64(37u));
+  }
+}
+
+// WeightedOnes, also ranking whole matrices of words
+struct BatchWeightedOnes : WeightedOnes {
+  std::atomic<size_t> *batches;
+
+  void rank_batch(const word_type *words, size_t num_words, size_t count,
+                  float *ranks) const {
+    batches->fetch_add(1u);
+    for (size_t r=0; r<count; ++r, words+=num_words) {
+      float sum = 0.0f;
+      for (size_t w=0; w<num_words; ++w) {
+        for (word_type m=words[w]; m; m&=m-1u) {
+          sum += weight(w * WORD_BITS + __builtin_ctzll(m));
+        }
+      }
+      ranks[r] = sum;
+    }
+  }
+};
+
+TEST(Population, BatchRanksMatchSingleRanks) {
+  static_assert(has_batch_rank<BatchWeightedOnes, float>::value,
+                "BatchWeightedOnes should rank batches");
+  // without cache, and with a cache which leaves scattered misses to
+  // the staging matrix
+  const size_t caches[] = {0u, 64u};
+  const size_t threads[] = {1u, 3u};
+  for (const size_t cache : caches) {
+    for (const size_t num_threads : threads) {
+      std::atomic<size_t> deltas(0u), batches(0u);
+      BatchWeightedOnes rank;
+      rank.deltas = &deltas;
+      rank.batches = &batches;
+      SolverOptions options;
+      options.population_size = 60u;
+      options.num_threads = num_threads;
+      options.cache_capacity = cache;
+      // few gens, so children are often equal to cached Chromosomes
+      RandomInitializer init(20u, 1u, 0.5f);
+      FloatTournamentSelection select(2u, 2u);
+      auto cross = make_cross_over_on_prob(3u, 0.5f, RandomSplitCrossOver(20u, 4u));
+      RandomMutate mutate(5u, 0.05f);
+      GeneticSolver<float, RandomInitializer, FloatTournamentSelection,
+                    decltype(cross), RandomMutate, BatchWeightedOnes>
+        solver(options, init, select, cross, mutate, rank);
+      solver.init();
+      for (int k=0; k<20; ++k) {
+        solver.step();
+        const auto &pop = solver.population();
+        for (size_t i=0; i<pop.size(); ++i) {
+          ASSERT_EQ(rank(pop.genome(i)), pop.rank(i))
+            << "cache " << cache << " threads " << num_threads;
+        }
+      }
+      EXPECT_GT(batches.load(), 0u);
+      if (cache > 0u) {
+        EXPECT_GT(solver.population().cacheHits(), 0u);
+      }
+    }
+  }
+}